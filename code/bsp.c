@@ -7,7 +7,11 @@
 
 #include "bsp_memory.c"
 #include "bsp_sha256.c"
+#include "bsp_crc32c.c"
+#include "bsp_database_file.c"
+#include "bsp_database_log.c"
 #include "bsp_database.c"
+#include "bsp_kdf.c"
 
 static Key_Value_Table global_html_templates;
 
@@ -31,6 +35,28 @@ cpu_timer_end(Thread_Context *thread, Cpu_Timer_Id id)
    timer->hits++;
 }
 
+#define CPU_TIMER_ADD(label, cycles, depth) \
+   cpu_timer_add(&request->thread, (CPU_TIMER_##label), (#label), (cycles), (depth))
+
+static void
+cpu_timer_add(Thread_Context *thread, Cpu_Timer_Id id, char *label,
+              unsigned long long cycles, unsigned int queue_depth)
+{
+   // NOTE(law): Record a block that was timed somewhere other than the
+   // current thread (e.g. by a work queue thread on its behalf).
+
+   Cpu_Timer *timer = thread->timers + id;
+   timer->id = id;
+   timer->label = label;
+   timer->elapsed += cycles;
+   timer->hits++;
+
+   if(queue_depth > timer->max_queue_depth)
+   {
+      timer->max_queue_depth = queue_depth;
+   }
+}
+
 static void
 output_request_header(Request_State *request, int error_code)
 {
@@ -53,15 +79,129 @@ generate_session_id(char *destination, size_t size)
 {
    ASSERT(size == 64);
 
-   unsigned char message[4096];
-   platform_generate_random_bytes(message, sizeof(message));
+   // NOTE(law): The 256 bits of randomness come straight from the CSPRNG,
+   // which is already whitened, so there's nothing to be gained from hashing
+   // it first.
+   unsigned char bytes[32];
+   platform_generate_random_bytes(bytes, sizeof(bytes));
 
-   SHA256 hash = hash_sha256(message, sizeof(message));
-   memory_copy(destination, hash.text, size);
+   char text[SESSION_ID_LENGTH + 1];
+   bytes_to_hexadecimal_string(text, bytes, sizeof(bytes));
+   memory_copy(destination, text, size);
 }
 
 #define SESSION_COOKIE_KEY "id"
 
+#if SESSION_TOKENS
+// NOTE(law): In this mode the session cookie is a signed token rather than a
+// random id stored with the user. A token is 16 bytes of payload (user row
+// index, revocation generation and expiry time, little endian) followed by the
+// first 16 bytes of its HMAC-SHA256 under a key generated at startup, all hex
+// encoded. Authenticating a request is then a single HMAC with no table lock.
+// Logging out bumps the user's generation, which invalidates every token they
+// were issued. Restarting the server invalidates every token, which logs every
+// user out, so the mode is off by default.
+
+#define SESSION_TOKEN_PAYLOAD_SIZE 16
+#define SESSION_TOKEN_MAC_SIZE 16
+
+typedef struct
+{
+   unsigned int user_index;
+   unsigned int generation;
+   unsigned long long expiry;
+} Session_Token;
+
+static HMAC_SHA256_Key global_session_token_key;
+
+static void
+initialize_session_tokens(void)
+{
+   unsigned char key[32];
+   platform_generate_random_bytes(key, sizeof(key));
+
+   initialize_hmac_sha256_key(&global_session_token_key, key, sizeof(key));
+   zero_memory(key, sizeof(key));
+}
+
+static void
+encode_session_token(char *destination, Session_Token *token)
+{
+   // NOTE(law): The destination must hold SESSION_ID_LENGTH + 1 characters.
+
+   unsigned char bytes[SESSION_TOKEN_PAYLOAD_SIZE + SESSION_TOKEN_MAC_SIZE];
+   for(unsigned int index = 0; index < 4; ++index)
+   {
+      bytes[index + 0] = (unsigned char)(token->user_index >> (8 * index));
+      bytes[index + 4] = (unsigned char)(token->generation >> (8 * index));
+   }
+   for(unsigned int index = 0; index < 8; ++index)
+   {
+      bytes[index + 8] = (unsigned char)(token->expiry >> (8 * index));
+   }
+
+   SHA256 mac = hmac_sha256_keyed(&global_session_token_key, bytes, SESSION_TOKEN_PAYLOAD_SIZE);
+   memory_copy(bytes + SESSION_TOKEN_PAYLOAD_SIZE, mac.bytes, SESSION_TOKEN_MAC_SIZE);
+
+   bytes_to_hexadecimal_string(destination, bytes, sizeof(bytes));
+}
+
+static bool
+authenticate_session_token(char *text, Session_Token *token, User_Account *user)
+{
+   // NOTE(law): Returns true if text is an unexpired, unrevoked token signed by
+   // this server, along with the user it was issued to.
+
+   unsigned char bytes[SESSION_TOKEN_PAYLOAD_SIZE + SESSION_TOKEN_MAC_SIZE];
+   if(string_length(text) != 2 * sizeof(bytes))
+   {
+      return false;
+   }
+
+   for(unsigned int index = 0; index < 2 * sizeof(bytes); ++index)
+   {
+      if(!is_hexadecimal_digit(text[index]))
+      {
+         return false;
+      }
+   }
+
+   hexadecimal_string_to_bytes(bytes, sizeof(bytes), text, 2 * sizeof(bytes));
+
+   // NOTE(law): Compare the full MAC regardless of where the first mismatch is,
+   // so response timing doesn't reveal how much of a forged MAC was right.
+   SHA256 mac = hmac_sha256_keyed(&global_session_token_key, bytes, SESSION_TOKEN_PAYLOAD_SIZE);
+   if(!bytes_are_equal_constant_time(mac.bytes, bytes + SESSION_TOKEN_PAYLOAD_SIZE, SESSION_TOKEN_MAC_SIZE))
+   {
+      return false;
+   }
+
+   zero_memory(token, sizeof(*token));
+   for(unsigned int index = 0; index < 4; ++index)
+   {
+      token->user_index |= (unsigned int)bytes[index + 0] << (8 * index);
+      token->generation |= (unsigned int)bytes[index + 4] << (8 * index);
+   }
+   for(unsigned int index = 0; index < 8; ++index)
+   {
+      token->expiry |= (unsigned long long)bytes[index + 8] << (8 * index);
+   }
+
+   if(token->expiry <= (unsigned long long)time(0))
+   {
+      return false;
+   }
+
+   if(!database_get_user_by_index(token->user_index, user))
+   {
+      return false;
+   }
+
+   bool result = (token->generation == database_get_user_session_generation(token->user_index));
+   return result;
+}
+#endif
+
 static void
 clear_session(Request_State *request)
 {
@@ -83,9 +223,27 @@ static void
 create_session(Request_State *request, char *username)
 {
    char session_id[SESSION_ID_LENGTH + 1] = {0};
-   generate_session_id(session_id, SESSION_ID_LENGTH);
 
-   database_update_user_session_id(username, session_id);
+#if SESSION_TOKENS
+   Session_Token token = {0};
+   if(!database_get_user_index(username, &token.user_index))
+   {
+      redirect_request(request, "/?error=not-account");
+      return;
+   }
+   token.generation = database_get_user_session_generation(token.user_index);
+   token.expiry = (unsigned long long)time(0) + SESSION_LIFETIME_SECONDS;
+
+   encode_session_token(session_id, &token);
+#else
+   unsigned int user_index;
+   generate_session_id(session_id, SESSION_ID_LENGTH);
+   if(!database_get_user_index(username, &user_index) || !database_insert_session(session_id, user_index))
+   {
+      redirect_request(request, "/?error=not-account");
+      return;
+   }
+#endif
 
    OUT("Content-type: text/html\n");
 #if DEVELOPMENT_BUILD
@@ -306,7 +464,7 @@ get_value(Key_Value_Table *table, char *key)
 }
 
 static void
-initialize_request(Request_State *request, unsigned char *arena_base_address, size_t arena_size)
+initialize_request(Request_State *request, Memory_Arena *arena)
 {
    CPU_TIMER_BEGIN(initialize_request);
 
@@ -317,8 +475,23 @@ initialize_request(Request_State *request, unsigned char *arena_base_address, si
    CGI_METAVARIABLES_LIST
 #undef X
 
-   Memory_Arena *arena = &request->thread.arena;
-   initialize_arena(arena, arena_base_address, arena_size);
+   // NOTE(law): Each request thread keeps its arena (and whatever it has
+   // committed) from one request to the next.
+   request->thread.arena = arena;
+   if(arena->base_address)
+   {
+      reset_arena(arena);
+   }
+   else if(reserve_arena(arena, REQUEST_ARENA_SOFT_LIMIT, HUGE_PAGE_FLAGS))
+   {
+      platform_log_message("Arena for thread %ld backed by %s pages.",
+                           request->thread.index,
+                           page_backing_name(arena->page_backing));
+   }
+   else
+   {
+      platform_log_message("[ERROR] Failed to reserve the arena for thread %ld.", request->thread.index);
+   }
 
    Key_Value_Table *url = &request->url;
    Key_Value_Table *form = &request->form;
@@ -338,10 +511,25 @@ initialize_request(Request_State *request, unsigned char *arena_base_address, si
    char *session_id = get_value(cookies, SESSION_COOKIE_KEY);
    if(session_id && *session_id)
    {
-      // TODO(law): Check for valid existing session that matches the id
-      // provided by the client.
-      User_Account user = database_get_user_by_session(session_id);
-      memory_copy(&request->user, &user, sizeof(user));
+      User_Account user = {0};
+#if SESSION_TOKENS
+      Session_Token token;
+      authenticate_session_token(session_id, &token, &user);
+#else
+      if(string_length(session_id) == SESSION_ID_LENGTH)
+      {
+         user = database_get_user_by_session(session_id);
+      }
+#endif
+
+      if(*user.username)
+      {
+         // NOTE(law): Record the session the user authenticated with, which is
+         // what is_logged_in() checks against.
+         memory_copy(user.session_id, session_id, SESSION_ID_LENGTH);
+         user.session_id[SESSION_ID_LENGTH] = 0;
+         memory_copy(&request->user, &user, sizeof(user));
+      }
    }
 
    // Update request data with URL parameters from query string.
@@ -349,21 +537,12 @@ initialize_request(Request_State *request, unsigned char *arena_base_address, si
    Key_Value_Pair url_parameter = consume_key_value_pair(arena, &query_string, '&');
    while(*url_parameter.key)
    {
-      size_t key_size   = string_length(url_parameter.key) + 1;
-      size_t value_size = string_length(url_parameter.value) + 1;
-
-      char *decoded_key   = PUSH_SIZE(arena, key_size);
-      char *decoded_value = PUSH_SIZE(arena, value_size);
+      // NOTE(law): Decoding never lengthens a string, so it's done in place
+      // rather than into another copy.
+      decode_query_string(url_parameter.key, url_parameter.key, string_length(url_parameter.key) + 1);
+      decode_query_string(url_parameter.value, url_parameter.value, string_length(url_parameter.value) + 1);
 
-      if(!decoded_key || !decoded_value)
-      {
-         break;
-      }
-
-      decode_query_string(decoded_key, url_parameter.key, key_size);
-      decode_query_string(decoded_value, url_parameter.value, value_size);
-
-      insert_key_value(url, decoded_key, decoded_value);
+      insert_key_value(url, url_parameter.key, url_parameter.value);
       url_parameter = consume_key_value_pair(arena, &query_string, '&');
    }
 
@@ -374,26 +553,18 @@ initialize_request(Request_State *request, unsigned char *arena_base_address, si
       char *post_data = PUSH_SIZE(arena, content_length + 1);
       if(post_data)
       {
-         GET_STRING_FROM_INPUT_STREAM(post_data, content_length + 1);
+         // NOTE(law): The arena is reused from request to request, so the body
+         // has to be terminated explicitly.
+         int read_size = GET_STRING_FROM_INPUT_STREAM(post_data, content_length);
+         post_data[MAXIMUM(read_size, 0)] = 0;
 
          Key_Value_Pair post_parameter = consume_key_value_pair(arena, &post_data, '&');
          while(*post_parameter.key)
          {
-            size_t key_size   = string_length(post_parameter.key) + 1;
-            size_t value_size = string_length(post_parameter.value) + 1;
-
-            char *decoded_key   = PUSH_SIZE(arena, key_size);
-            char *decoded_value = PUSH_SIZE(arena, value_size);
-
-            if(!decoded_key || !decoded_value)
-            {
-               break;
-            }
-
-            decode_query_string(decoded_key, post_parameter.key, key_size);
-            decode_query_string(decoded_value, post_parameter.value, value_size);
+            decode_query_string(post_parameter.key, post_parameter.key, string_length(post_parameter.key) + 1);
+            decode_query_string(post_parameter.value, post_parameter.value, string_length(post_parameter.value) + 1);
 
-            insert_key_value(form, decoded_key, decoded_value);
+            insert_key_value(form, post_parameter.key, post_parameter.value);
             post_parameter = consume_key_value_pair(arena, &post_data, '&');
          }
       }
@@ -409,15 +580,42 @@ BSP_INITIALIZE_APPLICATION(bsp_initialize_application)
    // resources are released automatically when the program exits (i.e. this
    // will leak if called more than once).
 
+   // NOTE(law): Select the fastest SHA256 compression function, CRC32C and
+   // memory primitives supported by the host CPU before anything is hashed.
+   initialize_memory_backend();
+   initialize_sha256_backend();
+   initialize_crc32c_backend();
+
 #if DEVELOPMENT_BUILD
    // NOTE(law): Perform any automated testing.
    test_hash_sha256(2048);
    test_hmac_sha256(2048);
+   test_sha256_streaming(8);
    test_pbkdf2_hmac_sha256(8);
+   test_hash_sha256_lanes(4);
+   test_pbkdf2_hmac_sha256_lanes(16);
+   test_crc32c();
+   test_database_index();
+   test_database_hot_key_scan();
+   test_database_log_replay();
+   test_memory_primitives();
+   test_memory_arena();
+   test_platform_allocator();
 #endif
 
    // NOTE(law): Read user accounts into memory.
-   database_initialize(MEBIBYTES(512));
+   database_initialize(DATABASE_ARENA_SOFT_LIMIT);
+
+#if SESSION_TOKENS
+   initialize_session_tokens();
+#endif
+
+   // NOTE(law): Launch the threads that handle password hashing on behalf of
+   // the request threads.
+   initialize_password_hashing(KDF_THREAD_COUNT,
+                               KDF_QUEUE_DEPTH,
+                               KDF_BATCH_TIMEOUT_MICROSECONDS,
+                               KDF_LATENCY_BUDGET_MILLISECONDS);
 
    // NOTE(law): Read html tempates into memory.
    char *template_paths[] =
@@ -548,11 +746,14 @@ debug_output_request_data(Request_State *request)
        "section#debug-information td.debug-empty {text-align: center;}"
        "</style>");
 
-   Memory_Arena *arena = &request->thread.arena;
+   Memory_Arena *arena = request->thread.arena;
    Key_Value_Table *url = &request->url;
    Key_Value_Table *form = &request->form;
    Key_Value_Table *cookies = &request->cookies;
 
+   // NOTE(law): Everything encoded below is only needed until it's been
+   // output, so each table row is encoded into temporary memory.
+
    OUT("<section id=\"debug-information\">");
 
    float arena_size = (float)arena->size;
@@ -586,8 +787,36 @@ debug_output_request_data(Request_State *request)
    OUT("<table>");
    OUT("<tr><th colspan=\"2\">Memory Arena</th></tr>");
    OUT("<tr><td>Thread</td><td>%ld</td></tr>", request->thread.index);
-   OUT("<tr><td>Arena Size</td><td>%0.1f%s</td></tr>", arena_size, units_size);
+   OUT("<tr><td>Arena Committed</td><td>%0.1f%s</td></tr>", arena_size, units_size);
    OUT("<tr><td>Arena Used</td><td>%0.1f%s</td></tr>", arena_used, units_used);
+   OUT("<tr><td>Arena Pages</td><td>%s</td></tr>", page_backing_name(arena->page_backing));
+   OUT("</table>");
+
+   // Output allocator size classes that have been used
+   Platform_Allocator_Statistics allocator;
+   platform_get_allocator_statistics(&allocator);
+
+   OUT("<table>");
+   OUT("<tr><th>Size Class</th><th>Allocations</th><th>Live</th><th>Spans</th></tr>");
+   for(unsigned int index = 0; index < PLATFORM_SIZE_CLASS_COUNT; ++index)
+   {
+      Platform_Size_Class_Statistics *size_class = allocator.size_classes + index;
+      if(size_class->span_size > 0)
+      {
+         OUT("<tr>");
+         OUT("<td>%uB</td>", (unsigned int)size_class->block_size);
+         OUT("<td>%u</td>", (unsigned int)size_class->allocation_count);
+         OUT("<td>%d</td>", (int)(size_class->allocation_count - size_class->deallocation_count));
+         OUT("<td>%uKiB</td>", (unsigned int)(size_class->span_size / KIBIBYTES(1)));
+         OUT("</tr>");
+      }
+   }
+   OUT("<tr>");
+   OUT("<td>Large</td>");
+   OUT("<td>%u</td>", (unsigned int)allocator.large_allocation_count);
+   OUT("<td>%d</td>", (int)(allocator.large_allocation_count - allocator.large_deallocation_count));
+   OUT("<td>%uKiB</td>", (unsigned int)(allocator.large_mapped_size / KIBIBYTES(1)));
+   OUT("</tr>");
    OUT("</table>");
 
    // Output performance timers
@@ -597,18 +826,24 @@ debug_output_request_data(Request_State *request)
    OUT("<th>Hits</th>");
    OUT("<th>Total Cycles</th>");
    OUT("<th>Cycles per Hit</th>");
+   OUT("<th>Max Queue Depth</th>");
    OUT("</tr>");
    for(unsigned int index = 0; index < CPU_TIMER_COUNT; ++index)
    {
       Cpu_Timer *timer = request->thread.timers + index;
       if(timer->hits > 0)
       {
+         Temporary_Memory scratch = begin_temporary_memory(arena);
+
          OUT("<tr>");
          OUT("<td>%s</td>", encode_for_html(arena, timer->label));
          OUT("<td>%5u</td>", timer->hits);
          OUT("<td>%10u</td>", timer->elapsed);
          OUT("<td>%10u</td>", timer->elapsed / timer->hits);
+         OUT("<td>%5u</td>", timer->max_queue_depth);
          OUT("</tr>");
+
+         end_temporary_memory(scratch);
       }
    }
    OUT("</table>");
@@ -626,10 +861,13 @@ debug_output_request_data(Request_State *request)
       if(parameter->key && *parameter->key)
       {
          char *value = (parameter->value) ? parameter->value : "";
+
+         Temporary_Memory scratch = begin_temporary_memory(arena);
          OUT("<tr>");
          OUT("<td>%s</td>", encode_for_html(arena, parameter->key));
          OUT("<td>%s</td>", encode_for_html(arena, value));
          OUT("</tr>");
+         end_temporary_memory(scratch);
          url_parameter_count++;
       }
    }
@@ -649,10 +887,13 @@ debug_output_request_data(Request_State *request)
       if(parameter->key && *parameter->key)
       {
          char *value = (parameter->value) ? parameter->value : "";
+
+         Temporary_Memory scratch = begin_temporary_memory(arena);
          OUT("<tr>");
          OUT("<td>%s</td>", encode_for_html(arena, parameter->key));
          OUT("<td>%s</td>", encode_for_html(arena, value));
          OUT("</tr>");
+         end_temporary_memory(scratch);
          form_parameter_count++;
       }
    }
@@ -672,10 +913,13 @@ debug_output_request_data(Request_State *request)
       if(parameter->key && *parameter->key)
       {
          char *value = (parameter->value) ? parameter->value : "";
+
+         Temporary_Memory scratch = begin_temporary_memory(arena);
          OUT("<tr>");
          OUT("<td>%s</td>", encode_for_html(arena, parameter->key));
          OUT("<td>%s</td>", encode_for_html(arena, value));
          OUT("</tr>");
+         end_temporary_memory(scratch);
          cookie_count++;
       }
    }
@@ -694,12 +938,19 @@ debug_output_request_data(Request_State *request)
    OUT("<th>Salt</th>");
    OUT("<th>Password Hash</th>");
    OUT("<th>Iteration Count</th>");
-   OUT("<th>Session ID</th>");
    OUT("</tr>");
 
-   for(unsigned int index = 0; index < database.users.row_count; ++index)
+   // NOTE(law): The snapshot holds every user, so it's released as soon as
+   // the table is done.
+   Temporary_Memory snapshot_scratch = begin_temporary_memory(arena);
+
+   unsigned int user_count = 0;
+   User_Account *users = database_snapshot_users(arena, &user_count);
+   for(unsigned int index = 0; users && index < user_count; ++index)
    {
-      User_Account *user = (User_Account *)database.users.rows + index;
+      User_Account *user = users + index;
+
+      Temporary_Memory scratch = begin_temporary_memory(arena);
       OUT("<tr>");
       OUT("<td>%s</td>", encode_for_html(arena, user->username));
       OUT("<td>");
@@ -709,20 +960,46 @@ debug_output_request_data(Request_State *request)
       print_bytes(request, user->password_hash, PASSWORD_HASH_LENGTH);
       OUT("</td>");
       OUT("<td>%d</td>", user->iteration_count);
-      char *session_id = encode_for_html(arena, user->session_id);
-      if(string_length(session_id) > 20)
-      {
-         OUT("<td>%.*s...</td>", 20, session_id);
-      }
-      else
+      OUT("</tr>");
+      end_temporary_memory(scratch);
+   }
+   if(user_count == 0)
+   {
+      OUT("<tr><td colspan=\"4\" class=\"debug-empty\">No entries</td></tr>");
+   }
+   OUT("</table>");
+
+   end_temporary_memory(snapshot_scratch);
+
+   // Output stored sessions
+   OUT("<table>");
+   OUT("<tr>");
+   OUT("<th>Session ID (%u active)</th>", database.session_wheel.active_count);
+   OUT("<th>User Index</th>");
+   OUT("<th>Expires In (s)</th>");
+   OUT("</tr>");
+
+   unsigned int listed_session_count = 0;
+   unsigned long long now = (unsigned long long)time(0);
+   for(unsigned int index = 0; index < database.sessions.row_count && listed_session_count < 20; ++index)
+   {
+      User_Session *session = database_row(&database.sessions, index);
+      if(session && *session->session_id)
       {
-         OUT("<td>%s</td>", session_id);
+         Temporary_Memory scratch = begin_temporary_memory(arena);
+         OUT("<tr>");
+         OUT("<td>%.*s...</td>", 20, encode_for_html(arena, session->session_id));
+         OUT("<td>%u</td>", session->user_index);
+         OUT("<td>%lld</td>", (long long)(session->expires - now));
+         OUT("</tr>");
+         end_temporary_memory(scratch);
+
+         listed_session_count++;
       }
-      OUT("</tr>");
    }
-   if(database.users.row_count == 0)
+   if(listed_session_count == 0)
    {
-      OUT("<tr><td colspan=\"5\" class=\"debug-empty\">No entries</td></tr>");
+      OUT("<tr><td colspan=\"3\" class=\"debug-empty\">No entries</td></tr>");
    }
    OUT("</table>");
 
@@ -730,16 +1007,44 @@ debug_output_request_data(Request_State *request)
    OUT("<table>");
    OUT("<tr><th>CGI Metavariable</th><th>Value</th></tr>");
 
+   Temporary_Memory metavariable_scratch = begin_temporary_memory(arena);
+
 #define X(v) OUT("<tr><td>" #v "</td><td>%s</td></tr>", encode_for_html(arena, request->v));
    CGI_METAVARIABLES_LIST
 #undef X
 
+   end_temporary_memory(metavariable_scratch);
+
    OUT("</table>");
 
    OUT("</section>");
 #endif
 }
 
+static void
+derive_password_hash(Request_State *request,
+                     unsigned char *password_hash,
+                     char *password,
+                     unsigned char *salt,
+                     unsigned int iteration_count)
+{
+   // NOTE(law): Password hashing is handed off to the KDF threads (see
+   // bsp_kdf.c). The time spent queued and the time spent hashing are recorded
+   // as separate timers.
+
+   Password_Hash_Job job = {0};
+   job.password_hash = password_hash;
+   job.password = (unsigned char *)password;
+   job.password_size = string_length(password);
+   job.salt = salt;
+   job.iteration_count = iteration_count;
+
+   derive_password_hash_blocking(&job);
+
+   CPU_TIMER_ADD(kdf_queue_wait, job.started - job.submitted, job.queue_depth);
+   CPU_TIMER_ADD(pbkdf2_hmac_sha256, job.finished - job.started, 0);
+}
+
 static void
 login_user(Request_State *request, char *username, char *password)
 {
@@ -765,31 +1070,25 @@ login_user(Request_State *request, char *username, char *password)
    }
 
    unsigned char password_hash[sizeof(user.password_hash)];
-   unsigned char *password_bytes = (unsigned char *)password;
-   size_t password_size = string_length(password);
-
-   CPU_TIMER_BEGIN(pbkdf2_hmac_sha256);
-   pbkdf2_hmac_sha256(password_hash,
-                      sizeof(password_hash),
-                      password_bytes,
-                      password_size,
-                      user.salt,
-                      sizeof(user.salt),
-                      user.iteration_count);
-   CPU_TIMER_END(pbkdf2_hmac_sha256);
+   derive_password_hash(request, password_hash, password, user.salt, user.iteration_count);
 
-   if(!bytes_are_equal(password_hash, user.password_hash, sizeof(user.password_hash)))
+   if(!bytes_are_equal_constant_time(password_hash, user.password_hash, sizeof(user.password_hash)))
    {
       // "The provided username/password was incorrect."
       redirect_request(request, "/?error=wrong-password");
       return;
    }
 
+   // NOTE(law): Accounts hashed before the most recent calibration are brought
+   // up to the current cost. The login itself doesn't wait on this.
+   if(user.iteration_count < password_hash_scheduler.iteration_count)
+   {
+      schedule_password_rehash(username, password);
+   }
+
    create_session(request, username);
 }
 
-#define PBKDF2_PASSWORD_ITERATION_ACCOUNT 100000
-
 static void
 register_user(Request_State *request, char *username, char *password)
 {
@@ -830,17 +1129,15 @@ register_user(Request_State *request, char *username, char *password)
    platform_generate_random_bytes(salt, sizeof(salt));
 
    unsigned char password_hash[sizeof(existing_user.password_hash)];
-   unsigned char *password_bytes = (unsigned char *)password;
-   size_t password_size = string_length(password);
-
-   CPU_TIMER_BEGIN(pbkdf2_hmac_sha256);
-   pbkdf2_hmac_sha256(password_hash, sizeof(password_hash),
-                      password_bytes, password_size,
-                      salt, sizeof(salt),
-                      PBKDF2_PASSWORD_ITERATION_ACCOUNT);
-   CPU_TIMER_END(pbkdf2_hmac_sha256);
+   unsigned int iteration_count = password_hash_scheduler.iteration_count;
+   derive_password_hash(request, password_hash, password, salt, iteration_count);
 
-   database_insert_user(username, salt, password_hash, PBKDF2_PASSWORD_ITERATION_ACCOUNT);
+   if(!database_insert_user(username, salt, password_hash, iteration_count))
+   {
+      // "The account could not be created."
+      redirect_request(request, "/?error=registration-failed");
+      return;
+   }
 
    // NOTE(Law): Perform the login with the initial password as a sanity check
    // that things worked.
@@ -875,7 +1172,7 @@ output_html_header(Request_State *request, bool logged_in)
 
    if(logged_in)
    {
-      char *username = encode_for_html(&request->thread.arena, request->user.username);
+      char *username = encode_for_html(request->thread.arena, request->user.username);
 
       OUT("<span>");
       OUT("<a href=\"/user?id=%s\">%s</a>", username, username);
@@ -892,13 +1189,12 @@ BSP_PROCESS_REQUEST(bsp_process_request)
 {
    CPU_TIMER_BEGIN(process_request);
 
-   initialize_request(request, arena_base_address, arena_size);
+   initialize_request(request, arena);
    platform_log_message("%s request to \"%s\" received by thread %ld.",
                         request->REQUEST_METHOD,
                         request->SCRIPT_NAME,
                         request->thread.index);
 
-   Memory_Arena *arena = &request->thread.arena;
    Key_Value_Table *url = &request->url;
    Key_Value_Table *form = &request->form;
 
@@ -983,6 +1279,27 @@ BSP_PROCESS_REQUEST(bsp_process_request)
    }
    else if(strings_are_equal(request->SCRIPT_NAME, "/logout"))
    {
+#if SESSION_TOKENS
+      // NOTE(law): Revoke the token (and every other token issued to the same
+      // user), since clearing the cookie alone doesn't stop it from being
+      // replayed.
+      char *session_id = get_value(&request->cookies, SESSION_COOKIE_KEY);
+      if(session_id && *session_id)
+      {
+         Session_Token token;
+         User_Account user;
+         if(authenticate_session_token(session_id, &token, &user))
+         {
+            database_revoke_user_sessions(token.user_index);
+         }
+      }
+#else
+      char *session_id = get_value(&request->cookies, SESSION_COOKIE_KEY);
+      if(session_id && *session_id)
+      {
+         database_delete_session(session_id);
+      }
+#endif
       clear_session(request);
    }
    else
@@ -997,3 +1314,18 @@ BSP_PROCESS_REQUEST(bsp_process_request)
 
    debug_output_request_data(request);
 }
+
+extern
+BSP_FINISH_REQUEST(bsp_finish_request)
+{
+   // NOTE(law): Trimming is left until the response is out of the way, so it
+   // doesn't add to the request's latency.
+   reset_arena(arena);
+   trim_arena(arena);
+}
+
+extern
+BSP_BACKUP_DATABASE(bsp_backup_database)
+{
+   database_backup_tables();
+}
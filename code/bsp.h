@@ -5,13 +5,16 @@
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <time.h>
 
 // #include "platform.h"
 
 #include "bsp_memory.h"
 #include "bsp_sha256.h"
+#include "bsp_crc32c.h"
 #include "bsp_database.h"
 
 typedef enum
@@ -20,6 +23,7 @@ typedef enum
    CPU_TIMER_initialize_request,
    CPU_TIMER_output_html_template,
    CPU_TIMER_pbkdf2_hmac_sha256,
+   CPU_TIMER_kdf_queue_wait,
 
    CPU_TIMER_COUNT,
 } Cpu_Timer_Id;
@@ -32,6 +36,10 @@ typedef struct
    unsigned long long start;
    unsigned long long elapsed;
    unsigned long long hits;
+
+   // NOTE(law): For blocks that wait on a work queue, the largest number of
+   // entries found ahead of this thread's entry when it was submitted.
+   unsigned int max_queue_depth;
 } Cpu_Timer;
 
 #define STRINGIFY_(x) #x
@@ -48,6 +56,8 @@ typedef struct
    } while(0)
 
 #define ARRAY_LENGTH(a) (sizeof(a) / sizeof((a)[0]))
+#define MINIMUM(a, b) ((a) < (b) ? (a) : (b))
+#define MAXIMUM(a, b) ((a) > (b) ? (a) : (b))
 
 #define CGI_METAVARIABLES_LIST                  \
    X(AUTH_TYPE)                                 \
@@ -91,13 +101,17 @@ typedef struct
    Key_Value_Pair entries[1024];
 } Key_Value_Table;
 
+// NOTE(law): Each request thread's arena grows as needed, and only logs a
+// warning once a request pushes it past this size.
+#define REQUEST_ARENA_SOFT_LIMIT MEBIBYTES(512)
+
 typedef struct
 {
    // NOTE(law): Add any thread-related information that should persist beyond
    // the lifetime of a single request here.
 
    unsigned int index;
-   Memory_Arena arena;
+   Memory_Arena *arena;
    Cpu_Timer timers[CPU_TIMER_COUNT];
 } Thread_Context;
 
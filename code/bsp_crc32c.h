@@ -0,0 +1,18 @@
+#if !defined(BSP_CRC32C_H)
+/* /////////////////////////////////////////////////////////////////////////// */
+/* (c) copyright 2023 Lawrence D. Kern /////////////////////////////////////// */
+/* /////////////////////////////////////////////////////////////////////////// */
+
+#include <stdint.h>
+
+typedef enum
+{
+   CRC32C_BACKEND_SCALAR,
+   CRC32C_BACKEND_X86_SSE42,
+   CRC32C_BACKEND_ARM_CRC32,
+
+   CRC32C_BACKEND_COUNT,
+} CRC32C_Backend;
+
+#define BSP_CRC32C_H
+#endif
@@ -5,163 +5,2499 @@
 static struct
 {
    Memory_Arena arena;
-   Database_Table users;
+   Database_Sharded_Table users;
+   Database_Table sessions;
+   Session_Wheel session_wheel;
+
+   // NOTE(law): One counter per user id, bumped to revoke every session token
+   // issued to that user. These are only kept in memory, since the session
+   // token key doesn't survive a restart either.
+   Database_Chunked_Array user_session_generations;
+
+   // NOTE(law): One snapshot per table file. The semaphore serializes whole
+   // snapshot operations (backups and compactions) against each other.
+   struct Platform_Semaphore *snapshot_semaphore;
+   Database_Snapshot snapshots[DATABASE_FILE_COUNT];
+
+   // NOTE(law): Verifies table files in parallel while loading, and runs
+   // compactions afterwards.
+   struct Platform_Work_Queue *work_queue;
+   Platform_Work_Entry compaction_entry;
+   volatile bool compaction_running;
+   uint64_t next_compaction_time;
 } database;
 
+static void *
+database_get_element(Database_Chunked_Array *array, unsigned int index)
+{
+   // NOTE(law): Returns 0 if the element's chunk hasn't been allocated yet,
+   // which a lock-free reader can run into when it reads a row number mid-update.
+
+   void *result = 0;
+
+   unsigned int chunk_index = index >> DATABASE_CHUNK_BITS;
+   if(chunk_index < DATABASE_MAX_CHUNK_COUNT)
+   {
+      unsigned char *chunk = array->chunks[chunk_index];
+      if(chunk)
+      {
+         result = chunk + ((index & (DATABASE_CHUNK_ELEMENT_COUNT - 1)) * array->element_size);
+      }
+   }
+
+   return result;
+}
+
+static void *
+database_reserve_element(Database_Chunked_Array *array, unsigned int index)
+{
+   // NOTE(law): Allocate chunks up through the one holding index, and return
+   // the (zeroed, if new) element. The caller is responsible for serializing
+   // writers, and for publishing the element to readers with a release fence.
+
+   unsigned int chunk_index = index >> DATABASE_CHUNK_BITS;
+   if(chunk_index >= DATABASE_MAX_CHUNK_COUNT)
+   {
+      return 0;
+   }
+
+   while(array->chunk_count <= chunk_index)
+   {
+      // NOTE(law): Memory from platform_allocate() starts out zeroed, but isn't
+      // necessarily cache line aligned, so align the chunk within a slightly
+      // larger allocation. That's fine since these chunks are never freed.
+      size_t size = (DATABASE_CHUNK_ELEMENT_COUNT * array->element_size) + DATABASE_CACHE_LINE_SIZE;
+      unsigned char *allocation = platform_allocate(size);
+      if(!allocation)
+      {
+         platform_log_message("[ERROR] Failed to allocate a database chunk.");
+         return 0;
+      }
+
+      uintptr_t address = (uintptr_t)allocation;
+      address = (address + DATABASE_CACHE_LINE_SIZE - 1) & ~(uintptr_t)(DATABASE_CACHE_LINE_SIZE - 1);
+
+      array->chunks[array->chunk_count++] = (unsigned char *)address;
+   }
+
+   void *result = database_get_element(array, index);
+   return result;
+}
+
+static bool
+database_copy_snapshot_chunk(Database_Chunked_Array *array, Database_Snapshot *snapshot, unsigned int chunk_index)
+{
+   // NOTE(law): The caller is responsible for holding the snapshot lock.
+
+   ASSERT(!snapshot->copied[chunk_index]);
+
+   size_t size = DATABASE_CHUNK_ELEMENT_COUNT * array->element_size;
+   unsigned char *copy = platform_allocate(size);
+   if(copy)
+   {
+      memory_copy(copy, array->chunks[chunk_index], size);
+   }
+   else
+   {
+      platform_log_message("[ERROR] Failed to allocate a database snapshot chunk.");
+      snapshot->failed = true;
+   }
+
+   snapshot->copies[chunk_index] = copy;
+   snapshot->copied[chunk_index] = true;
+
+   return (copy != 0);
+}
+
+static void
+database_prepare_element_write(Database_Chunked_Array *array, unsigned int index)
+{
+   // NOTE(law): Call before modifying an element in place, so that a snapshot in
+   // progress keeps the element's chunk as it was when the snapshot was taken.
+   // The caller is responsible for holding the lock of the table that owns the
+   // array, which is also held whenever a snapshot of it is started.
+
+   Database_Snapshot *snapshot = array->snapshot;
+   if(snapshot && snapshot->active)
+   {
+      unsigned int chunk_index = index >> DATABASE_CHUNK_BITS;
+
+      platform_lock(snapshot->semaphore);
+      if(snapshot->active && chunk_index < snapshot->chunk_count && !snapshot->copied[chunk_index])
+      {
+         database_copy_snapshot_chunk(array, snapshot, chunk_index);
+      }
+      platform_unlock(snapshot->semaphore);
+   }
+}
+
+typedef struct
+{
+   Database_Chunked_Array *array;
+   unsigned int chunk_index;
+   unsigned int row_count;
+
+   // NOTE(law): The chunk as it appears in the file. size is how many bytes of
+   // rows the file holds for the chunk, which can be more than row_count rows.
+   uint32_t *checksums;
+   unsigned char *rows;
+   size_t size;
+   bool copy;
+
+   unsigned int bad_page_count;
+   uint64_t bad_pages[DATABASE_PAGE_SIZE / sizeof(uint32_t) / 64];
+
+   // NOTE(law): The chunk's rows as they were in the file, kept only if a page
+   // failed its checksum.
+   unsigned char *damaged_rows;
+
+   Platform_Work_Entry entry;
+} Database_Load_Chunk;
+
+static
+PLATFORM_WORK_QUEUE_CALLBACK(database_load_chunk)
+{
+   // NOTE(law): Verify one chunk of a table file and publish it to the array,
+   // copying it out of the file image first if needed. Rows on a page that
+   // fails its checksum are zeroed.
+
+   Database_Load_Chunk *load = (Database_Load_Chunk *)data;
+   size_t row_size = load->array->element_size;
+
+   unsigned char *rows = load->rows;
+   if(load->copy)
+   {
+      // NOTE(law): Memory from platform_allocate() starts out zeroed.
+      rows = platform_allocate(DATABASE_CHUNK_ELEMENT_COUNT * row_size);
+      if(rows)
+      {
+         memory_copy(rows, load->rows, load->row_count * row_size);
+      }
+   }
+
+   if(rows)
+   {
+      for(unsigned int page = 0; (page * DATABASE_PAGE_SIZE) < load->size; ++page)
+      {
+         size_t offset = page * DATABASE_PAGE_SIZE;
+         size_t size = MINIMUM(DATABASE_PAGE_SIZE, load->size - offset);
+         if(database_page_checksum(load->rows + offset, size) != load->checksums[page])
+         {
+            load->bad_pages[page / 64] |= (1ull << (page % 64));
+            load->bad_page_count++;
+         }
+      }
+
+      if(load->bad_page_count)
+      {
+         load->damaged_rows = platform_allocate(load->size);
+         if(load->damaged_rows)
+         {
+            memory_copy(load->damaged_rows, load->rows, load->size);
+         }
+      }
+
+      // NOTE(law): Rows are only zeroed once every page has been checked, since
+      // a mapped chunk is verified in place and rows can straddle pages.
+      for(unsigned int page = 0; load->bad_page_count && (page * DATABASE_PAGE_SIZE) < load->size; ++page)
+      {
+         if(load->bad_pages[page / 64] & (1ull << (page % 64)))
+         {
+            size_t offset = page * DATABASE_PAGE_SIZE;
+            unsigned int first_row = (unsigned int)(offset / row_size);
+            unsigned int end_row = (unsigned int)MINIMUM((offset + DATABASE_PAGE_SIZE + row_size - 1) / row_size, load->row_count);
+            if(first_row < end_row)
+            {
+               zero_memory(rows + (first_row * row_size), (end_row - first_row) * row_size);
+            }
+         }
+      }
+   }
+
+   load->array->chunks[load->chunk_index] = rows;
+}
+
+static bool
+database_write_damaged_rows(struct Platform_File_Handle *file,
+                            size_t *file_size,
+                            Database_File_Id file_id,
+                            uint64_t offset,
+                            unsigned char *rows,
+                            size_t size)
+{
+   // NOTE(law): Append rows to a file of damaged rows, in the same record
+   // format as the log, so that they can be looked over or replayed by hand.
+
+   bool result = false;
+
+   Database_Log_Record *record = platform_allocate(sizeof(*record) + size);
+   if(record)
+   {
+      record->magic = DATABASE_LOG_MAGIC;
+      record->file_id = file_id;
+      record->size = (uint32_t)size;
+      record->offset = offset;
+      memory_copy(record + 1, rows, size);
+      record->checksum = database_log_checksum(record);
+
+      result = platform_write_file_handle(file, *file_size, record, sizeof(*record) + size);
+      if(result)
+      {
+         *file_size += sizeof(*record) + size;
+      }
+
+      platform_deallocate(record);
+   }
+
+   return result;
+}
+
+static bool
+database_load_file(Database_Chunked_Array *array,
+                   unsigned int max_element_count,
+                   Database_File_Id file_id,
+                   char *file_path,
+                   unsigned int *element_count)
+{
+   // NOTE(law): Fill an empty array from a table file. The chunks are verified
+   // against their checksums in parallel on the database work queue. With
+   // DATABASE_MAP_FILES, every complete chunk is served straight out of a
+   // copy-on-write mapping of the file. Only the partial chunk at the end is
+   // copied, since a mapping can't be extended past the end of the file.
+   //
+   // Rows on a damaged page are kept out of memory. They are copied, as they
+   // were in the file, to a side file (e.g. users.dbsp.damaged-1700000000),
+   // and only once that copy is durable is the drop logged, so that the file
+   // matches memory. If the copy fails, the file is left alone. Returns false
+   // if the file is unusable as a whole, in which case nothing should be
+   // written to it.
+
+   ASSERT(array->chunk_count == 0);
+
+   bool result = true;
+   *element_count = 0;
+
+#if DATABASE_MAP_FILES
+   Platform_File disk = platform_map_file(file_path);
+#else
+   Platform_File disk = platform_read_file(file_path);
+#endif
+
+   if(!disk.memory)
+   {
+      platform_log_message("[WARNING] The database table %s was not found.", file_path);
+      return result;
+   }
+
+   size_t row_size = array->element_size;
+   if(disk.size < sizeof(Database_File_Header) ||
+      !database_file_header_is_valid((Database_File_Header *)disk.memory, row_size))
+   {
+      platform_log_message("[ERROR] The database table %s does not have a valid header.", file_path);
+      result = false;
+   }
+   else
+   {
+      unsigned int row_count = MINIMUM(database_file_row_count(row_size, disk.size), max_element_count);
+      unsigned int chunk_count = (row_count + DATABASE_CHUNK_ELEMENT_COUNT - 1) >> DATABASE_CHUNK_BITS;
+
+      Database_Load_Chunk *loads = platform_allocate(chunk_count * sizeof(Database_Load_Chunk));
+      if(!loads && chunk_count)
+      {
+         platform_log_message("[ERROR] Ran out of memory loading the database table %s.", file_path);
+         chunk_count = 0;
+      }
+
+      for(unsigned int chunk_index = 0; chunk_index < chunk_count; ++chunk_index)
+      {
+         Database_Load_Chunk *load = loads + chunk_index;
+
+         size_t offset = database_file_chunk_offset(row_size, chunk_index);
+         unsigned int first_row = chunk_index << DATABASE_CHUNK_BITS;
+
+         load->array = array;
+         load->chunk_index = chunk_index;
+         load->row_count = MINIMUM(DATABASE_CHUNK_ELEMENT_COUNT, row_count - first_row);
+         load->checksums = (uint32_t *)(disk.memory + offset);
+         load->rows = disk.memory + offset + DATABASE_PAGE_SIZE;
+         load->size = MINIMUM(DATABASE_CHUNK_ELEMENT_COUNT * row_size, disk.size - offset - DATABASE_PAGE_SIZE);
+#if DATABASE_MAP_FILES
+         load->copy = (load->row_count < DATABASE_CHUNK_ELEMENT_COUNT);
+#else
+         load->copy = true;
+#endif
+
+         load->entry.callback = database_load_chunk;
+         load->entry.data = load;
+         platform_submit_work(database.work_queue, &load->entry);
+      }
+
+      for(unsigned int chunk_index = 0; chunk_index < chunk_count; ++chunk_index)
+      {
+         platform_wait_for_work(database.work_queue, &loads[chunk_index].entry);
+      }
+
+      // NOTE(law): A chunk that couldn't be allocated cuts the table short.
+      while(array->chunk_count < chunk_count && array->chunks[array->chunk_count])
+      {
+         array->chunk_count++;
+      }
+      for(unsigned int chunk_index = array->chunk_count; chunk_index < chunk_count; ++chunk_index)
+      {
+         if(array->chunks[chunk_index] && loads[chunk_index].copy)
+         {
+            platform_deallocate(array->chunks[chunk_index]);
+         }
+         array->chunks[chunk_index] = 0;
+      }
+
+      if(array->chunk_count < chunk_count)
+      {
+         platform_log_message("[ERROR] Ran out of memory loading the database table %s.", file_path);
+         row_count = array->chunk_count << DATABASE_CHUNK_BITS;
+      }
+
+      char damaged_path[256];
+      format_string(damaged_path, sizeof(damaged_path), "%s.damaged-%llu", file_path, (unsigned long long)time(0));
+
+      struct Platform_File_Handle *damaged_file = 0;
+      size_t damaged_size = 0;
+      bool damaged_rows_kept = true;
+      bool any_damaged_rows = false;
+
+      for(unsigned int pass = 0; pass < 2; ++pass)
+      {
+         // NOTE(law): The first pass copies the damaged rows aside, and the
+         // second logs the drop once the copy is durable.
+         if(pass == 1)
+         {
+            if(damaged_file)
+            {
+               damaged_rows_kept = platform_sync_file(damaged_file) && damaged_rows_kept;
+               platform_close_file(damaged_file);
+            }
+
+            if(!any_damaged_rows)
+            {
+               break;
+            }
+
+            if(damaged_rows_kept)
+            {
+               platform_log_message("Damaged rows of %s were copied to %s.", file_path, damaged_path);
+            }
+            else
+            {
+               platform_log_message("[ERROR] Failed to copy the damaged rows of %s to %s. They are left in the file.", file_path, damaged_path);
+               break;
+            }
+         }
+
+         for(unsigned int chunk_index = 0; chunk_index < array->chunk_count; ++chunk_index)
+         {
+            Database_Load_Chunk *load = loads + chunk_index;
+            for(unsigned int page = 0; load->bad_page_count && (page * DATABASE_PAGE_SIZE) < load->size; ++page)
+            {
+               if(!(load->bad_pages[page / 64] & (1ull << (page % 64))))
+               {
+                  continue;
+               }
+
+               unsigned int first_row = (unsigned int)((page * DATABASE_PAGE_SIZE) / row_size);
+               unsigned int end_row = (unsigned int)MINIMUM((((page + 1) * DATABASE_PAGE_SIZE) + row_size - 1) / row_size, load->row_count);
+               if(first_row >= end_row)
+               {
+                  // NOTE(law): Only the bytes past the last whole row were damaged.
+                  continue;
+               }
+
+               unsigned int first_id = (chunk_index << DATABASE_CHUNK_BITS) + first_row;
+               unsigned int end_id = (chunk_index << DATABASE_CHUNK_BITS) + end_row;
+
+               if(pass == 0)
+               {
+                  platform_log_message("[ERROR] Page %u of chunk %u of %s failed its checksum. Dropped rows %u through %u.",
+                                       page, chunk_index, file_path, first_id, end_id - 1);
+
+                  any_damaged_rows = true;
+                  if(!damaged_file && damaged_rows_kept)
+                  {
+                     damaged_file = platform_open_file(damaged_path);
+                     damaged_rows_kept = (damaged_file != 0);
+                  }
+
+                  damaged_rows_kept = (damaged_rows_kept &&
+                                       load->damaged_rows &&
+                                       database_write_damaged_rows(damaged_file,
+                                                                   &damaged_size,
+                                                                   file_id,
+                                                                   database_file_row_offset(row_size, first_id),
+                                                                   load->damaged_rows + (first_row * row_size),
+                                                                   (end_row - first_row) * row_size));
+               }
+               else
+               {
+                  for(unsigned int id = first_id; id < end_id; ++id)
+                  {
+                     void *zeroed_row = database_get_element(array, id);
+                     database_log_write(file_id, database_file_row_offset(row_size, id), zeroed_row, row_size, 0);
+                  }
+               }
+            }
+         }
+      }
+
+      for(unsigned int chunk_index = 0; chunk_index < chunk_count; ++chunk_index)
+      {
+         if(loads[chunk_index].damaged_rows)
+         {
+            platform_deallocate(loads[chunk_index].damaged_rows);
+         }
+      }
+
+      if(loads)
+      {
+         platform_deallocate(loads);
+      }
+
+      *element_count = row_count;
+   }
+
+#if !DATABASE_MAP_FILES
+   platform_free_file(&disk);
+#endif
+
+   return result;
+}
+
+static void *
+database_row(Database_Table *table, unsigned int row)
+{
+   void *result = database_get_element(&table->rows, row);
+   if(result && table->row_store)
+   {
+      result = database_get_element(table->row_store, *(unsigned int *)result);
+   }
+
+   return result;
+}
+
+static uint32_t
+database_hash_key(char *key)
+{
+   // NOTE(law): 32-bit FNV-1a.
+   uint32_t result = 2166136261u;
+   while(*key)
+   {
+      result ^= (unsigned char)*key++;
+      result *= 16777619u;
+   }
+
+   // NOTE(law): Reserve 0 so it never matches a hash stored in a slot.
+   result |= (result == 0);
+
+   return result;
+}
+
+static char *
+database_row_key(Database_Table *table, unsigned int row)
+{
+   // NOTE(law): Returns 0 if the row's chunk hasn't been allocated yet (see
+   // database_get_element()). The key is read from the hot arrays if the table
+   // has them, so the row itself isn't touched.
+
+   char *result = 0;
+   if(table->hot_key_size)
+   {
+      result = database_get_element(&table->hot_keys, row);
+   }
+   else
+   {
+      unsigned char *row_memory = database_row(table, row);
+      if(row_memory)
+      {
+         result = (char *)row_memory + table->key_offset;
+      }
+   }
+
+   return result;
+}
+
+static uint32_t
+database_row_hash(Database_Table *table, unsigned int row)
+{
+   // NOTE(law): Returns 0 for a row with an empty key. The caller is
+   // responsible for the row existing.
+
+   uint32_t result = 0;
+   if(table->hot_key_size)
+   {
+      result = *(uint32_t *)database_get_element(&table->hot_hashes, row);
+   }
+   else
+   {
+      char *key = database_row_key(table, row);
+      if(*key)
+      {
+         result = database_hash_key(key);
+      }
+   }
+
+   return result;
+}
+
+static bool
+database_set_hot_key(Database_Table *table, unsigned int row, char *key, uint32_t hash)
+{
+   // NOTE(law): Store a row's key and hash in the table's hot arrays. The
+   // caller is responsible for holding the table lock, and for doing this
+   // before the row is published.
+
+   char *hot_key = database_reserve_element(&table->hot_keys, row);
+   uint32_t *hot_hash = database_reserve_element(&table->hot_hashes, row);
+   if(!hot_key || !hot_hash)
+   {
+      return false;
+   }
+
+   size_t key_length = string_length(key);
+   ASSERT(key_length < table->hot_key_size);
+
+   zero_memory(hot_key, table->hot_key_size);
+   memory_copy(hot_key, key, key_length);
+   *hot_hash = hash;
+
+   return true;
+}
+
+static bool
+database_scan_hot_keys(Database_Table *table, char *key, uint32_t hash, unsigned int *row_index)
+{
+   // NOTE(law): Find the first row with the given key (and hash) by scanning
+   // the hot arrays front to back, without using the index. The hashes are
+   // compared four at a time, and a candidate's key is then compared against a
+   // zero padded copy of the query 16 bytes at a time. Unused elements at the
+   // end of a chunk are zeroed, and 0 is never a valid hash, so whole groups of
+   // four are always safe to compare.
+   //
+   // The caller is responsible for holding the table lock, or for validating
+   // the result with the table sequence.
+
+   ASSERT(table->hot_key_size);
+   ASSERT((table->hot_key_size % 16) == 0 && table->hot_key_size <= DATABASE_MAX_HOT_KEY_SIZE);
+
+   size_t key_length = string_length(key);
+   if(key_length >= table->hot_key_size)
+   {
+      return false;
+   }
+
+   unsigned char query[DATABASE_MAX_HOT_KEY_SIZE] = {0};
+   memory_copy(query, key, key_length);
+
+   unsigned int row_count = table->row_count;
+   for(unsigned int first_row = 0; first_row < row_count; first_row += DATABASE_CHUNK_ELEMENT_COUNT)
+   {
+      uint32_t *hashes = database_get_element(&table->hot_hashes, first_row);
+      unsigned char *keys = database_get_element(&table->hot_keys, first_row);
+      if(!hashes || !keys)
+      {
+         break;
+      }
+
+      unsigned int count = MINIMUM(DATABASE_CHUNK_ELEMENT_COUNT, row_count - first_row);
+      for(unsigned int index = 0; index < count; index += 4)
+      {
+         unsigned int matches = 0;
+#if defined(__x86_64__) || defined(_M_X64)
+         __m128i hash4 = _mm_load_si128((__m128i *)(hashes + index));
+         matches = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(hash4, _mm_set1_epi32((int)hash))));
+#elif defined(__aarch64__) || defined(_M_ARM64)
+         uint32x4_t equal = vceqq_u32(vld1q_u32(hashes + index), vdupq_n_u32(hash));
+         if(vmaxvq_u32(equal))
+         {
+            matches = ((vgetq_lane_u32(equal, 0) & 1) |
+                       (vgetq_lane_u32(equal, 1) & 2) |
+                       (vgetq_lane_u32(equal, 2) & 4) |
+                       (vgetq_lane_u32(equal, 3) & 8));
+         }
+#else
+         for(unsigned int lane = 0; lane < 4; ++lane)
+         {
+            matches |= (hashes[index + lane] == hash) << lane;
+         }
+#endif
+
+         for(unsigned int lane = 0; matches; ++lane, matches >>= 1)
+         {
+            unsigned int row = first_row + index + lane;
+            if(!(matches & 1) || row >= row_count)
+            {
+               continue;
+            }
+
+            unsigned char *test = keys + ((index + lane) * table->hot_key_size);
+
+            bool equal = true;
+            for(size_t offset = 0; equal && offset < table->hot_key_size; offset += 16)
+            {
+#if defined(__x86_64__) || defined(_M_X64)
+               __m128i a = _mm_load_si128((__m128i *)(test + offset));
+               __m128i b = _mm_loadu_si128((__m128i *)(query + offset));
+               equal = (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) == 0xFFFF);
+#elif defined(__aarch64__) || defined(_M_ARM64)
+               uint8x16_t a = vld1q_u8(test + offset);
+               uint8x16_t b = vld1q_u8(query + offset);
+               equal = (vminvq_u8(vceqq_u8(a, b)) == 0xFF);
+#else
+               equal = bytes_are_equal(test + offset, query + offset, 16);
+#endif
+            }
+
+            if(equal)
+            {
+               *row_index = row;
+               return true;
+            }
+         }
+      }
+   }
+
+   return false;
+}
+
+static unsigned int
+database_index_slot_count(Database_Table *table)
+{
+   // NOTE(law): The caller is responsible for holding the table lock.
+   unsigned int result = (table->index) ? table->index->slot_count : 0;
+   return result;
+}
+
+static void
+database_index_insert_hash(Database_Table *table, unsigned int row, uint32_t hash)
+{
+   // NOTE(law): The caller is responsible for holding the table lock.
+
+   Database_Index_Slot *slots = table->index->slots;
+   unsigned int mask = table->index->slot_count - 1;
+
+   // NOTE(law): The index is kept at most half full, so a free slot is always
+   // found.
+   unsigned int slot = hash & mask;
+   while(slots[slot].row_number)
+   {
+      slot = (slot + 1) & mask;
+   }
+
+   slots[slot].hash = hash;
+   slots[slot].row_number = row + 1;
+}
+
+static void
+database_index_insert(Database_Table *table, unsigned int row)
+{
+   database_index_insert_hash(table, row, database_row_hash(table, row));
+}
+
+static void
+database_index_remove(Database_Table *table, unsigned int row)
+{
+   // NOTE(law): The caller is responsible for holding the table lock, and for
+   // removing the row before its key is modified.
+
+   if(!table->index)
+   {
+      return;
+   }
+
+   uint32_t hash = database_row_hash(table, row);
+   Database_Index_Slot *slots = table->index->slots;
+   unsigned int mask = table->index->slot_count - 1;
+
+   unsigned int hole = hash & mask;
+   while(slots[hole].row_number != row + 1)
+   {
+      ASSERT(slots[hole].row_number);
+      hole = (hole + 1) & mask;
+   }
+
+   // NOTE(law): Rather than leaving a tombstone, shift back any later entry in
+   // the same run whose probe sequence passes through the hole.
+   unsigned int slot = (hole + 1) & mask;
+   while(slots[slot].row_number)
+   {
+      unsigned int home = slots[slot].hash & mask;
+      if(((slot - home) & mask) >= ((slot - hole) & mask))
+      {
+         slots[hole] = slots[slot];
+         hole = slot;
+      }
+
+      slot = (slot + 1) & mask;
+   }
+
+   slots[hole].hash = 0;
+   slots[hole].row_number = 0;
+}
+
+static bool
+database_resize_index(Database_Table *table, unsigned int row_capacity)
+{
+   // NOTE(law): Rebuild the index with enough slots to keep row_capacity rows
+   // at or under half load.
+
+   unsigned int slot_count = 16;
+   while(slot_count < 2 * row_capacity)
+   {
+      slot_count *= 2;
+   }
+
+   // NOTE(law): Memory from platform_allocate_pages() starts out zeroed. Index
+   // probes land all over the slots, so a large index asks for huge pages.
+   size_t size = sizeof(Database_Index) + (slot_count * sizeof(Database_Index_Slot));
+
+   Page_Backing backing;
+   Database_Index *index = platform_allocate_pages(size, HUGE_PAGE_FLAGS, &backing);
+   if(!index)
+   {
+      platform_log_message("[ERROR] Failed to allocate the index for %s.", table->file_path);
+      return false;
+   }
+
+   if(backing != table->index_backing)
+   {
+      platform_log_message("Index for %s (%u slots) backed by %s pages.",
+                           table->file_path,
+                           slot_count,
+                           page_backing_name(backing));
+   }
+   table->index_backing = backing;
+
+   // NOTE(law): The new index is filled in before it's published, and readers
+   // load it once, so they see either the old index or the complete new one.
+   // The old index is intentionally never freed, since a lock-free reader may
+   // still be probing it. Each resize at least doubles the index, so
+   // everything retired adds up to less than the live index.
+
+   index->slot_count = slot_count;
+   Database_Index_Slot *slots = index->slots;
+   unsigned int mask = slot_count - 1;
+
+   // NOTE(law): Rows with an empty key are unused and left out of the index.
+   // With hot arrays, only the stored hashes are read.
+   for(unsigned int row = 0; row < table->row_count; ++row)
+   {
+      uint32_t hash = database_row_hash(table, row);
+      if(hash)
+      {
+         unsigned int slot = hash & mask;
+         while(slots[slot].row_number)
+         {
+            slot = (slot + 1) & mask;
+         }
+
+         slots[slot].hash = hash;
+         slots[slot].row_number = row + 1;
+      }
+   }
+
+   platform_release_fence();
+   table->index = index;
+
+   return true;
+}
+
+static void *
+database_find_row(Database_Table *table, char *key, unsigned int *row_index)
+{
+   // NOTE(law): Returns the first row inserted with the given key, or 0. The
+   // caller is responsible for holding the table lock. Readers that don't hold
+   // the lock use database_read_row() instead.
+
+   void *result = 0;
+
+   uint32_t hash = database_hash_key(key);
+   unsigned int row = 0;
+   bool found = false;
+
+   Database_Index *index = table->index;
+   if(index)
+   {
+      unsigned int mask = index->slot_count - 1;
+
+      unsigned int slot = hash & mask;
+      while(index->slots[slot].row_number)
+      {
+         Database_Index_Slot *test = index->slots + slot;
+         if(test->hash == hash)
+         {
+            row = test->row_number - 1;
+            if(strings_are_equal(database_row_key(table, row), key))
+            {
+               found = true;
+               break;
+            }
+         }
+
+         slot = (slot + 1) & mask;
+      }
+   }
+   else if(table->hot_key_size)
+   {
+      // NOTE(law): The index couldn't be allocated, so fall back to a scan.
+      found = database_scan_hot_keys(table, key, hash, &row);
+   }
+
+   if(found)
+   {
+      result = database_row(table, row);
+      if(row_index)
+      {
+         *row_index = row;
+      }
+   }
+
+   return result;
+}
+
+// NOTE(law): Tables use a seqlock. A writer holds the table semaphore for the
+// whole operation (including any file I/O), so writers serialize with each
+// other, but only bumps the sequence around the in-memory changes to the rows
+// and index. A reader never blocks: it notes the sequence, copies what it needs
+// out of the table, and retries if the sequence changed in the meantime. Keys
+// live in fixed-size arrays whose last byte is never written, so a torn read
+// can't run off the end of a key.
+
+static void
+database_begin_write(Database_Table *table)
+{
+   // NOTE(law): The caller is responsible for holding the table lock.
+   table->sequence++;
+   platform_release_fence();
+}
+
+static void
+database_end_write(Database_Table *table)
+{
+   platform_release_fence();
+   table->sequence++;
+}
+
+static unsigned int
+database_begin_read(Database_Table *table)
+{
+   unsigned int result = table->sequence;
+   while(result & 1)
+   {
+      platform_spin_pause();
+      result = table->sequence;
+   }
+   platform_acquire_fence();
+
+   return result;
+}
+
+static bool
+database_end_read(Database_Table *table, unsigned int sequence)
+{
+   // NOTE(law): Returns true if nothing was written since the matching
+   // database_begin_read(), i.e. the data that was read is consistent.
+   platform_acquire_fence();
+
+   bool result = (table->sequence == sequence);
+   return result;
+}
+
+static bool
+database_read_row(Database_Table *table, char *key, void *destination, unsigned int *row_index)
+{
+   // NOTE(law): The lock-free counterpart to database_find_row(). The first row
+   // with the given key is copied to destination (if provided). The index may
+   // be mid-update, so the probe count is bounded by the slot count of the
+   // index being probed, and only a result validated by the sequence is
+   // returned.
+
+   bool result;
+   unsigned int sequence;
+   do
+   {
+      sequence = database_begin_read(table);
+      result = false;
+
+      // NOTE(law): The slots and their count come from the same published
+      // index, so probes stay inside it even if a resize is underway.
+      Database_Index *index = table->index;
+      platform_acquire_fence();
+
+      uint32_t hash = database_hash_key(key);
+      unsigned int row = 0;
+      bool found = false;
+
+      if(index)
+      {
+         Database_Index_Slot *slots = index->slots;
+         unsigned int mask = index->slot_count - 1;
+
+         unsigned int slot = hash & mask;
+         for(unsigned int probe = 0; probe <= mask && slots[slot].row_number; ++probe)
+         {
+            row = slots[slot].row_number - 1;
+            if(slots[slot].hash == hash)
+            {
+               char *row_key = database_row_key(table, row);
+               if(row_key && strings_are_equal(row_key, key))
+               {
+                  found = true;
+                  break;
+               }
+            }
+
+            slot = (slot + 1) & mask;
+         }
+      }
+      else if(table->hot_key_size)
+      {
+         found = database_scan_hot_keys(table, key, hash, &row);
+      }
+
+      // NOTE(law): With hot arrays, the row itself is only touched once its
+      // key has matched.
+      unsigned char *row_memory = (found) ? database_row(table, row) : 0;
+      if(row_memory)
+      {
+         if(destination)
+         {
+            memory_copy(destination, row_memory, table->row_size);
+         }
+         if(row_index)
+         {
+            *row_index = row;
+         }
+
+         result = true;
+      }
+   } while(!database_end_read(table, sequence));
+
+   return result;
+}
+
+static void
+database_allocate_table(Database_Table *result,
+                        size_t row_size,
+                        size_t key_offset,
+                        unsigned int max_row_count,
+                        char *file_path)
+{
+   zero_memory(result, sizeof(Database_Table));
+   result->file_path = file_path;
+
+   result->semaphore = platform_initialize_semaphore();
+
+   result->row_size = row_size;
+   result->key_offset = key_offset;
+
+   result->max_row_count = MINIMUM(max_row_count, DATABASE_MAX_ROW_COUNT);
+   result->rows.element_size = row_size;
+}
+
+static void *
+database_append_row(Database_Table *table)
+{
+   // NOTE(law): Make room for one more row and return it, or 0 if the table is
+   // full. The caller is responsible for holding the table lock and, if the
+   // table is live, wrapping this in database_begin_write/end_write().
+
+   void *result = 0;
+   if(table->row_count < table->max_row_count)
+   {
+      result = database_reserve_element(&table->rows, table->row_count);
+      if(result)
+      {
+         table->row_count++;
+      }
+   }
+
+   return result;
+}
+
+static void
+database_reserve_index(Database_Table *table, unsigned int row_count)
+{
+   // NOTE(law): Grow the index, if needed, so that it can hold row_count rows
+   // at or under half load. The caller is responsible for holding the table
+   // lock, and for calling this before database_begin_write() rather than
+   // inside it: rebuilding the index touches every row, and readers keep
+   // probing the old index until the new one is published.
+
+   if(2 * row_count > database_index_slot_count(table))
+   {
+      database_resize_index(table, 2 * row_count);
+   }
+}
+
+static void
+database_index_row(Database_Table *table, unsigned int row)
+{
+   // NOTE(law): Add a new row to the index. The caller is responsible for
+   // holding the table lock, and for reserving room with
+   // database_reserve_index() first. If growing the index failed and it has no
+   // free slot left, the row is left out of it.
+
+   if(table->row_count < database_index_slot_count(table))
+   {
+      database_index_insert(table, row);
+   }
+}
+
+static void
+database_initialize_table(Database_Table *result,
+                          size_t row_size,
+                          size_t key_offset,
+                          unsigned int max_row_count,
+                          Database_File_Id file_id,
+                          char *file_path)
+{
+   // TODO(law): This structure is mainly for development purposes. I'd like to
+   // get away without needing a real database indefinitely.
+
+   database_allocate_table(result, row_size, key_offset, max_row_count, file_path);
+
+   unsigned int row_count;
+   if(!database_load_file(&result->rows, result->max_row_count, file_id, file_path, &row_count))
+   {
+      result->max_row_count = 0;
+   }
+   result->row_count = row_count;
+
+   database_resize_index(result, result->row_count);
+}
+
+static void
+database_link_row(unsigned int *next, unsigned int *previous, unsigned int *head, unsigned int row)
+{
+   previous[row] = 0;
+   next[row] = *head;
+   if(*head)
+   {
+      previous[*head - 1] = row + 1;
+   }
+   *head = row + 1;
+}
+
+static void
+database_unlink_row(unsigned int *next, unsigned int *previous, unsigned int *head, unsigned int row)
+{
+   if(previous[row])
+   {
+      next[previous[row] - 1] = next[row];
+   }
+   else
+   {
+      *head = next[row];
+   }
+
+   if(next[row])
+   {
+      previous[next[row] - 1] = previous[row];
+   }
+
+   next[row] = 0;
+   previous[row] = 0;
+}
+
+static void
+database_link_session(unsigned int *head, unsigned int row)
+{
+   Session_Wheel *wheel = &database.session_wheel;
+   database_link_row(wheel->next, wheel->previous, head, row);
+}
+
+static void
+database_unlink_session(unsigned int *head, unsigned int row)
+{
+   Session_Wheel *wheel = &database.session_wheel;
+   database_unlink_row(wheel->next, wheel->previous, head, row);
+}
+
+static void
+database_link_user_session(Session_User_List *list, unsigned int row)
+{
+   Session_Wheel *wheel = &database.session_wheel;
+   database_link_row(wheel->user_next, wheel->user_previous, &list->head, row);
+   list->count++;
+}
+
+static void
+database_unlink_user_session(unsigned int user_index, unsigned int row)
+{
+   Session_Wheel *wheel = &database.session_wheel;
+
+   // NOTE(law): Every live session was linked into its user's list, which was
+   // reserved at the time.
+   Session_User_List *list = database_get_element(&wheel->user_lists, user_index);
+   ASSERT(list && list->count);
+
+   database_unlink_row(wheel->user_next, wheel->user_previous, &list->head, row);
+   list->count--;
+}
+
+static unsigned int
+database_oldest_user_session(Session_User_List *list)
+{
+   // NOTE(law): Returns the row of the user's earliest created session. The
+   // list must not be empty. It's never much longer than
+   // MAX_USER_SESSION_COUNT, so it's just scanned.
+
+   Session_Wheel *wheel = &database.session_wheel;
+
+   unsigned int result = list->head - 1;
+   uint64_t oldest = ((User_Session *)database_row(&database.sessions, result))->created;
+
+   for(unsigned int link = wheel->user_next[result]; link; link = wheel->user_next[link - 1])
+   {
+      User_Session *session = database_row(&database.sessions, link - 1);
+      if(session->created < oldest)
+      {
+         oldest = session->created;
+         result = link - 1;
+      }
+   }
+
+   return result;
+}
+
+static unsigned int *
+database_session_wheel_slot(uint64_t expires)
+{
+   Session_Wheel *wheel = &database.session_wheel;
+
+   unsigned int *result = wheel->slot_heads + ((expires / wheel->granularity) % SESSION_WHEEL_SLOT_COUNT);
+   return result;
+}
+
+static void
+database_remove_session_row(unsigned int row, Platform_Work_Entry *durable)
+{
+   // NOTE(law): The caller is responsible for holding the session table lock,
+   // and for waiting on durable (if provided) once it's released.
+
+   User_Session *session = database_row(&database.sessions, row);
+   ASSERT(*session->session_id);
+
+   database_unlink_session(database_session_wheel_slot(session->expires), row);
+   database_unlink_user_session(session->user_index, row);
+
+   database_prepare_element_write(&database.sessions.rows, row);
+
+   database_begin_write(&database.sessions);
+   database_index_remove(&database.sessions, row);
+   zero_memory(session, sizeof(*session));
+   database_end_write(&database.sessions);
+
+   database_log_write(DATABASE_FILE_SESSIONS, database_file_row_offset(sizeof(*session), row), session, sizeof(*session), durable);
+
+   database_link_session(&database.session_wheel.free_head, row);
+   database.session_wheel.active_count--;
+}
+
+static void
+database_sweep_sessions(uint64_t now, unsigned int budget)
+{
+   // NOTE(law): Remove up to budget expired sessions, picking up where the last
+   // sweep left off. Every slot behind the current tick only holds expired
+   // sessions. The current slot may also hold sessions due later in the same
+   // tick, so it's rescanned until the wheel moves past it. The caller is
+   // responsible for holding the session table lock.
+
+   Session_Wheel *wheel = &database.session_wheel;
+
+   uint64_t current_tick = now / wheel->granularity;
+   if(current_tick - wheel->swept_tick > SESSION_WHEEL_SLOT_COUNT)
+   {
+      wheel->swept_tick = current_tick - SESSION_WHEEL_SLOT_COUNT;
+   }
+
+   while(budget > 0)
+   {
+      unsigned int *head = wheel->slot_heads + (wheel->swept_tick % SESSION_WHEEL_SLOT_COUNT);
+
+      unsigned int link = *head;
+      while(link && budget > 0)
+      {
+         unsigned int row = link - 1;
+         link = wheel->next[row];
+
+         User_Session *session = database_row(&database.sessions, row);
+         if(session->expires <= now)
+         {
+            database_remove_session_row(row, 0);
+            budget--;
+         }
+      }
+
+      if(link || wheel->swept_tick >= current_tick)
+      {
+         break;
+      }
+
+      wheel->swept_tick++;
+   }
+}
+
+static void
+database_initialize_session_wheel(void)
+{
+   // NOTE(law): Sessions that expired while the server was down are dropped
+   // here, and every other row is filed into the wheel.
+
+   Session_Wheel *wheel = &database.session_wheel;
+   zero_memory(wheel, sizeof(*wheel));
+
+   size_t links_size = database.sessions.max_row_count * sizeof(unsigned int);
+   wheel->next = PUSH_SIZE(&database.arena, links_size);
+   wheel->previous = PUSH_SIZE(&database.arena, links_size);
+   wheel->user_next = PUSH_SIZE(&database.arena, links_size);
+   wheel->user_previous = PUSH_SIZE(&database.arena, links_size);
+   zero_memory(wheel->next, links_size);
+   zero_memory(wheel->previous, links_size);
+   zero_memory(wheel->user_next, links_size);
+   zero_memory(wheel->user_previous, links_size);
+
+   wheel->user_lists.element_size = sizeof(Session_User_List);
+
+   wheel->granularity = (SESSION_LIFETIME_SECONDS / (SESSION_WHEEL_SLOT_COUNT - 2)) + 1;
+
+   uint64_t now = (uint64_t)time(0);
+   wheel->swept_tick = now / wheel->granularity;
+
+   // NOTE(law): Link in reverse so that the free list hands out low rows first.
+   for(unsigned int row = database.sessions.row_count; row > 0; --row)
+   {
+      User_Session *session = database_row(&database.sessions, row - 1);
+
+      Session_User_List *list = 0;
+      if(*session->session_id && session->expires > now)
+      {
+         list = database_reserve_element(&wheel->user_lists, session->user_index);
+      }
+
+      if(list)
+      {
+         database_link_session(database_session_wheel_slot(session->expires), row - 1);
+         database_link_user_session(list, row - 1);
+         wheel->active_count++;
+
+         // NOTE(law): The file may hold more sessions for a user than they're
+         // allowed, e.g. if it predates the limit.
+         if(list->count > MAX_USER_SESSION_COUNT)
+         {
+            unsigned int oldest = database_oldest_user_session(list);
+            User_Session *oldest_session = database_row(&database.sessions, oldest);
+
+            database_unlink_session(database_session_wheel_slot(oldest_session->expires), oldest);
+            database_unlink_user_session(oldest_session->user_index, oldest);
+            database_index_remove(&database.sessions, oldest);
+            zero_memory(oldest_session, sizeof(*oldest_session));
+            database_link_session(&wheel->free_head, oldest);
+            wheel->active_count--;
+         }
+      }
+      else
+      {
+         if(*session->session_id)
+         {
+            database_index_remove(&database.sessions, row - 1);
+         }
+         zero_memory(session, sizeof(*session));
+         database_link_session(&wheel->free_head, row - 1);
+      }
+   }
+}
+
+static Database_Table *
+database_user_shard_for_hash(uint32_t hash)
+{
+   // NOTE(law): The top bits of the hash pick the shard, since the bottom bits
+   // pick the home slot within the shard's index.
+   Database_Table *result = database.users.shards + (hash >> (32 - USER_SHARD_BITS));
+   return result;
+}
+
+static Database_Table *
+database_user_shard(char *username)
+{
+   Database_Table *result = database_user_shard_for_hash(database_hash_key(username));
+   return result;
+}
+
+static bool
+database_place_user(User_Account *source, unsigned int id, uint32_t hash)
+{
+   // NOTE(law): Add the user with the given id (and username hash) to its
+   // shard, copying it into the row store first unless source is already
+   // there. The caller is responsible for holding the shard lock, indexing the
+   // row, and, if the table is live, wrapping this in database_begin_write()
+   // and database_end_write().
+
+   Database_Sharded_Table *users = &database.users;
+
+   Database_Table *shard = database_user_shard_for_hash(hash);
+   unsigned int shard_index = (unsigned int)(shard - users->shards);
+
+   User_Account *user = database_reserve_element(&users->rows, id);
+   Database_Row_Location *location = database_reserve_element(&users->locations, id);
+   if(!user || !location)
+   {
+      return false;
+   }
+
+   unsigned int row = shard->row_count;
+   if(row >= shard->max_row_count || !database_set_hot_key(shard, row, source->username, hash))
+   {
+      return false;
+   }
+
+   unsigned int *row_id = database_append_row(shard);
+   if(!row_id)
+   {
+      return false;
+   }
+
+   if(user != source)
+   {
+      database_prepare_element_write(&users->rows, id);
+      memory_copy(user, source, sizeof(*user));
+   }
+   *row_id = id;
+   location->shard = shard_index;
+   location->row = row;
+
+   return true;
+}
+
+static void
+database_unplace_user(Database_Table *shard, unsigned int row, unsigned int id)
+{
+   // NOTE(law): Undo database_place_user() for a user whose insert never
+   // reached the log. The shard row and the id stay used up, as an empty row,
+   // the same as an empty row loaded from the file. The caller is responsible
+   // for holding the shard lock and wrapping this in database_begin_write() and
+   // database_end_write().
+
+   Database_Sharded_Table *users = &database.users;
+
+   database_index_remove(shard, row);
+   database_set_hot_key(shard, row, "", 0);
+   zero_memory(database_get_element(&users->rows, id), sizeof(User_Account));
+
+   Database_Row_Location *location = database_get_element(&users->locations, id);
+   location->shard = USER_SHARD_COUNT;
+}
+
+static void
+database_initialize_users(char *file_path)
+{
+   Database_Sharded_Table *users = &database.users;
+   zero_memory(users, sizeof(*users));
+
+   users->file_path = file_path;
+   users->max_row_count = DATABASE_MAX_ROW_COUNT;
+   users->id_semaphore = platform_initialize_semaphore();
+   users->rows.element_size = sizeof(User_Account);
+   users->locations.element_size = sizeof(Database_Row_Location);
+
+   for(unsigned int index = 0; index < USER_SHARD_COUNT; ++index)
+   {
+      Database_Table *shard = users->shards + index;
+      database_allocate_table(shard,
+                              sizeof(User_Account),
+                              offsetof(User_Account, username),
+                              DATABASE_MAX_ROW_COUNT,
+                              file_path);
+
+      shard->rows.element_size = sizeof(unsigned int);
+      shard->row_store = &users->rows;
+
+      // NOTE(law): A user row is about 150 bytes, while the username and its
+      // hash take up 36, and fill cache lines with nothing but keys.
+      shard->hot_key_size = sizeof(((User_Account *)0)->username);
+      shard->hot_keys.element_size = shard->hot_key_size;
+      shard->hot_hashes.element_size = sizeof(uint32_t);
+   }
+
+   unsigned int row_count;
+   if(!database_load_file(&users->rows, users->max_row_count, DATABASE_FILE_USERS, file_path, &row_count))
+   {
+      users->max_row_count = 0;
+   }
+
+   // NOTE(law): Size each shard's index for a little over its share of the
+   // rows up front, so that every key is hashed only once while loading. A
+   // shard that fills up faster than that still grows as usual.
+   unsigned int expected_shard_row_count = (row_count / USER_SHARD_COUNT) + (row_count / (4 * USER_SHARD_COUNT));
+   for(unsigned int index = 0; index < USER_SHARD_COUNT; ++index)
+   {
+      database_resize_index(users->shards + index, expected_shard_row_count);
+   }
+
+   for(unsigned int id = 0; id < row_count; ++id)
+   {
+      // NOTE(law): An empty row still uses up its id, so that later ids keep
+      // matching positions in the file.
+      User_Account *user = database_get_element(&users->rows, id);
+
+      bool placed = false;
+      if(*user->username)
+      {
+         uint32_t hash = database_hash_key(user->username);
+         Database_Table *shard = database_user_shard_for_hash(hash);
+
+         database_reserve_index(shard, shard->row_count + 1);
+         placed = database_place_user(user, id, hash);
+         if(placed && shard->row_count < database_index_slot_count(shard))
+         {
+            database_index_insert_hash(shard, shard->row_count - 1, hash);
+         }
+      }
+
+      if(!placed)
+      {
+         if(*user->username)
+         {
+            platform_log_message("[ERROR] Failed to load user %u from %s.", id, file_path);
+         }
+
+         Database_Row_Location *location = database_reserve_element(&users->locations, id);
+         if(location)
+         {
+            location->shard = USER_SHARD_COUNT;
+         }
+      }
+   }
+   users->row_count = row_count;
+}
+
+static void
+database_initialize(size_t arena_soft_limit)
+{
+   if(reserve_arena(&database.arena, arena_soft_limit, HUGE_PAGE_FLAGS))
+   {
+      platform_log_message("Database arena backed by %s pages.", page_backing_name(database.arena.page_backing));
+   }
+   else
+   {
+      platform_log_message("[ERROR] Failed to reserve the database arena.");
+   }
+
+   database.work_queue = platform_initialize_work_queue(DATABASE_THREAD_COUNT, 4 * DATABASE_THREAD_COUNT);
+   database.next_compaction_time = (uint64_t)time(0) + DATABASE_COMPACTION_INTERVAL_SECONDS;
+
+   database.snapshot_semaphore = platform_initialize_semaphore();
+   for(unsigned int file_id = 0; file_id < DATABASE_FILE_COUNT; ++file_id)
+   {
+      Database_Snapshot *snapshot = database.snapshots + file_id;
+      zero_memory(snapshot, sizeof(*snapshot));
+      snapshot->semaphore = platform_initialize_semaphore();
+   }
+
+   char *file_paths[DATABASE_FILE_COUNT];
+   file_paths[DATABASE_FILE_USERS] = "users.dbsp";
+   file_paths[DATABASE_FILE_SESSIONS] = "sessions.dbsp";
+
+   size_t row_sizes[DATABASE_FILE_COUNT];
+   row_sizes[DATABASE_FILE_USERS] = sizeof(User_Account);
+   row_sizes[DATABASE_FILE_SESSIONS] = sizeof(User_Session);
+
+   database_initialize_log("database.log", file_paths, row_sizes);
+
+   database_initialize_users(file_paths[DATABASE_FILE_USERS]);
+
+   database_initialize_table(&database.sessions,
+                             sizeof(User_Session),
+                             offsetof(User_Session, session_id),
+                             MAX_SESSION_COUNT,
+                             DATABASE_FILE_SESSIONS,
+                             file_paths[DATABASE_FILE_SESSIONS]);
+   database_initialize_session_wheel();
+
+   zero_memory(&database.user_session_generations, sizeof(database.user_session_generations));
+   database.user_session_generations.element_size = sizeof(unsigned int);
+
+   database.users.rows.snapshot = database.snapshots + DATABASE_FILE_USERS;
+   database.sessions.rows.snapshot = database.snapshots + DATABASE_FILE_SESSIONS;
+}
+
+static bool
+database_insert_user(char *username,
+                     unsigned char *salt,
+                     unsigned char *password_hash,
+                     unsigned int iteration_count)
+{
+   // NOTE(law): Only the shard that owns the username is locked, so inserts
+   // into different shards proceed in parallel. A username that already exists
+   // is left alone. Returns true once the new user is durable. If the insert
+   // fails to reach the log, it is taken back out of memory.
+
+   Database_Sharded_Table *users = &database.users;
+   bool result = false;
+
+   uint32_t hash = database_hash_key(username);
+   Database_Table *shard = database_user_shard_for_hash(hash);
+
+   platform_lock(shard->semaphore);
+
+   if(!database_find_row(shard, username, 0))
+   {
+      User_Account user = {0};
+      memory_copy(user.username, username, string_length(username));
+      memory_copy(user.salt, salt, sizeof(user.salt));
+      memory_copy(user.password_hash, password_hash, sizeof(user.password_hash));
+      user.iteration_count = iteration_count;
+
+      bool placed = false;
+      Platform_Work_Entry durable;
+
+      platform_lock(users->id_semaphore);
+      unsigned int id = users->row_count;
+      if(id < users->max_row_count)
+      {
+         database_reserve_index(shard, shard->row_count + 1);
+
+         database_begin_write(shard);
+         placed = database_place_user(&user, id, hash);
+         if(placed)
+         {
+            database_index_row(shard, shard->row_count - 1);
+         }
+         database_end_write(shard);
+
+         // NOTE(law): Publish the id only once its location has been written.
+         if(placed)
+         {
+            platform_release_fence();
+            users->row_count = id + 1;
+         }
+      }
+      platform_unlock(users->id_semaphore);
+
+      // Add entry to database.
+      if(placed)
+      {
+         database_log_write(DATABASE_FILE_USERS, database_file_row_offset(sizeof(user), id), &user, sizeof(user), &durable);
+      }
+
+      platform_unlock(shard->semaphore);
+
+      if(placed)
+      {
+         result = database_wait_for_log(&durable);
+         if(!result)
+         {
+            platform_lock(shard->semaphore);
+
+            unsigned int row = ((Database_Row_Location *)database_get_element(&users->locations, id))->row;
+            database_prepare_element_write(&users->rows, id);
+
+            database_begin_write(shard);
+            database_unplace_user(shard, row, id);
+            database_end_write(shard);
+
+            // NOTE(law): Log the undo as well. The insert never reached the
+            // file, but a compaction running meanwhile may have snapshotted
+            // the row, and the undo is replayed into the compacted file.
+            database_log_write(DATABASE_FILE_USERS, database_file_row_offset(sizeof(user), id),
+                               database_get_element(&users->rows, id), sizeof(user), 0);
+
+            platform_unlock(shard->semaphore);
+         }
+      }
+   }
+   else
+   {
+      platform_unlock(shard->semaphore);
+   }
+
+   return result;
+}
+
+static User_Account
+database_get_user_by_username(char *username)
+{
+   User_Account result = {0};
+   if(!database_read_row(database_user_shard(username), username, &result, 0))
+   {
+      zero_memory(&result, sizeof(result));
+   }
+
+   return result;
+}
+
+static bool
+database_get_user_by_index(unsigned int index, User_Account *result)
+{
+   // NOTE(law): Look up a user by id, without taking any lock.
+
+   Database_Sharded_Table *users = &database.users;
+   if(index >= users->row_count)
+   {
+      return false;
+   }
+   platform_acquire_fence();
+
+   Database_Row_Location *location_memory = database_get_element(&users->locations, index);
+   if(!location_memory || location_memory->shard >= USER_SHARD_COUNT)
+   {
+      return false;
+   }
+
+   Database_Row_Location location = *location_memory;
+   Database_Table *shard = users->shards + location.shard;
+
+   bool found;
+   unsigned int sequence;
+   do
+   {
+      sequence = database_begin_read(shard);
+
+      User_Account *user = database_get_element(&users->rows, index);
+      found = (user && location.row < shard->row_count);
+      if(found)
+      {
+         memory_copy(result, user, sizeof(*result));
+      }
+   } while(!database_end_read(shard, sequence));
+
+   return found;
+}
+
+static User_Account *
+database_snapshot_users(Memory_Arena *arena, unsigned int *count)
+{
+   // NOTE(law): Copy every user, in id order, as of a single point in time. All
+   // of the shard locks are held for the duration (always taken in the same
+   // order), which holds off writers to the table but not readers. Returns 0 if
+   // the arena doesn't have room.
+
+   Database_Sharded_Table *users = &database.users;
+
+   for(unsigned int index = 0; index < USER_SHARD_COUNT; ++index)
+   {
+      platform_lock(users->shards[index].semaphore);
+   }
+
+   *count = users->row_count;
+
+   User_Account *result = PUSH_SIZE(arena, *count * sizeof(User_Account));
+   if(result)
+   {
+      for(unsigned int id = 0; id < *count; ++id)
+      {
+         Database_Row_Location *location = database_get_element(&users->locations, id);
+         if(location && location->shard < USER_SHARD_COUNT)
+         {
+            User_Account *user = database_get_element(&users->rows, id);
+            memory_copy(result + id, user, sizeof(*user));
+         }
+         else
+         {
+            zero_memory(result + id, sizeof(*result));
+         }
+      }
+   }
+
+   for(unsigned int index = USER_SHARD_COUNT; index > 0; --index)
+   {
+      platform_unlock(users->shards[index - 1].semaphore);
+   }
+
+   return result;
+}
+
+static bool
+database_insert_session(char *session_id, unsigned int user_index)
+{
+   // NOTE(law): A user who already has MAX_USER_SESSION_COUNT sessions loses
+   // their oldest one to make room, so one account logging in over and over
+   // only churns through its own sessions. If the table is still full after
+   // that and a sweep, the session closest to expiring is evicted, whoever it
+   // belongs to, so the table never grows past MAX_SESSION_COUNT.
+
+   ASSERT(string_length(session_id) == SESSION_ID_LENGTH);
+
+   bool result = false;
+   uint64_t now = (uint64_t)time(0);
+
+   Session_Wheel *wheel = &database.session_wheel;
+   Platform_Work_Entry durable;
+
+   platform_lock(database.sessions.semaphore);
+
+   Session_User_List *list = database_reserve_element(&wheel->user_lists, user_index);
+   if(!list)
+   {
+      platform_unlock(database.sessions.semaphore);
+      return false;
+   }
+
+   if(list->count >= MAX_USER_SESSION_COUNT)
+   {
+      database_remove_session_row(database_oldest_user_session(list), 0);
+   }
+
+   database_sweep_sessions(now, 16);
+
+   if(!wheel->free_head && database.sessions.row_count == database.sessions.max_row_count)
+   {
+      for(unsigned int offset = 0; offset < SESSION_WHEEL_SLOT_COUNT; ++offset)
+      {
+         unsigned int head = wheel->slot_heads[(wheel->swept_tick + offset) % SESSION_WHEEL_SLOT_COUNT];
+         if(head)
+         {
+            database_remove_session_row(head - 1, 0);
+            break;
+         }
+      }
+   }
+
+   unsigned int row = 0;
+   bool found_row = true;
+   bool append = false;
+   if(wheel->free_head)
+   {
+      row = wheel->free_head - 1;
+      database_unlink_session(&wheel->free_head, row);
+   }
+   else if(database.sessions.row_count < database.sessions.max_row_count)
+   {
+      row = database.sessions.row_count;
+      append = true;
+      database_reserve_index(&database.sessions, row + 1);
+   }
+   else
+   {
+      found_row = false;
+   }
+
+   if(found_row)
+   {
+      database_prepare_element_write(&database.sessions.rows, row);
+
+      database_begin_write(&database.sessions);
+
+      User_Session *session = (append) ? database_append_row(&database.sessions) : database_row(&database.sessions, row);
+      if(session)
+      {
+         zero_memory(session, sizeof(*session));
+
+         memory_copy(session->session_id, session_id, SESSION_ID_LENGTH);
+         session->user_index = user_index;
+         session->created = now;
+         session->expires = now + SESSION_LIFETIME_SECONDS;
+
+         database_index_row(&database.sessions, row);
+      }
+
+      database_end_write(&database.sessions);
+
+      if(session)
+      {
+         database_link_session(database_session_wheel_slot(session->expires), row);
+         database_link_user_session(list, row);
+         wheel->active_count++;
+
+         database_log_write(DATABASE_FILE_SESSIONS, database_file_row_offset(sizeof(*session), row), session, sizeof(*session), &durable);
+         result = true;
+      }
+   }
+
+   platform_unlock(database.sessions.semaphore);
+
+   if(result)
+   {
+      result = database_wait_for_log(&durable);
+      if(!result)
+      {
+         // NOTE(law): The session never reached the log, so take it back out,
+         // unless it has already been swept or evicted in the meantime.
+         platform_lock(database.sessions.semaphore);
+
+         if(database_find_row(&database.sessions, session_id, &row))
+         {
+            database_remove_session_row(row, 0);
+         }
+
+         platform_unlock(database.sessions.semaphore);
+      }
+   }
+
+   return result;
+}
+
 static void
-database_initialize_table(Database_Table *result, size_t row_size, char *file_path)
+database_delete_session(char *session_id)
 {
-   // TODO(law): This structure is mainly for development purposes. I'd like to
-   // get away without needing a real database indefinitely.
+   // NOTE(law): If the delete fails to reach the log, the session still stays
+   // deleted in memory, since that errs on the side of logging the user out. It
+   // would only come back from the file after a restart, until it expires.
 
-   zero_memory(result, sizeof(Database_Table));
-   result->file_path = file_path;
+   Platform_Work_Entry durable;
 
-   result->semaphore = platform_initialize_semaphore();
+   platform_lock(database.sessions.semaphore);
+
+   unsigned int row;
+   bool found = (database_find_row(&database.sessions, session_id, &row) != 0);
+   if(found)
+   {
+      database_remove_session_row(row, &durable);
+   }
 
-   result->max_row_count = 10000;
-   result->rows = PUSH_SIZE(&database.arena, row_size * result->max_row_count);
+   platform_unlock(database.sessions.semaphore);
 
-   Platform_File disk = platform_read_file(file_path);
-   if(disk.memory)
+   if(found)
+   {
+      database_wait_for_log(&durable);
+   }
+}
+
+static User_Account
+database_get_user_by_session(char *session_id)
+{
+   // NOTE(law): Lookups don't take either table lock. An expired session that
+   // hasn't been swept yet is treated as missing, and left for the sweeper.
+
+   User_Account result = {0};
+
+   User_Session session;
+   if(database_read_row(&database.sessions, session_id, &session, 0) &&
+      session.expires > (uint64_t)time(0))
+   {
+      if(!database_get_user_by_index(session.user_index, &result))
+      {
+         zero_memory(&result, sizeof(result));
+      }
+   }
+
+   return result;
+}
+
+static bool
+database_update_user_password(char *username,
+                              unsigned char *salt,
+                              unsigned char *password_hash,
+                              unsigned int iteration_count)
+{
+   // NOTE(law): Returns true once the new password is durable. If the update
+   // fails to reach the log, the previous password is put back, unless a later
+   // update has replaced it in the meantime.
+
+   Database_Table *shard = database_user_shard(username);
+   Platform_Work_Entry durable;
+   User_Account previous;
+   bool result = false;
+
+   platform_lock(shard->semaphore);
+
+   unsigned int row;
+   User_Account *user = database_find_row(shard, username, &row);
+   if(user)
+   {
+      previous = *user;
+
+      unsigned int id = *(unsigned int *)database_get_element(&shard->rows, row);
+      database_prepare_element_write(&database.users.rows, id);
+
+      database_begin_write(shard);
+      memory_copy(user->salt, salt, sizeof(user->salt));
+      memory_copy(user->password_hash, password_hash, sizeof(user->password_hash));
+      user->iteration_count = iteration_count;
+      database_end_write(shard);
+
+      // NOTE(law): A user's id is its position in the file, so the row can be
+      // overwritten in place. Sessions are not persisted.
+      User_Account copy = *user;
+      zero_memory(copy.session_id, sizeof(copy.session_id));
+
+      database_log_write(DATABASE_FILE_USERS, database_file_row_offset(sizeof(copy), id), &copy, sizeof(copy), &durable);
+   }
+
+   platform_unlock(shard->semaphore);
+
+   if(user)
    {
-      // TODO(law): Check for file corruption more thoroughly.
-      if((disk.size % row_size) == 0)
+      result = database_wait_for_log(&durable);
+      if(!result)
       {
-         size_t database_offset = 0;
-         while(database_offset < disk.size)
+         platform_lock(shard->semaphore);
+
+         user = database_find_row(shard, username, &row);
+         if(user &&
+            bytes_are_equal(user->salt, salt, sizeof(user->salt)) &&
+            bytes_are_equal(user->password_hash, password_hash, sizeof(user->password_hash)))
          {
-            unsigned char *source = disk.memory + database_offset;
-            unsigned char *destination = (unsigned char *)result->rows + database_offset;
-            memory_copy(destination, source, row_size);
+            unsigned int id = *(unsigned int *)database_get_element(&shard->rows, row);
+            database_prepare_element_write(&database.users.rows, id);
+
+            database_begin_write(shard);
+            memory_copy(user->salt, previous.salt, sizeof(user->salt));
+            memory_copy(user->password_hash, previous.password_hash, sizeof(user->password_hash));
+            user->iteration_count = previous.iteration_count;
+            database_end_write(shard);
 
-            result->row_count++;
-            database_offset += row_size;
+            // NOTE(law): Logged for the same reason as the undo in
+            // database_insert_user().
+            User_Account copy = *user;
+            zero_memory(copy.session_id, sizeof(copy.session_id));
+            database_log_write(DATABASE_FILE_USERS, database_file_row_offset(sizeof(copy), id), &copy, sizeof(copy), 0);
          }
+
+         platform_unlock(shard->semaphore);
       }
-      else
+   }
+
+   return result;
+}
+
+static bool
+database_get_user_index(char *username, unsigned int *index)
+{
+   // NOTE(law): Returns the id of the user (see Database_Sharded_Table).
+
+   Database_Table *shard = database_user_shard(username);
+
+   unsigned int row;
+   bool result = database_read_row(shard, username, 0, &row);
+   if(result)
+   {
+      // NOTE(law): Row ids are written before the row is published and never
+      // change afterwards.
+      unsigned int *id = database_get_element(&shard->rows, row);
+      result = (id != 0);
+      if(result)
       {
-         platform_log_message("[ERROR] The database table %s was not properly formatted.", file_path);
+         *index = *id;
       }
+   }
+
+   return result;
+}
+
+static unsigned int
+database_get_user_session_generation(unsigned int index)
+{
+   // NOTE(law): A user whose generation was never bumped may not have storage
+   // for it yet, and is on generation 0.
+   volatile unsigned int *generation = database_get_element(&database.user_session_generations, index);
+
+   unsigned int result = (generation) ? *generation : 0;
+   return result;
+}
+
+static void
+database_revoke_user_sessions(unsigned int index)
+{
+   platform_lock(database.users.id_semaphore);
+
+   volatile unsigned int *generation = database_reserve_element(&database.user_session_generations, index);
+   if(generation)
+   {
+      (*generation)++;
+   }
 
-      platform_free_file(&disk);
+   platform_unlock(database.users.id_semaphore);
+}
+
+static void
+database_lock_file(Database_File_Id file_id)
+{
+   // NOTE(law): Hold off every writer to the tables stored in the file. Shard
+   // locks are always taken in the same order.
+
+   if(file_id == DATABASE_FILE_USERS)
+   {
+      for(unsigned int index = 0; index < USER_SHARD_COUNT; ++index)
+      {
+         platform_lock(database.users.shards[index].semaphore);
+      }
    }
    else
    {
-      platform_log_message("[WARNING] The database table %s was not found.", file_path);
+      platform_lock(database.sessions.semaphore);
    }
 }
 
 static void
-database_initialize(size_t size)
+database_unlock_file(Database_File_Id file_id)
+{
+   if(file_id == DATABASE_FILE_USERS)
+   {
+      for(unsigned int index = USER_SHARD_COUNT; index > 0; --index)
+      {
+         platform_unlock(database.users.shards[index - 1].semaphore);
+      }
+   }
+   else
+   {
+      platform_unlock(database.sessions.semaphore);
+   }
+}
+
+static Database_Chunked_Array *
+database_file_rows(Database_File_Id file_id, unsigned int *row_count)
 {
-   unsigned char *base_address = platform_allocate(size);
-   initialize_arena(&database.arena, base_address, size);
+   // NOTE(law): Returns the rows stored in the file, in file order. The caller
+   // is responsible for holding the file lock.
+
+   Database_Chunked_Array *result;
+   if(file_id == DATABASE_FILE_USERS)
+   {
+      result = &database.users.rows;
+      *row_count = database.users.row_count;
+   }
+   else
+   {
+      result = &database.sessions.rows;
+      *row_count = database.sessions.row_count;
+   }
 
-   database_initialize_table(&database.users, sizeof(User_Account), "users.dbsp");
+   return result;
 }
 
 static void
-database_insert_user(char *username,
-                     unsigned char *salt,
-                     unsigned char *password_hash,
-                     unsigned int iteration_count)
+database_begin_snapshot(Database_File_Id file_id, Database_Log_Compaction *compaction)
 {
-   // TODO(law): Taking a lock around the entire insertion process for all
-   // interactions with the user table is overkill. Determine the best way to
-   // handle multiple readers/writers here.
+   // NOTE(law): Start a snapshot of the file's rows as of now. If compaction is
+   // provided, the log is marked at the same instant. The caller is responsible
+   // for holding the snapshot semaphore.
 
-   // TODO(law): Restructure this to use a hash table.
+   Database_Snapshot *snapshot = database.snapshots + file_id;
 
-   platform_lock(database.users.semaphore);
+   database_lock_file(file_id);
 
-   if(database.users.row_count < database.users.max_row_count)
-   {
-      User_Account *user = (User_Account *)database.users.rows + database.users.row_count++;
-      zero_memory(user, sizeof(*user));
+   unsigned int row_count;
+   database_file_rows(file_id, &row_count);
 
-      memory_copy(user->username, username, string_length(username));
-      memory_copy(user->salt, salt, sizeof(user->salt));
-      memory_copy(user->password_hash, password_hash, sizeof(user->password_hash));
-      user->iteration_count = iteration_count;
+   platform_lock(snapshot->semaphore);
+   snapshot->failed = false;
+   snapshot->element_count = row_count;
+   snapshot->chunk_count = (row_count + DATABASE_CHUNK_ELEMENT_COUNT - 1) >> DATABASE_CHUNK_BITS;
+   zero_memory(snapshot->copied, snapshot->chunk_count * sizeof(snapshot->copied[0]));
+   zero_memory(snapshot->copies, snapshot->chunk_count * sizeof(snapshot->copies[0]));
+   snapshot->active = true;
+   platform_unlock(snapshot->semaphore);
 
-      // Add entry to database.
-      platform_append_file(database.users.file_path, user, sizeof(*user));
+   if(compaction)
+   {
+      compaction->file_id = file_id;
+      database_mark_log(compaction);
    }
 
-   platform_unlock(database.users.semaphore);
+   database_unlock_file(file_id);
 }
 
-static User_Account
-database_get_user_by_username(char *username)
+static bool
+database_write_snapshot(Database_File_Id file_id, char *file_path)
 {
-   // TODO(law): Taking a lock around the entire lookup process for all
-   // interactions with the user table is overkill. Determine the best way to
-   // handle multiple readers/writers here.
+   // NOTE(law): Write out and end the snapshot started by
+   // database_begin_snapshot(). Writers are never held off for longer than it
+   // takes to copy one chunk. Returns whether the whole snapshot made it to
+   // disk.
 
-   // TODO(law): Restructure this to use a hash lookup on the user name.
+   Database_Snapshot *snapshot = database.snapshots + file_id;
 
-   User_Account result = {0};
+   unsigned int ignored;
+   Database_Chunked_Array *array = database_file_rows(file_id, &ignored);
 
-   platform_lock(database.users.semaphore);
+   struct Platform_File_Handle *file = platform_open_file(file_path);
+   bool result = (file &&
+                  platform_truncate_file(file, 0) &&
+                  database_write_file_header(file, array->element_size));
 
-   for(unsigned int index = 0; index < database.users.row_count; ++index)
+   for(unsigned int chunk_index = 0; chunk_index < snapshot->chunk_count; ++chunk_index)
    {
-      User_Account *user = (User_Account *)database.users.rows + index;
-      if(strings_are_equal(user->username, username))
+      platform_lock(snapshot->semaphore);
+      if(result && !snapshot->copied[chunk_index])
       {
-         result = *user;
-         break;
+         database_copy_snapshot_chunk(array, snapshot, chunk_index);
+      }
+      platform_unlock(snapshot->semaphore);
+
+      // NOTE(law): Once a chunk is marked copied, writers leave its copy alone.
+      unsigned char *copy = snapshot->copies[chunk_index];
+      if(result && copy)
+      {
+         unsigned int first_element = chunk_index << DATABASE_CHUNK_BITS;
+         unsigned int element_count = MINIMUM(DATABASE_CHUNK_ELEMENT_COUNT, snapshot->element_count - first_element);
+
+         result = database_write_file_chunk(file, array->element_size, chunk_index, copy, element_count);
+      }
+      else
+      {
+         result = false;
+      }
+
+      if(copy)
+      {
+         platform_deallocate(copy);
+         snapshot->copies[chunk_index] = 0;
+      }
+   }
+
+   platform_lock(snapshot->semaphore);
+   result = result && !snapshot->failed;
+   snapshot->active = false;
+   platform_unlock(snapshot->semaphore);
+
+   // NOTE(law): A writer may have copied a chunk after the loop gave up.
+   for(unsigned int chunk_index = 0; chunk_index < snapshot->chunk_count; ++chunk_index)
+   {
+      if(snapshot->copies[chunk_index])
+      {
+         platform_deallocate(snapshot->copies[chunk_index]);
+         snapshot->copies[chunk_index] = 0;
       }
    }
 
-   platform_unlock(database.users.semaphore);
+   if(file)
+   {
+      result = result && platform_sync_file(file);
+      platform_close_file(file);
+   }
+
+   if(!result)
+   {
+      platform_log_message("[ERROR] Failed to write a snapshot of the database to %s.", file_path);
+   }
 
    return result;
 }
 
-static User_Account
-database_get_user_by_session(char *session_id)
+static bool
+database_snapshot_table(Database_File_Id file_id, char *file_path)
 {
-   User_Account result = {0};
+   // NOTE(law): Write a consistent copy of a table file to file_path (e.g. for
+   // a backup) while the server keeps running. The copy has the same format as
+   // the table file, and can be loaded in its place.
 
-   // TODO(law): Taking a lock around the entire lookup process for all
-   // interactions with the user table is overkill. Determine the best way to
-   // handle multiple readers/writers here.
+   platform_lock(database.snapshot_semaphore);
 
-   // TODO(law): Restructure this to use a hash lookup on the username.
+   database_begin_snapshot(file_id, 0);
+   bool result = database_write_snapshot(file_id, file_path);
 
-   platform_lock(database.users.semaphore);
+   platform_unlock(database.snapshot_semaphore);
 
-   for(unsigned int index = 0; index < database.users.row_count; ++index)
+   return result;
+}
+
+static void
+database_backup_tables(void)
+{
+   // NOTE(law): Snapshot every table file into the working directory, named
+   // after the file and the time of the backup (e.g.
+   // backup-1700000000-users.dbsp).
+
+   uint64_t now = (uint64_t)time(0);
+   for(unsigned int file_id = 0; file_id < DATABASE_FILE_COUNT; ++file_id)
    {
-      User_Account *user = (User_Account *)database.users.rows + index;
-      if(strings_are_equal(user->session_id, session_id))
+      char *file_path = (file_id == DATABASE_FILE_USERS) ? database.users.file_path : database.sessions.file_path;
+
+      char backup_path[256];
+      format_string(backup_path, sizeof(backup_path), "backup-%llu-%s", (unsigned long long)now, file_path);
+
+      if(database_snapshot_table(file_id, backup_path))
       {
-         result = *user;
-         break;
+         platform_log_message("Backed up %s to %s.", file_path, backup_path);
       }
    }
+}
+
+static bool
+database_compact_table(Database_File_Id file_id)
+{
+   // NOTE(law): Rewrite a table file from a snapshot of memory, and rename it
+   // over the original while serving continues. The new file drops anything
+   // stale that the old one has accumulated past the live rows, such as space
+   // left by torn writes or rows beyond the current row count, and is written
+   // out sequentially.
+
+   char *file_path = (file_id == DATABASE_FILE_USERS) ? database.users.file_path : database.sessions.file_path;
+
+   char replacement_path[256];
+   format_string(replacement_path, sizeof(replacement_path), "%s.compact", file_path);
+
+   platform_lock(database.snapshot_semaphore);
+
+   Database_Log_Compaction compaction = {0};
+   database_begin_snapshot(file_id, &compaction);
 
-   platform_unlock(database.users.semaphore);
+   bool written = database_write_snapshot(file_id, replacement_path);
+   bool result = database_swap_log_file(&compaction, (written) ? replacement_path : 0);
+
+   platform_unlock(database.snapshot_semaphore);
 
    return result;
 }
 
+static
+PLATFORM_WORK_QUEUE_CALLBACK(database_compact_tables)
+{
+   for(unsigned int file_id = 0; file_id < DATABASE_FILE_COUNT; ++file_id)
+   {
+      if(!database_compact_table(file_id))
+      {
+         platform_log_message("[ERROR] Failed to compact database file %u.", file_id);
+      }
+   }
+
+   platform_release_fence();
+   database.compaction_running = false;
+}
+
 static void
-database_update_user_session_id(char *username, char *session_id)
+database_schedule_compaction(void)
 {
-   platform_lock(database.users.semaphore);
+   // NOTE(law): Only called from the log writer thread, after each batch, so
+   // tables are only compacted while something is being written to them.
 
-   for(unsigned int index = 0; index < database.users.row_count; ++index)
+   if(database.work_queue && !database.compaction_running)
    {
-      User_Account *user = (User_Account *)database.users.rows + index;
-      if(strings_are_equal(user->username, username))
+      uint64_t now = (uint64_t)time(0);
+      if(now >= database.next_compaction_time)
       {
-         memory_copy(user->session_id, session_id, SESSION_ID_LENGTH);
-         break;
+         database.next_compaction_time = now + DATABASE_COMPACTION_INTERVAL_SECONDS;
+         database.compaction_running = true;
+
+         database.compaction_entry.callback = database_compact_tables;
+         database.compaction_entry.data = 0;
+         platform_submit_work(database.work_queue, &database.compaction_entry);
+      }
+   }
+}
+
+#if DEVELOPMENT_BUILD
+#define DATABASE_TEST_KEY_SIZE 32
+#define DATABASE_TEST_SLOT_COUNT 16
+
+static void
+test_database_index(void)
+{
+   // NOTE(law): Fill an index with keys whose home slots collide, in runs that
+   // wrap around the end of the slots. Then remove every subset of the keys,
+   // front to back and back to front, and check that every key left is still
+   // found and every key removed is not. A backward shift that breaks a probe
+   // chain wouldn't otherwise show up until a lookup quietly missed.
+
+   unsigned int homes[] = {14, 14, 14, 15, 15, 0, 0};
+   unsigned int key_count = ARRAY_LENGTH(homes);
+   ASSERT(2 * key_count <= DATABASE_TEST_SLOT_COUNT);
+
+   Database_Table table;
+   zero_memory(&table, sizeof(table));
+   table.row_size = DATABASE_TEST_KEY_SIZE;
+   table.key_offset = 0;
+   table.max_row_count = key_count;
+   table.row_count = key_count;
+   table.rows.element_size = DATABASE_TEST_KEY_SIZE;
+   table.rows.chunks[0] = platform_allocate(key_count * DATABASE_TEST_KEY_SIZE);
+   table.rows.chunk_count = 1;
+
+   size_t slots_size = DATABASE_TEST_SLOT_COUNT * sizeof(Database_Index_Slot);
+   Database_Index *index = platform_allocate(sizeof(Database_Index) + slots_size);
+   index->slot_count = DATABASE_TEST_SLOT_COUNT;
+   ASSERT(table.rows.chunks[0] && index);
+
+   // NOTE(law): Pick keys by brute force until each lands on its home slot.
+   unsigned int candidate = 0;
+   for(unsigned int row = 0; row < key_count; ++row)
+   {
+      char *key = database_row(&table, row);
+      do
+      {
+         format_string(key, DATABASE_TEST_KEY_SIZE, "key%u", candidate++);
+      } while((database_hash_key(key) & (DATABASE_TEST_SLOT_COUNT - 1)) != homes[row]);
+   }
+
+   for(unsigned int removed = 0; removed < (1u << key_count); ++removed)
+   {
+      for(unsigned int direction = 0; direction < 2; ++direction)
+      {
+         table.index = index;
+         zero_memory(index->slots, slots_size);
+         for(unsigned int row = 0; row < key_count; ++row)
+         {
+            database_index_insert(&table, row);
+         }
+
+         for(unsigned int step = 0; step < key_count; ++step)
+         {
+            unsigned int row = (direction == 0) ? step : (key_count - 1 - step);
+            if(removed & (1u << row))
+            {
+               database_index_remove(&table, row);
+            }
+         }
+
+         unsigned int used_slot_count = 0;
+         for(unsigned int slot = 0; slot < DATABASE_TEST_SLOT_COUNT; ++slot)
+         {
+            used_slot_count += (index->slots[slot].row_number != 0);
+         }
+
+         unsigned int kept_count = 0;
+         for(unsigned int row = 0; row < key_count; ++row)
+         {
+            bool kept = !(removed & (1u << row));
+            kept_count += kept;
+
+            char *key = database_row(&table, row);
+
+            unsigned int found_row = key_count;
+            bool found = (database_find_row(&table, key, &found_row) != 0);
+            ASSERT(found == kept);
+            ASSERT(!found || found_row == row);
+
+            found_row = key_count;
+            found = database_read_row(&table, key, 0, &found_row);
+            ASSERT(found == kept);
+            ASSERT(!found || found_row == row);
+         }
+         ASSERT(used_slot_count == kept_count);
+      }
+   }
+
+   // NOTE(law): A table whose index couldn't be allocated has nothing to
+   // remove from.
+   table.index = 0;
+   database_index_remove(&table, 0);
+   ASSERT(!database_find_row(&table, database_row(&table, 0), 0));
+
+   platform_deallocate(index);
+   platform_deallocate(table.rows.chunks[0]);
+}
+
+static void
+test_database_hot_key_scan(void)
+{
+   // NOTE(law): Grow a table with hot arrays one row at a time, and at every
+   // row count check that scanning the hot arrays finds the same row as the
+   // index for every key, present or not. Most of the row counts leave a
+   // partial group of four at the end. The keys include ones of the maximum
+   // length that differ only in their first or last byte, keys on either side
+   // of a 16 byte boundary, and a duplicate. Some rows are stored with the hash
+   // of a later key that differs from theirs in a single byte (the last, the
+   // first, or the one before a 16 byte boundary), so the scan has to tell
+   // them apart on the full key compare.
+
+   char *keys[] =
+   {
+      "alice",
+      "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa",
+      "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaab",
+      "baaaaaaaaaaaaaaaaaaaaaaaaaaaaaa",
+      "0123456789abcde",
+      "0123456789abcdef",
+      "0123456789abcdefg",
+      "zbcdefghijklmnopqrstuvwxyz0123x",
+      "zbcdefghijklmnopqrstuvwxyz01234",
+      "0123456789abcdexghij",
+      "bob",
+      "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaa",
+      "alice",
+      "zbcdefghijklmnopqrstuvwxyz0123y",
+      "ybcdefghijklmnopqrstuvwxyz01234",
+      "0123456789abcdeyghij",
+      "carol",
+   };
+   char *collision_keys[ARRAY_LENGTH(keys)] = {0};
+   collision_keys[7] = keys[13];
+   collision_keys[8] = keys[14];
+   collision_keys[9] = keys[15];
+   unsigned int key_count = ARRAY_LENGTH(keys);
+
+   char *absent_keys[] =
+   {
+      "",
+      "alic",
+      "alicf",
+      "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaac",
+      "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa",
+      "0123456789abcdeg",
+   };
+
+   Database_Table table;
+   zero_memory(&table, sizeof(table));
+   table.row_size = DATABASE_TEST_KEY_SIZE;
+   table.key_offset = 0;
+   table.max_row_count = key_count;
+   table.rows.element_size = DATABASE_TEST_KEY_SIZE;
+   table.rows.chunks[0] = platform_allocate(key_count * DATABASE_TEST_KEY_SIZE);
+   table.rows.chunk_count = 1;
+
+   table.hot_key_size = DATABASE_TEST_KEY_SIZE;
+   table.hot_keys.element_size = DATABASE_TEST_KEY_SIZE;
+   table.hot_keys.chunks[0] = platform_allocate(DATABASE_CHUNK_ELEMENT_COUNT * DATABASE_TEST_KEY_SIZE);
+   table.hot_keys.chunk_count = 1;
+   table.hot_hashes.element_size = sizeof(uint32_t);
+   table.hot_hashes.chunks[0] = platform_allocate(DATABASE_CHUNK_ELEMENT_COUNT * sizeof(uint32_t));
+   table.hot_hashes.chunk_count = 1;
+
+   unsigned int slot_count = 4 * DATABASE_TEST_SLOT_COUNT;
+   ASSERT(2 * key_count <= slot_count);
+
+   size_t slots_size = slot_count * sizeof(Database_Index_Slot);
+   Database_Index *index = platform_allocate(sizeof(Database_Index) + slots_size);
+   index->slot_count = slot_count;
+   ASSERT(table.rows.chunks[0] && table.hot_keys.chunks[0] && table.hot_hashes.chunks[0] && index);
+
+   for(unsigned int row_count = 1; row_count <= key_count; ++row_count)
+   {
+      unsigned int row = row_count - 1;
+      ASSERT(string_length(keys[row]) < DATABASE_TEST_KEY_SIZE);
+
+      uint32_t hash = database_hash_key(collision_keys[row] ? collision_keys[row] : keys[row]);
+      memory_copy(database_row(&table, row), keys[row], string_length(keys[row]));
+      ASSERT(database_set_hot_key(&table, row, keys[row], hash));
+      table.row_count = row_count;
+
+      table.index = index;
+      zero_memory(index->slots, slots_size);
+      for(unsigned int index_row = 0; index_row < row_count; ++index_row)
+      {
+         database_index_insert(&table, index_row);
+      }
+
+      unsigned int query_count = key_count + ARRAY_LENGTH(absent_keys);
+      for(unsigned int query = 0; query < query_count; ++query)
+      {
+         char *key = (query < key_count) ? keys[query] : absent_keys[query - key_count];
+
+         unsigned int indexed_row = key_count;
+         bool indexed = (database_find_row(&table, key, &indexed_row) != 0);
+
+         unsigned int scanned_row = key_count;
+         bool scanned = database_scan_hot_keys(&table, key, database_hash_key(key), &scanned_row);
+
+         // NOTE(law): The first row holding the key, except that the
+         // collision rows can't be found by their own keys.
+         unsigned int expected_row = key_count;
+         for(unsigned int test_row = 0; test_row < row_count; ++test_row)
+         {
+            if(!collision_keys[test_row] && strings_are_equal(keys[test_row], key))
+            {
+               expected_row = test_row;
+               break;
+            }
+         }
+         bool expected = (expected_row < key_count);
+
+         ASSERT(indexed == expected && scanned == expected);
+         ASSERT(!expected || (indexed_row == expected_row && scanned_row == expected_row));
       }
    }
 
-   platform_unlock(database.users.semaphore);
+   platform_deallocate(index);
+   platform_deallocate(table.hot_hashes.chunks[0]);
+   platform_deallocate(table.hot_keys.chunks[0]);
+   platform_deallocate(table.rows.chunks[0]);
 }
+#endif
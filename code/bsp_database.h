@@ -19,17 +19,242 @@ typedef struct
    unsigned int iteration_count;
    char session_id[SESSION_ID_LENGTH + 1]; // Include null terminator
 } User_Account;
+
+// NOTE(law): A row in the session table. A row with an empty session id is
+// unused.
+typedef struct
+{
+   char session_id[SESSION_ID_LENGTH + 1]; // Include null terminator
+   unsigned int user_index; // Row of the owning user in the user table.
+   uint64_t created; // Unix time.
+   uint64_t expires; // Unix time.
+} User_Session;
+#pragma pack(pop)
+
+// NOTE(law): The files that changes are logged against (see
+// bsp_database_log.c). A log record is followed by size bytes, to be written
+// at offset in the file.
+typedef enum
+{
+   DATABASE_FILE_USERS,
+   DATABASE_FILE_SESSIONS,
+
+   DATABASE_FILE_COUNT,
+} Database_File_Id;
+
+#define DATABASE_LOG_MAGIC 0x4C505342 // "BSPL"
+
+#pragma pack(push, 1)
+typedef struct
+{
+   uint32_t magic;
+   uint32_t checksum; // Covers the rest of the header and the data.
+   uint32_t file_id;
+   uint32_t size;
+   uint64_t offset;
+} Database_Log_Record;
 #pragma pack(pop)
 
+#define SESSION_LIFETIME_SECONDS (7 * 24 * 60 * 60)
+#define MAX_SESSION_COUNT 65536
+
+// NOTE(law): Once a user has this many live sessions, logging in again ends
+// their oldest one.
+#define MAX_USER_SESSION_COUNT 32
+
+// NOTE(law): The database arena only holds the session wheel links, which
+// take up well under this.
+#define DATABASE_ARENA_SOFT_LIMIT MEBIBYTES(16)
+
+// NOTE(law): How often the table files are compacted in the background.
+#define DATABASE_COMPACTION_INTERVAL_SECONDS (24 * 60 * 60)
+
+typedef struct
+{
+   // NOTE(law): A slot in a table's open-addressing index. The hash is stored
+   // so that most probes can be rejected without touching the row itself.
+   uint32_t hash;
+   uint32_t row_number; // Row index + 1, so that 0 marks an empty slot.
+} Database_Index_Slot;
+
+typedef struct
+{
+   // NOTE(law): An index is published as a single object, so that a lock-free
+   // reader always pairs the slots with their own count. The slot count is a
+   // power of two.
+   unsigned int slot_count;
+   Database_Index_Slot slots[];
+} Database_Index;
+
+// NOTE(law): Rows are stored in fixed-size chunks that are allocated as the
+// table grows. A chunk never moves once allocated, so pointers to rows (and the
+// row numbers stored in indexes) stay valid, and only the chunk directory is
+// sized up front. Chunks are allocated from the platform directly, so a table
+// only takes up memory for the rows it has actually used.
+
+#define DATABASE_CHUNK_BITS 12
+#define DATABASE_CHUNK_ELEMENT_COUNT (1 << DATABASE_CHUNK_BITS)
+#define DATABASE_MAX_CHUNK_COUNT 4096
+#define DATABASE_MAX_ROW_COUNT (DATABASE_CHUNK_ELEMENT_COUNT * DATABASE_MAX_CHUNK_COUNT)
+#define DATABASE_CACHE_LINE_SIZE 64
+
+// NOTE(law): Hot keys are compared 16 bytes at a time, so their size is a
+// multiple of 16.
+#define DATABASE_MAX_HOT_KEY_SIZE 64
+
+// NOTE(law): A table file starts with a header page, followed by its rows one
+// chunk at a time. Each chunk is preceded by a page of CRC32C checksums, one
+// for each page of the chunk's rows (a chunk of N byte rows is exactly N
+// pages). Every chunk's rows start on a page boundary, so complete chunks can
+// be mapped straight from the file. The last page of a partial chunk is
+// checksummed as if the rest of it were zeros.
+//
+// Version 0 files (no header, just rows) are upgraded on startup.
+
+#define DATABASE_FILE_MAGIC 0x54505342 // "BSPT"
+#define DATABASE_FILE_VERSION 1
+#define DATABASE_PAGE_SIZE 4096
+
+#pragma pack(push, 1)
+typedef struct
+{
+   uint32_t magic;
+   uint32_t version;
+   uint32_t row_size;
+   uint32_t page_size;
+   uint32_t chunk_row_count;
+   uint32_t checksum; // Covers the rest of the header.
+} Database_File_Header;
+#pragma pack(pop)
+
+// NOTE(law): A point-in-time copy of a chunked array, taken without stopping
+// writers. Taking the snapshot only records the element count. Chunks are then
+// copied lazily: a writer about to modify a chunk the snapshot hasn't reached
+// yet copies it first, and the snapshot copies the rest as it goes.
+
+typedef struct
+{
+   struct Platform_Semaphore *semaphore;
+   volatile bool active;
+   bool failed;
+
+   unsigned int element_count;
+   unsigned int chunk_count;
+   bool copied[DATABASE_MAX_CHUNK_COUNT];
+   unsigned char *copies[DATABASE_MAX_CHUNK_COUNT];
+} Database_Snapshot;
+
 typedef struct
 {
+   size_t element_size;
+   unsigned int chunk_count;
+   unsigned char *chunks[DATABASE_MAX_CHUNK_COUNT];
+
+   // NOTE(law): Set while the array is the subject of a snapshot.
+   Database_Snapshot *snapshot;
+} Database_Chunked_Array;
+
+typedef struct
+{
+   // NOTE(law): The semaphore only serializes writers. Readers never take it,
+   // and instead validate what they read against the sequence counter, which
+   // is odd while a writer is modifying the rows or index in memory.
    struct Platform_Semaphore *semaphore;
+   volatile unsigned int sequence;
+
    char *file_path;
 
+   size_t row_size;
    unsigned int max_row_count;
-   unsigned int row_count;
-   void *rows;
+   volatile unsigned int row_count;
+   Database_Chunked_Array rows;
+
+   // NOTE(law): If set, the row data lives in row_store, shared with other
+   // tables, and the table's own rows only hold row_store element indices.
+   Database_Chunked_Array *row_store;
+
+   // NOTE(law): Every row is indexed by the null-terminated string found at
+   // key_offset bytes into the row.
+   size_t key_offset;
+   Database_Index *volatile index;
+   Page_Backing index_backing;
+
+   // NOTE(law): If hot_key_size is set, every row's key (zero padded to
+   // hot_key_size bytes) and its hash are also kept in arrays of their own,
+   // apart from the rest of the row. Lookups, scans and index rebuilds then
+   // only touch the hot arrays, and only fetch the row itself once it's found.
+   // A hash of 0 marks a row with an empty key.
+   size_t hot_key_size;
+   Database_Chunked_Array hot_keys;
+   Database_Chunked_Array hot_hashes;
 } Database_Table;
 
+// NOTE(law): A table split into shards by the hash of its key, each with its own
+// lock and index. Every row also has a stable id: its position in the table's
+// file, which is the order rows were inserted in. Ids are what other tables
+// (and session tokens) use to refer to a row, since they don't depend on the
+// shard count. The row data is stored once, in id order, so that it matches
+// the file (and can be mapped from it), and each shard lists the ids it owns.
+
+#define USER_SHARD_BITS 4
+#define USER_SHARD_COUNT (1 << USER_SHARD_BITS)
+
+typedef struct
+{
+   uint32_t shard;
+   uint32_t row;
+} Database_Row_Location;
+
+typedef struct
+{
+   Database_Table shards[USER_SHARD_COUNT];
+   Database_Chunked_Array rows;
+
+   // NOTE(law): Only taken to hand out ids, which are published by bumping
+   // row_count after the row's location is written.
+   struct Platform_Semaphore *id_semaphore;
+   char *file_path;
+
+   unsigned int max_row_count;
+   volatile unsigned int row_count;
+   Database_Chunked_Array locations;
+} Database_Sharded_Table;
+
+// NOTE(law): Sessions are filed into a timing wheel by expiry time, so the
+// sweeper only ever looks at the sessions that are due. Each slot covers
+// granularity seconds, and the wheel spans more than SESSION_LIFETIME_SECONDS,
+// so a slot never holds sessions from two different turns of the wheel at
+// once. Unused session rows are chained through the same links.
+//
+// Each user's live sessions are also chained together, through a second set of
+// links, so that a user with too many sessions gives up one of their own
+// rather than someone else's.
+
+#define SESSION_WHEEL_SLOT_COUNT 256
+
+typedef struct
+{
+   unsigned int head;
+   unsigned int count;
+} Session_User_List;
+
+typedef struct
+{
+   uint64_t granularity;
+   uint64_t swept_tick;
+
+   // NOTE(law): All links are row index + 1, so that 0 is the end of a list.
+   unsigned int slot_heads[SESSION_WHEEL_SLOT_COUNT];
+   unsigned int *next;
+   unsigned int *previous;
+   unsigned int free_head;
+
+   unsigned int *user_next;
+   unsigned int *user_previous;
+   Database_Chunked_Array user_lists; // Session_User_List per user id.
+
+   unsigned int active_count;
+} Session_Wheel;
+
 #define BSP_DATABASE_H
 #endif
@@ -0,0 +1,174 @@
+/* /////////////////////////////////////////////////////////////////////////// */
+/* (c) copyright 2023 Lawrence D. Kern /////////////////////////////////////// */
+/* /////////////////////////////////////////////////////////////////////////// */
+
+// NOTE(law): The layout of the table files (see bsp_database.h), shared by the
+// log writer, which keeps the checksums up to date, and the table loader,
+// which verifies them.
+
+static size_t
+database_file_chunk_offset(size_t row_size, unsigned int chunk_index)
+{
+   // NOTE(law): Returns the offset of the chunk's checksum page. The chunk's
+   // rows start one page later.
+
+   size_t chunk_stride = DATABASE_PAGE_SIZE + (DATABASE_CHUNK_ELEMENT_COUNT * row_size);
+   size_t result = DATABASE_PAGE_SIZE + (chunk_index * chunk_stride);
+
+   return result;
+}
+
+static size_t
+database_file_row_offset(size_t row_size, unsigned int row)
+{
+   size_t result = database_file_chunk_offset(row_size, row >> DATABASE_CHUNK_BITS);
+   result += DATABASE_PAGE_SIZE + ((row & (DATABASE_CHUNK_ELEMENT_COUNT - 1)) * row_size);
+
+   return result;
+}
+
+static unsigned int
+database_file_row_count(size_t row_size, size_t file_size)
+{
+   // NOTE(law): A trailing partial row is not counted.
+
+   size_t result = 0;
+   if(file_size > DATABASE_PAGE_SIZE)
+   {
+      size_t chunk_stride = DATABASE_PAGE_SIZE + (DATABASE_CHUNK_ELEMENT_COUNT * row_size);
+      size_t size = file_size - DATABASE_PAGE_SIZE;
+
+      result = (size / chunk_stride) * DATABASE_CHUNK_ELEMENT_COUNT;
+
+      size_t remainder = size % chunk_stride;
+      if(remainder > DATABASE_PAGE_SIZE)
+      {
+         result += (remainder - DATABASE_PAGE_SIZE) / row_size;
+      }
+   }
+
+   result = MINIMUM(result, DATABASE_MAX_ROW_COUNT);
+   return (unsigned int)result;
+}
+
+static uint32_t
+database_page_checksum(unsigned char *page, size_t size)
+{
+   // NOTE(law): size is how much of the page is present. The rest is checksummed
+   // as zeros, so a page's checksum doesn't change as a file grows into it
+   // unless the new bytes are nonzero.
+
+   static unsigned char zeros[DATABASE_PAGE_SIZE];
+
+   ASSERT(size <= DATABASE_PAGE_SIZE);
+
+   uint32_t result = crc32c(0, page, size);
+   result = crc32c(result, zeros, DATABASE_PAGE_SIZE - size);
+
+   return result;
+}
+
+static Database_File_Header
+database_file_header(size_t row_size)
+{
+   // NOTE(law): A chunk's checksums have to fit in a single page, and a chunk
+   // of N byte rows is N pages long.
+   ASSERT(row_size <= (DATABASE_PAGE_SIZE / sizeof(uint32_t)));
+
+   Database_File_Header result = {0};
+   result.magic = DATABASE_FILE_MAGIC;
+   result.version = DATABASE_FILE_VERSION;
+   result.row_size = (uint32_t)row_size;
+   result.page_size = DATABASE_PAGE_SIZE;
+   result.chunk_row_count = DATABASE_CHUNK_ELEMENT_COUNT;
+   result.checksum = crc32c(0, &result, offsetof(Database_File_Header, checksum));
+
+   return result;
+}
+
+static bool
+database_file_header_is_valid(Database_File_Header *header, size_t row_size)
+{
+   Database_File_Header expected = database_file_header(row_size);
+
+   bool result = bytes_are_equal(header, &expected, sizeof(expected));
+   return result;
+}
+
+static bool
+database_write_file_header(struct Platform_File_Handle *file, size_t row_size)
+{
+   unsigned char page[DATABASE_PAGE_SIZE] = {0};
+
+   Database_File_Header header = database_file_header(row_size);
+   memory_copy(page, &header, sizeof(header));
+
+   bool result = platform_write_file_handle(file, 0, page, sizeof(page));
+   return result;
+}
+
+static bool
+database_write_file_chunk(struct Platform_File_Handle *file,
+                          size_t row_size,
+                          unsigned int chunk_index,
+                          unsigned char *rows,
+                          unsigned int row_count)
+{
+   // NOTE(law): Write a chunk's checksum page and rows.
+
+   uint32_t checksums[DATABASE_PAGE_SIZE / sizeof(uint32_t)] = {0};
+
+   size_t size = row_count * row_size;
+   for(unsigned int page = 0; (page * DATABASE_PAGE_SIZE) < size; ++page)
+   {
+      size_t offset = page * DATABASE_PAGE_SIZE;
+      checksums[page] = database_page_checksum(rows + offset, MINIMUM(DATABASE_PAGE_SIZE, size - offset));
+   }
+
+   size_t offset = database_file_chunk_offset(row_size, chunk_index);
+
+   bool result = (platform_write_file_handle(file, offset, checksums, sizeof(checksums)) &&
+                  platform_write_file_handle(file, offset + DATABASE_PAGE_SIZE, rows, size));
+   return result;
+}
+
+static bool
+database_upgrade_file(struct Platform_File_Handle *file, char *file_path, size_t row_size)
+{
+   // NOTE(law): Rewrite a version 0 file (packed rows with no header) in the
+   // current format, and rename the result over the original.
+
+   bool result = false;
+
+   Platform_File legacy = platform_read_file(file_path);
+   if(legacy.memory && (legacy.size % row_size) == 0)
+   {
+      char upgrade_path[256];
+      format_string(upgrade_path, sizeof(upgrade_path), "%s.upgrade", file_path);
+
+      struct Platform_File_Handle *upgrade = platform_open_file(upgrade_path);
+      if(upgrade)
+      {
+         result = (platform_truncate_file(upgrade, 0) && database_write_file_header(upgrade, row_size));
+
+         unsigned int row_count = (unsigned int)MINIMUM(legacy.size / row_size, DATABASE_MAX_ROW_COUNT);
+         for(unsigned int row = 0; result && row < row_count; row += DATABASE_CHUNK_ELEMENT_COUNT)
+         {
+            unsigned int chunk_row_count = MINIMUM(DATABASE_CHUNK_ELEMENT_COUNT, row_count - row);
+            result = database_write_file_chunk(upgrade,
+                                               row_size,
+                                               row >> DATABASE_CHUNK_BITS,
+                                               legacy.memory + (row * row_size),
+                                               chunk_row_count);
+         }
+
+         result = result && platform_sync_file(upgrade);
+         platform_close_file(upgrade);
+
+         result = result && platform_replace_file(file, upgrade_path);
+      }
+   }
+   platform_free_file(&legacy);
+
+   return result;
+}
@@ -0,0 +1,691 @@
+/* /////////////////////////////////////////////////////////////////////////// */
+/* (c) copyright 2023 Lawrence D. Kern /////////////////////////////////////// */
+/* /////////////////////////////////////////////////////////////////////////// */
+
+// NOTE(law): Every change to a table file goes through a write-ahead log.
+// Request threads copy their records into an open batch in memory, and a single
+// writer thread appends each batch to the log with one write and makes it
+// durable with one sync, so that all of the records in a batch share the cost.
+// While the writer is busy with one batch the next one keeps filling, so
+// batches grow with the load. A caller that needs to know when its change is
+// durable passes a Platform_Work_Entry, which the writer completes after the
+// sync, marked failed if the batch couldn't be made durable.
+//
+// Once a batch is durable, the writer applies it to the table files, which it
+// keeps open. The table files are only synced when the log passes
+// DATABASE_LOG_CHECKPOINT_SIZE, after which the log is emptied. On startup,
+// whatever is left in the log is applied to the table files before they are
+// loaded.
+//
+// The writer also keeps the page checksums of the table files up to date. It
+// tracks which pages it has written to, and recomputes their checksums from
+// the file at each checkpoint, right before the sync. Until then, the log still
+// holds every change to those pages, so a crash in between is repaired by the
+// replay (and the checkpoint) on startup.
+//
+// A table file can also be compacted (rewritten from a snapshot and renamed
+// over the original) while the log is live. The log is marked at the instant
+// the snapshot is taken, and once the new file is in place, every record for
+// that file logged since the mark is applied to it again. Checkpoints are held
+// off in the meantime, so those records are still in the log.
+
+#define DATABASE_LOG_BATCH_COUNT 4
+#define DATABASE_LOG_BATCH_SIZE KIBIBYTES(64)
+#define DATABASE_LOG_BATCH_WAITER_COUNT 256
+#define DATABASE_LOG_CHECKPOINT_SIZE MEBIBYTES(16)
+
+typedef struct
+{
+   Database_File_Id file_id;
+
+   // NOTE(law): The new file to rename over the table file, or 0 if writing it
+   // failed and the compaction is being abandoned.
+   char *replacement_path;
+   bool replaced;
+
+   Platform_Work_Entry mark;
+   Platform_Work_Entry swap;
+} Database_Log_Compaction;
+
+static void database_schedule_compaction(void);
+
+typedef struct
+{
+   volatile bool in_use;
+
+   size_t size;
+   unsigned char data[DATABASE_LOG_BATCH_SIZE];
+
+   unsigned int waiter_count;
+   Platform_Work_Entry *waiters[DATABASE_LOG_BATCH_WAITER_COUNT];
+
+   Platform_Work_Entry entry;
+} Database_Log_Batch;
+
+static struct
+{
+   struct Platform_Work_Queue *queue;
+
+   // NOTE(law): Guards the open batch, and handing out batches.
+   struct Platform_Semaphore *semaphore;
+   Database_Log_Batch batches[DATABASE_LOG_BATCH_COUNT];
+   Database_Log_Batch *open_batch;
+
+   // NOTE(law): Only touched by the writer thread once it's running.
+   char *file_path;
+   struct Platform_File_Handle *file;
+   size_t file_size;
+   struct Platform_File_Handle *table_files[DATABASE_FILE_COUNT];
+   size_t table_row_sizes[DATABASE_FILE_COUNT];
+
+   // NOTE(law): One bit per page of rows, indexed by chunk * row_size + page
+   // (since a chunk of N byte rows is N pages).
+   uint64_t *dirty_pages[DATABASE_FILE_COUNT];
+   bool dirty_chunks[DATABASE_FILE_COUNT][DATABASE_MAX_CHUNK_COUNT];
+
+   unsigned int compaction_count;
+   size_t compaction_offsets[DATABASE_FILE_COUNT];
+
+   // NOTE(law): A compaction is abandoned if any batch fails between its mark
+   // and its swap, since the snapshot may have caught a change that was undone
+   // in memory afterwards.
+   unsigned int failed_batch_count;
+   unsigned int compaction_failed_batch_counts[DATABASE_FILE_COUNT];
+} database_log;
+
+static uint32_t
+database_log_checksum(Database_Log_Record *record)
+{
+   // NOTE(law): CRC32C over everything after the checksum field.
+
+   unsigned char *bytes = (unsigned char *)&record->file_id;
+   size_t size = sizeof(*record) - offsetof(Database_Log_Record, file_id) + record->size;
+
+   uint32_t result = crc32c(0, bytes, size);
+   return result;
+}
+
+static void
+database_mark_log_pages(Database_File_Id file_id, uint64_t offset, size_t size)
+{
+   // NOTE(law): Record that size bytes were written to the table file at
+   // offset. Records only ever touch the rows of a single chunk.
+
+   size_t row_size = database_log.table_row_sizes[file_id];
+   size_t chunk_stride = DATABASE_PAGE_SIZE + (DATABASE_CHUNK_ELEMENT_COUNT * row_size);
+
+   if(size == 0 || offset < DATABASE_PAGE_SIZE)
+   {
+      return;
+   }
+
+   uint64_t chunk_index = (offset - DATABASE_PAGE_SIZE) / chunk_stride;
+   size_t chunk_offset = (size_t)((offset - DATABASE_PAGE_SIZE) % chunk_stride);
+   if(chunk_index >= DATABASE_MAX_CHUNK_COUNT || chunk_offset < DATABASE_PAGE_SIZE)
+   {
+      return;
+   }
+
+   size_t first_page = (chunk_offset - DATABASE_PAGE_SIZE) / DATABASE_PAGE_SIZE;
+   size_t last_page = MINIMUM((chunk_offset - DATABASE_PAGE_SIZE + size - 1) / DATABASE_PAGE_SIZE, row_size - 1);
+
+   uint64_t *bits = database_log.dirty_pages[file_id];
+   for(size_t page = first_page; page <= last_page; ++page)
+   {
+      size_t bit = (chunk_index * row_size) + page;
+      bits[bit / 64] |= (1ull << (bit % 64));
+   }
+   database_log.dirty_chunks[file_id][chunk_index] = true;
+}
+
+static bool
+database_update_log_checksums(Database_File_Id file_id)
+{
+   // NOTE(law): Recompute the checksums of every page of the table file
+   // written since the last checkpoint.
+
+   bool result = true;
+
+   struct Platform_File_Handle *file = database_log.table_files[file_id];
+   size_t row_size = database_log.table_row_sizes[file_id];
+   uint64_t *bits = database_log.dirty_pages[file_id];
+
+   for(unsigned int chunk_index = 0; chunk_index < DATABASE_MAX_CHUNK_COUNT; ++chunk_index)
+   {
+      if(!database_log.dirty_chunks[file_id][chunk_index])
+      {
+         continue;
+      }
+
+      uint32_t checksums[DATABASE_PAGE_SIZE / sizeof(uint32_t)] = {0};
+      unsigned char page_memory[DATABASE_PAGE_SIZE];
+
+      size_t offset = database_file_chunk_offset(row_size, chunk_index);
+      platform_read_file_handle(file, offset, checksums, sizeof(checksums));
+
+      for(size_t page = 0; page < row_size; ++page)
+      {
+         size_t bit = (chunk_index * row_size) + page;
+         if(bits[bit / 64] & (1ull << (bit % 64)))
+         {
+            size_t page_offset = offset + DATABASE_PAGE_SIZE + (page * DATABASE_PAGE_SIZE);
+            size_t size = platform_read_file_handle(file, page_offset, page_memory, sizeof(page_memory));
+
+            checksums[page] = database_page_checksum(page_memory, size);
+         }
+      }
+
+      // NOTE(law): Pages stay dirty until their checksums are written, so a
+      // failure here is retried at the next checkpoint.
+      if(platform_write_file_handle(file, offset, checksums, sizeof(checksums)))
+      {
+         for(size_t page = 0; page < row_size; ++page)
+         {
+            size_t bit = (chunk_index * row_size) + page;
+            bits[bit / 64] &= ~(1ull << (bit % 64));
+         }
+         database_log.dirty_chunks[file_id][chunk_index] = false;
+      }
+      else
+      {
+         result = false;
+      }
+   }
+
+   return result;
+}
+
+static size_t
+database_apply_log(unsigned char *memory, size_t size, Database_File_Id only_file_id)
+{
+   // NOTE(law): Write each record in memory to its table file, stopping at the
+   // first one that is incomplete or damaged (e.g. torn by a crash mid-write).
+   // Pass DATABASE_FILE_COUNT to apply records for every file. Returns the
+   // number of bytes of valid records.
+
+   size_t offset = 0;
+   while(size - offset >= sizeof(Database_Log_Record))
+   {
+      Database_Log_Record *record = (Database_Log_Record *)(memory + offset);
+      if(record->magic != DATABASE_LOG_MAGIC ||
+         record->file_id >= DATABASE_FILE_COUNT ||
+         record->size > size - offset - sizeof(*record) ||
+         record->checksum != database_log_checksum(record))
+      {
+         break;
+      }
+
+      if(only_file_id == DATABASE_FILE_COUNT || record->file_id == only_file_id)
+      {
+         platform_write_file_handle(database_log.table_files[record->file_id], record->offset, record + 1, record->size);
+         database_mark_log_pages(record->file_id, record->offset, record->size);
+      }
+      offset += sizeof(*record) + record->size;
+   }
+
+   return offset;
+}
+
+static void
+database_checkpoint_log(void)
+{
+   // NOTE(law): Every record in the log has already been applied, so once the
+   // table files are durable the log has nothing left to contribute.
+
+   bool synced = true;
+   for(unsigned int index = 0; index < DATABASE_FILE_COUNT; ++index)
+   {
+      synced = database_update_log_checksums(index) && synced;
+      synced = platform_sync_file(database_log.table_files[index]) && synced;
+   }
+
+   if(synced && platform_truncate_file(database_log.file, 0))
+   {
+      database_log.file_size = 0;
+   }
+}
+
+static
+PLATFORM_WORK_QUEUE_CALLBACK(database_write_log_batch)
+{
+   Database_Log_Batch *batch = (Database_Log_Batch *)data;
+
+   // NOTE(law): Close the batch, so that records logged from here on start the
+   // next one.
+   platform_lock(database_log.semaphore);
+   if(database_log.open_batch == batch)
+   {
+      database_log.open_batch = 0;
+   }
+   platform_unlock(database_log.semaphore);
+
+   bool durable = (platform_write_file_handle(database_log.file, database_log.file_size, batch->data, batch->size) &&
+                   platform_sync_file(database_log.file));
+   if(durable)
+   {
+      database_log.file_size += batch->size;
+   }
+   else
+   {
+      // NOTE(law): Cut off whatever part of the batch did reach the log, so
+      // that a later batch can't end up followed by records that were never
+      // acknowledged, and which a replay would then apply.
+      platform_log_message("[ERROR] Failed to make %zu bytes of the database log durable.", batch->size);
+      platform_truncate_file(database_log.file, database_log.file_size);
+      database_log.failed_batch_count++;
+   }
+
+   for(unsigned int index = 0; index < batch->waiter_count; ++index)
+   {
+      batch->waiters[index]->failed = !durable;
+      platform_complete_work(database_log.queue, batch->waiters[index]);
+   }
+
+   // NOTE(law): A batch that never reached the log is not applied to the table
+   // files. Its callers are told, and undo their changes in memory.
+   if(durable)
+   {
+      database_apply_log(batch->data, batch->size, DATABASE_FILE_COUNT);
+   }
+
+   if(database_log.file_size >= DATABASE_LOG_CHECKPOINT_SIZE && !database_log.compaction_count)
+   {
+      database_checkpoint_log();
+   }
+
+   platform_release_fence();
+   batch->in_use = false;
+
+   database_schedule_compaction();
+}
+
+static
+PLATFORM_WORK_QUEUE_CALLBACK(database_mark_log_compaction)
+{
+   Database_Log_Compaction *compaction = (Database_Log_Compaction *)data;
+
+   database_log.compaction_count++;
+   database_log.compaction_offsets[compaction->file_id] = database_log.file_size;
+   database_log.compaction_failed_batch_counts[compaction->file_id] = database_log.failed_batch_count;
+}
+
+static
+PLATFORM_WORK_QUEUE_CALLBACK(database_swap_log_compaction)
+{
+   Database_Log_Compaction *compaction = (Database_Log_Compaction *)data;
+   Database_File_Id file_id = compaction->file_id;
+
+   compaction->replaced = false;
+   if(compaction->replacement_path &&
+      database_log.failed_batch_count != database_log.compaction_failed_batch_counts[file_id])
+   {
+      platform_log_message("[ERROR] Abandoned compacting database file %u, since the log failed while it ran.", file_id);
+   }
+   else if(compaction->replacement_path)
+   {
+      compaction->replaced = platform_replace_file(database_log.table_files[file_id], compaction->replacement_path);
+   }
+
+   if(compaction->replaced)
+   {
+      // NOTE(law): The snapshot predates everything logged after the mark.
+      size_t offset = database_log.compaction_offsets[file_id];
+      if(offset < database_log.file_size)
+      {
+         Platform_File log = platform_read_file(database_log.file_path);
+         if(log.memory && log.size >= database_log.file_size)
+         {
+            database_apply_log(log.memory + offset, database_log.file_size - offset, file_id);
+         }
+         else
+         {
+            platform_log_message("[ERROR] Failed to reread the database log after compacting a table.");
+         }
+         platform_free_file(&log);
+      }
+   }
+
+   database_log.compaction_count--;
+   if(database_log.file_size >= DATABASE_LOG_CHECKPOINT_SIZE && !database_log.compaction_count)
+   {
+      database_checkpoint_log();
+   }
+}
+
+static void
+database_mark_log(Database_Log_Compaction *compaction)
+{
+   // NOTE(law): The caller is responsible for holding the locks of every table
+   // stored in the file, so that everything logged for it so far is in the
+   // batches ahead of the mark, and everything logged later is behind it.
+
+   compaction->mark.callback = database_mark_log_compaction;
+   compaction->mark.data = compaction;
+
+   platform_lock(database_log.semaphore);
+   database_log.open_batch = 0;
+   platform_submit_work(database_log.queue, &compaction->mark);
+   platform_unlock(database_log.semaphore);
+}
+
+static bool
+database_swap_log_file(Database_Log_Compaction *compaction, char *replacement_path)
+{
+   // NOTE(law): Finish a compaction started with database_mark_log(), renaming
+   // replacement_path over the table file if it's provided. Returns whether the
+   // file was replaced.
+
+   compaction->replacement_path = replacement_path;
+   compaction->swap.callback = database_swap_log_compaction;
+   compaction->swap.data = compaction;
+
+   platform_submit_work(database_log.queue, &compaction->swap);
+
+   platform_wait_for_work(database_log.queue, &compaction->mark);
+   platform_wait_for_work(database_log.queue, &compaction->swap);
+
+   return compaction->replaced;
+}
+
+static void
+database_log_write(Database_File_Id file_id, size_t offset, void *memory, size_t size, Platform_Work_Entry *durable)
+{
+   // NOTE(law): Log a write of size bytes at offset in a table file. The caller
+   // is responsible for holding the lock of the table being changed, so that
+   // records for the same row are logged in the order they were applied. If
+   // durable is provided, it must be passed to database_wait_for_log() once the
+   // lock is released. Records are made durable in order, so an operation that
+   // logs several records only needs to wait on the last one.
+
+   ASSERT(sizeof(Database_Log_Record) + size <= DATABASE_LOG_BATCH_SIZE);
+
+   size_t record_size = sizeof(Database_Log_Record) + size;
+   if(durable)
+   {
+      durable->completed = false;
+      durable->failed = false;
+   }
+
+   platform_lock(database_log.semaphore);
+
+   Database_Log_Batch *batch = database_log.open_batch;
+   while(!batch ||
+         batch->size + record_size > DATABASE_LOG_BATCH_SIZE ||
+         (durable && batch->waiter_count == DATABASE_LOG_BATCH_WAITER_COUNT))
+   {
+      // NOTE(law): Start a new batch, waiting for the writer to free one up if
+      // they're all in flight.
+      batch = 0;
+      for(unsigned int index = 0; index < DATABASE_LOG_BATCH_COUNT; ++index)
+      {
+         if(!database_log.batches[index].in_use)
+         {
+            batch = database_log.batches + index;
+            break;
+         }
+      }
+
+      if(batch)
+      {
+         platform_acquire_fence();
+
+         batch->in_use = true;
+         batch->size = 0;
+         batch->waiter_count = 0;
+         batch->entry.callback = database_write_log_batch;
+         batch->entry.data = batch;
+
+         database_log.open_batch = batch;
+         platform_submit_work(database_log.queue, &batch->entry);
+      }
+      else
+      {
+         platform_unlock(database_log.semaphore);
+         platform_sleep(50);
+         platform_lock(database_log.semaphore);
+
+         batch = database_log.open_batch;
+      }
+   }
+
+   Database_Log_Record *record = (Database_Log_Record *)(batch->data + batch->size);
+   record->magic = DATABASE_LOG_MAGIC;
+   record->file_id = file_id;
+   record->size = (uint32_t)size;
+   record->offset = offset;
+   memory_copy(record + 1, memory, size);
+   record->checksum = database_log_checksum(record);
+
+   batch->size += record_size;
+   if(durable)
+   {
+      batch->waiters[batch->waiter_count++] = durable;
+   }
+
+   platform_unlock(database_log.semaphore);
+}
+
+static bool
+database_wait_for_log(Platform_Work_Entry *durable)
+{
+   // NOTE(law): Returns false if the record (and the rest of its batch) could
+   // not be made durable, in which case it was never applied to the table file.
+
+   platform_wait_for_work(database_log.queue, durable);
+
+   bool result = !durable->failed;
+   return result;
+}
+
+static void
+database_prepare_log_table_file(Database_File_Id file_id, char *file_path)
+{
+   // NOTE(law): Give a new table file its header, and upgrade an old one to the
+   // current format, before any records are applied to it. A file whose header
+   // is damaged is left alone, and refused by the table loader.
+
+   struct Platform_File_Handle *file = database_log.table_files[file_id];
+   size_t row_size = database_log.table_row_sizes[file_id];
+   if(!file)
+   {
+      return;
+   }
+
+   Database_File_Header header;
+   size_t size = platform_read_file_handle(file, 0, &header, sizeof(header));
+   if(size < sizeof(header))
+   {
+      // NOTE(law): No rows can have been written without a complete header.
+      if(!database_write_file_header(file, row_size) || !platform_sync_file(file))
+      {
+         platform_log_message("[ERROR] Failed to create the database table %s.", file_path);
+      }
+   }
+   else if(header.magic != DATABASE_FILE_MAGIC)
+   {
+      if(database_upgrade_file(file, file_path, row_size))
+      {
+         platform_log_message("Upgraded the database table %s to version %u.", file_path, DATABASE_FILE_VERSION);
+      }
+      else
+      {
+         platform_log_message("[ERROR] Failed to upgrade the database table %s.", file_path);
+      }
+   }
+}
+
+static void
+database_initialize_log(char *file_path, char **table_file_paths, size_t *table_row_sizes)
+{
+   // NOTE(law): Replay whatever the log still holds into the table files, so
+   // they're up to date before anything loads them. This has to run before the
+   // tables are initialized.
+
+   // NOTE(law): The files and writer thread last for the life of the process.
+   if(!database_log.queue)
+   {
+      database_log.file_path = file_path;
+      database_log.file = platform_open_file(file_path);
+      for(unsigned int index = 0; index < DATABASE_FILE_COUNT; ++index)
+      {
+         size_t row_size = table_row_sizes[index];
+         size_t page_count = DATABASE_MAX_CHUNK_COUNT * row_size;
+
+         database_log.table_files[index] = platform_open_file(table_file_paths[index]);
+         database_log.table_row_sizes[index] = row_size;
+         database_log.dirty_pages[index] = platform_allocate(((page_count + 63) / 64) * sizeof(uint64_t));
+
+         database_prepare_log_table_file(index, table_file_paths[index]);
+      }
+
+      database_log.semaphore = platform_initialize_semaphore();
+      database_log.queue = platform_initialize_work_queue(1, DATABASE_LOG_BATCH_COUNT + 2*DATABASE_FILE_COUNT);
+   }
+
+   Platform_File log = platform_read_file(file_path);
+   if(log.memory)
+   {
+      size_t applied_size = database_apply_log(log.memory, log.size, DATABASE_FILE_COUNT);
+      if(applied_size < log.size)
+      {
+         platform_log_message("[WARNING] Discarded %zu damaged bytes at the end of %s.", log.size - applied_size, file_path);
+      }
+
+      // NOTE(law): New records go right after the last valid one.
+      database_log.file_size = applied_size;
+      database_checkpoint_log();
+
+      platform_free_file(&log);
+   }
+}
+
+#if DEVELOPMENT_BUILD
+static size_t
+test_database_log_append(unsigned char *log, size_t log_size,
+                         Database_File_Id file_id, size_t offset,
+                         unsigned char value, size_t size)
+{
+   // NOTE(law): Append a record of size bytes of value, laid out the same way
+   // as by database_log_write(). Returns the new size of the log.
+
+   Database_Log_Record *record = (Database_Log_Record *)(log + log_size);
+   record->magic = DATABASE_LOG_MAGIC;
+   record->file_id = file_id;
+   record->size = (uint32_t)size;
+   record->offset = offset;
+   memory_set(record + 1, size, value);
+   record->checksum = database_log_checksum(record);
+
+   size_t result = log_size + sizeof(*record) + size;
+   return result;
+}
+
+static bool
+test_database_log_row_is(Database_File_Id file_id, unsigned int row, unsigned char value)
+{
+   size_t row_size = database_log.table_row_sizes[file_id];
+
+   unsigned char expected[64];
+   unsigned char actual[64];
+   ASSERT(row_size <= sizeof(actual));
+
+   memory_set(expected, row_size, value);
+   size_t size = platform_read_file_handle(database_log.table_files[file_id],
+                                           database_file_row_offset(row_size, row),
+                                           actual, row_size);
+
+   bool result = (size == row_size && bytes_are_equal(actual, expected, row_size));
+   return result;
+}
+
+static void
+test_database_log_replay(void)
+{
+   // NOTE(law): Replay logs into scratch table files: one that ends in a torn
+   // record, and one with a damaged record partway through. Only the records
+   // ahead of the damage may reach the files, and the checkpoint has to leave
+   // checksums that match the pages as written. Then replay a log for one file
+   // only, as a compaction does when it reapplies the log past its mark. This
+   // runs before the real log is set up, and leaves the log state as it was.
+
+   ASSERT(!database_log.queue);
+
+   size_t row_size = 64;
+   char file_paths[DATABASE_FILE_COUNT][32];
+   for(unsigned int file_id = 0; file_id < DATABASE_FILE_COUNT; ++file_id)
+   {
+      format_string(file_paths[file_id], sizeof(file_paths[file_id]), "test-log-%u.dbsp", file_id);
+
+      struct Platform_File_Handle *file = platform_open_file(file_paths[file_id]);
+      ASSERT(file && platform_truncate_file(file, 0) && database_write_file_header(file, row_size));
+
+      size_t page_count = DATABASE_MAX_CHUNK_COUNT * row_size;
+      database_log.table_files[file_id] = file;
+      database_log.table_row_sizes[file_id] = row_size;
+      database_log.dirty_pages[file_id] = platform_allocate(((page_count + 63) / 64) * sizeof(uint64_t));
+      ASSERT(database_log.dirty_pages[file_id]);
+   }
+
+   unsigned char *log = platform_allocate(KIBIBYTES(4));
+   ASSERT(log);
+
+   size_t size = 0;
+   size = test_database_log_append(log, size, 0, database_file_row_offset(row_size, 0), 0x11, row_size);
+   size = test_database_log_append(log, size, 1, database_file_row_offset(row_size, 0), 0x22, row_size);
+   size = test_database_log_append(log, size, 0, database_file_row_offset(row_size, 1), 0x33, row_size);
+   size_t valid_size = size;
+
+   // NOTE(law): A crash can cut the last record off anywhere, including
+   // inside its header.
+   size = test_database_log_append(log, size, 0, database_file_row_offset(row_size, 2), 0x44, row_size);
+   ASSERT(database_apply_log(log, size - 1, DATABASE_FILE_COUNT) == valid_size);
+   ASSERT(database_apply_log(log, valid_size + sizeof(Database_Log_Record) - 1, DATABASE_FILE_COUNT) == valid_size);
+
+   // NOTE(law): A damaged record stops the replay, even with an intact record
+   // after it.
+   log[valid_size + sizeof(Database_Log_Record)] ^= 0xFF;
+   size = test_database_log_append(log, size, 0, database_file_row_offset(row_size, 3), 0x55, row_size);
+   ASSERT(database_apply_log(log, size, DATABASE_FILE_COUNT) == valid_size);
+
+   ASSERT(test_database_log_row_is(0, 0, 0x11));
+   ASSERT(test_database_log_row_is(0, 1, 0x33));
+   ASSERT(!test_database_log_row_is(0, 2, 0x44));
+   ASSERT(!test_database_log_row_is(0, 3, 0x55));
+   ASSERT(test_database_log_row_is(1, 0, 0x22));
+
+   for(unsigned int file_id = 0; file_id < DATABASE_FILE_COUNT; ++file_id)
+   {
+      ASSERT(database_log.dirty_chunks[file_id][0]);
+      ASSERT(database_update_log_checksums(file_id));
+      ASSERT(!database_log.dirty_chunks[file_id][0]);
+
+      uint32_t checksums[DATABASE_PAGE_SIZE / sizeof(uint32_t)];
+      unsigned char page[DATABASE_PAGE_SIZE];
+
+      struct Platform_File_Handle *file = database_log.table_files[file_id];
+      ASSERT(platform_read_file_handle(file, database_file_chunk_offset(row_size, 0), checksums, sizeof(checksums)) == sizeof(checksums));
+
+      size_t page_size = platform_read_file_handle(file, database_file_row_offset(row_size, 0), page, sizeof(page));
+      ASSERT(page_size == ((file_id == 0) ? 2 : 1) * row_size);
+      ASSERT(checksums[0] == database_page_checksum(page, page_size));
+   }
+
+   size = 0;
+   size = test_database_log_append(log, size, 0, database_file_row_offset(row_size, 0), 0x66, row_size);
+   size = test_database_log_append(log, size, 1, database_file_row_offset(row_size, 0), 0x77, row_size);
+   ASSERT(database_apply_log(log, size, 1) == size);
+
+   ASSERT(test_database_log_row_is(0, 0, 0x11));
+   ASSERT(test_database_log_row_is(1, 0, 0x77));
+   ASSERT(!database_log.dirty_chunks[0][0] && database_log.dirty_chunks[1][0]);
+
+   platform_deallocate(log);
+   for(unsigned int file_id = 0; file_id < DATABASE_FILE_COUNT; ++file_id)
+   {
+      platform_close_file(database_log.table_files[file_id]);
+      platform_delete_file(file_paths[file_id]);
+      platform_deallocate(database_log.dirty_pages[file_id]);
+   }
+   zero_memory(&database_log, sizeof(database_log));
+}
+#endif
@@ -0,0 +1,410 @@
+/* /////////////////////////////////////////////////////////////////////////// */
+/* (c) copyright 2023 Lawrence D. Kern /////////////////////////////////////// */
+/* /////////////////////////////////////////////////////////////////////////// */
+
+// NOTE(law): Password hashing runs on a dedicated pool of KDF threads rather
+// than on the request threads. Concurrent jobs that share an iteration count
+// are grouped into batches, and each batch is derived in a single pass through
+// pbkdf2_hmac_sha256_lanes(), so a burst of logins fills the SIMD lanes instead
+// of running one PBKDF2 per core.
+
+typedef struct
+{
+   // NOTE(law): Inputs.
+   unsigned char *password_hash;
+   unsigned char *password;
+   size_t password_size;
+   unsigned char *salt;
+   unsigned int iteration_count;
+
+   // NOTE(law): Outputs, valid once the job has been completed.
+   unsigned int queue_depth;
+   unsigned int lane_count;
+   unsigned long long submitted;
+   unsigned long long started;
+   unsigned long long finished;
+
+   Platform_Work_Entry completion;
+} Password_Hash_Job;
+
+typedef struct
+{
+   bool in_use;
+   volatile bool open;
+
+   unsigned int iteration_count;
+   unsigned int job_count;
+   Password_Hash_Job *jobs[SHA256_MAX_LANE_COUNT];
+
+   // NOTE(law): The entry submitted to the work queue on behalf of the whole
+   // batch. Nothing ever waits on it directly - each job is completed
+   // individually - so the batch slot can be reused as soon as its callback
+   // has released it.
+   Platform_Work_Entry entry;
+} Password_Hash_Batch;
+
+typedef struct
+{
+   // NOTE(law): A background job that replaces the stored hash of an account
+   // whose iteration count is below the current target. The plaintext password
+   // is copied here since the request that supplied it will be long gone by the
+   // time the job runs, and it is wiped as soon as the new hash exists.
+
+   bool in_use;
+
+   char username[MAX_USERNAME_LENGTH + 1];
+   unsigned char password[MAX_PASSWORD_LENGTH];
+   size_t password_size;
+
+   Platform_Work_Entry entry;
+} Password_Rehash;
+
+static struct
+{
+   struct Platform_Work_Queue *queue;
+   struct Platform_Semaphore *semaphore;
+
+   unsigned int lane_width;
+   unsigned int batch_timeout_microseconds;
+
+   // NOTE(law): The iteration count used for new password hashes, calibrated
+   // at startup against the latency budget.
+   unsigned int iteration_count;
+
+   // NOTE(law): Every open batch contains a job from a request thread that is
+   // still waiting on it, so there can never be more than one batch per request
+   // thread, plus the ones still being released by the KDF threads.
+   Password_Hash_Batch batches[REQUEST_THREAD_COUNT + KDF_THREAD_COUNT];
+
+   Password_Rehash rehashes[16];
+} password_hash_scheduler;
+
+#define PASSWORD_HASH_BATCH_POLL_MICROSECONDS 50
+
+// NOTE(law): Calibration never selects fewer iterations than this, no matter
+// how slow the host is.
+#define PBKDF2_MINIMUM_ITERATION_COUNT 100000
+
+static void
+run_password_hash_batch(Password_Hash_Job **jobs, unsigned int job_count)
+{
+   ASSERT(job_count > 0 && job_count <= SHA256_MAX_LANE_COUNT);
+
+   unsigned long long started = platform_cpu_timestamp_counter();
+
+   if(job_count == 1)
+   {
+      Password_Hash_Job *job = jobs[0];
+      pbkdf2_hmac_sha256(job->password_hash, PASSWORD_HASH_LENGTH,
+                         job->password, job->password_size,
+                         job->salt, SALT_LENGTH,
+                         job->iteration_count);
+   }
+   else
+   {
+      unsigned char *password_hashes[SHA256_MAX_LANE_COUNT];
+      unsigned char *passwords[SHA256_MAX_LANE_COUNT];
+      size_t password_sizes[SHA256_MAX_LANE_COUNT];
+      unsigned char *salts[SHA256_MAX_LANE_COUNT];
+
+      for(unsigned int index = 0; index < job_count; ++index)
+      {
+         ASSERT(jobs[index]->iteration_count == jobs[0]->iteration_count);
+
+         password_hashes[index] = jobs[index]->password_hash;
+         passwords[index] = jobs[index]->password;
+         password_sizes[index] = jobs[index]->password_size;
+         salts[index] = jobs[index]->salt;
+      }
+
+      pbkdf2_hmac_sha256_lanes(password_hashes, PASSWORD_HASH_LENGTH,
+                               passwords, password_sizes,
+                               salts, SALT_LENGTH,
+                               jobs[0]->iteration_count,
+                               job_count);
+   }
+
+   unsigned long long finished = platform_cpu_timestamp_counter();
+
+   for(unsigned int index = 0; index < job_count; ++index)
+   {
+      jobs[index]->lane_count = job_count;
+      jobs[index]->started = started;
+      jobs[index]->finished = finished;
+   }
+}
+
+static
+PLATFORM_WORK_QUEUE_CALLBACK(process_password_hash_batch)
+{
+   Password_Hash_Batch *batch = (Password_Hash_Batch *)data;
+
+   // NOTE(law): If the batch is still open when a KDF thread picks it up, give
+   // other requests up to the batch timeout to join it before running it. Under
+   // load, batches tend to fill while they wait in the queue and this is
+   // skipped.
+   unsigned int remaining = password_hash_scheduler.batch_timeout_microseconds;
+   while(batch->open && remaining > 0)
+   {
+      unsigned int duration = MINIMUM(remaining, PASSWORD_HASH_BATCH_POLL_MICROSECONDS);
+      platform_sleep(duration);
+      remaining -= duration;
+   }
+
+   Password_Hash_Job *jobs[SHA256_MAX_LANE_COUNT];
+
+   platform_lock(password_hash_scheduler.semaphore);
+   batch->open = false;
+   unsigned int job_count = batch->job_count;
+   memory_copy(jobs, batch->jobs, job_count * sizeof(*jobs));
+   platform_unlock(password_hash_scheduler.semaphore);
+
+   run_password_hash_batch(jobs, job_count);
+
+   // NOTE(law): A job belongs to the stack of its request thread, so it must
+   // not be touched after it has been completed.
+   for(unsigned int index = 0; index < job_count; ++index)
+   {
+      platform_complete_work(password_hash_scheduler.queue, &jobs[index]->completion);
+   }
+
+   platform_lock(password_hash_scheduler.semaphore);
+   batch->in_use = false;
+   platform_unlock(password_hash_scheduler.semaphore);
+}
+
+static unsigned int
+calibrate_password_hash_iteration_count(unsigned int latency_budget_milliseconds)
+{
+   // NOTE(law): Measure how long a full batch takes on this host and pick the
+   // iteration count that fits in the latency budget. A full batch is the
+   // worst case a login can wait on once its job has left the queue.
+
+   // NOTE(law): The timestamp counter doesn't have a documented frequency, so
+   // estimate it against a sleep first.
+   unsigned int sleep_milliseconds = 50;
+   unsigned long long sleep_start = platform_cpu_timestamp_counter();
+   platform_sleep(sleep_milliseconds * 1000);
+   unsigned long long ticks_per_millisecond = (platform_cpu_timestamp_counter() - sleep_start) / sleep_milliseconds;
+
+   unsigned int lane_count = password_hash_scheduler.lane_width;
+   unsigned int sample_iteration_count = 10000;
+
+   unsigned char password_hashes[SHA256_MAX_LANE_COUNT][PASSWORD_HASH_LENGTH];
+   unsigned char salt[SALT_LENGTH] = {0};
+
+   Password_Hash_Job job_memory[SHA256_MAX_LANE_COUNT] = {0};
+   Password_Hash_Job *jobs[SHA256_MAX_LANE_COUNT];
+   for(unsigned int index = 0; index < lane_count; ++index)
+   {
+      jobs[index] = job_memory + index;
+      jobs[index]->password_hash = password_hashes[index];
+      jobs[index]->password = (unsigned char *)"calibration";
+      jobs[index]->password_size = sizeof("calibration") - 1;
+      jobs[index]->salt = salt;
+      jobs[index]->iteration_count = sample_iteration_count;
+   }
+
+   // NOTE(law): Keep the fastest of a few samples to filter out preemption.
+   unsigned long long sample_ticks = (unsigned long long)-1;
+   for(unsigned int sample = 0; sample < 3; ++sample)
+   {
+      run_password_hash_batch(jobs, lane_count);
+      sample_ticks = MINIMUM(sample_ticks, jobs[0]->finished - jobs[0]->started);
+   }
+
+   unsigned long long budget_ticks = latency_budget_milliseconds * ticks_per_millisecond;
+   unsigned long long iteration_count = (budget_ticks * sample_iteration_count) / MAXIMUM(sample_ticks, 1);
+
+   // NOTE(law): Round to a tidy number so that small variations between runs
+   // don't trigger a rehash of every account on each restart.
+   iteration_count -= iteration_count % 10000;
+
+   unsigned int result = PBKDF2_MINIMUM_ITERATION_COUNT;
+   if(iteration_count > result)
+   {
+      result = (iteration_count < 0xFFFFFFFF) ? (unsigned int)iteration_count : 0xFFFFFFFF;
+   }
+
+   platform_log_message("PBKDF2 calibration: %llu ticks per %u iterations (%u lanes), %llu ticks/ms, selected %u iterations for %ums.",
+                        sample_ticks,
+                        sample_iteration_count,
+                        lane_count,
+                        ticks_per_millisecond,
+                        result,
+                        latency_budget_milliseconds);
+
+   return result;
+}
+
+static void
+initialize_password_hashing(unsigned int thread_count,
+                            unsigned int queue_depth,
+                            unsigned int batch_timeout_microseconds,
+                            unsigned int latency_budget_milliseconds)
+{
+   // NOTE(law): This must run after initialize_sha256_backend(), since the
+   // batch size is the lane width of the selected multi-buffer backend.
+
+   password_hash_scheduler.lane_width = MINIMUM(global_sha256_lane_width, SHA256_MAX_LANE_COUNT);
+   password_hash_scheduler.batch_timeout_microseconds = batch_timeout_microseconds;
+   password_hash_scheduler.iteration_count = calibrate_password_hash_iteration_count(latency_budget_milliseconds);
+   password_hash_scheduler.semaphore = platform_initialize_semaphore();
+   password_hash_scheduler.queue = platform_initialize_work_queue(thread_count, queue_depth);
+
+   platform_log_message("Password hashing: %u KDF threads, batches of up to %u (%uus fill timeout).",
+                        thread_count,
+                        password_hash_scheduler.lane_width,
+                        batch_timeout_microseconds);
+}
+
+static
+PLATFORM_WORK_QUEUE_CALLBACK(process_password_rehash)
+{
+   Password_Rehash *rehash = (Password_Rehash *)data;
+
+   unsigned char salt[SALT_LENGTH];
+   platform_generate_random_bytes(salt, sizeof(salt));
+
+   unsigned char password_hash[PASSWORD_HASH_LENGTH];
+
+   Password_Hash_Job job = {0};
+   job.password_hash = password_hash;
+   job.password = rehash->password;
+   job.password_size = rehash->password_size;
+   job.salt = salt;
+   job.iteration_count = password_hash_scheduler.iteration_count;
+
+   // NOTE(law): This already runs on a KDF thread, so hash directly rather
+   // than waiting on a batch that would need another KDF thread to run it.
+   Password_Hash_Job *jobs[] = {&job};
+   run_password_hash_batch(jobs, 1);
+
+   zero_memory(rehash->password, sizeof(rehash->password));
+
+   // NOTE(law): If the update doesn't stick, the account keeps its old hash and
+   // is rehashed again at its next login.
+   if(!database_update_user_password(rehash->username, salt, password_hash, job.iteration_count))
+   {
+      platform_log_message("[ERROR] Failed to store the rehashed password for %s.", rehash->username);
+   }
+
+   platform_lock(password_hash_scheduler.semaphore);
+   rehash->in_use = false;
+   platform_unlock(password_hash_scheduler.semaphore);
+}
+
+static void
+schedule_password_rehash(char *username, char *password)
+{
+   // NOTE(law): Queue a background rehash of the account to the current
+   // iteration count. The password must already have been verified. If every
+   // rehash slot is busy, this is simply skipped and retried on the next login.
+
+   size_t username_size = string_length(username);
+   size_t password_size = string_length(password);
+   if(!password_hash_scheduler.queue ||
+      username_size > MAX_USERNAME_LENGTH ||
+      password_size > MAX_PASSWORD_LENGTH)
+   {
+      return;
+   }
+
+   Password_Rehash *rehash = 0;
+
+   platform_lock(password_hash_scheduler.semaphore);
+   for(unsigned int index = 0; index < ARRAY_LENGTH(password_hash_scheduler.rehashes); ++index)
+   {
+      Password_Rehash *test = password_hash_scheduler.rehashes + index;
+      if(!test->in_use)
+      {
+         rehash = test;
+         rehash->in_use = true;
+         break;
+      }
+   }
+   platform_unlock(password_hash_scheduler.semaphore);
+
+   if(rehash)
+   {
+      zero_memory(rehash->username, sizeof(rehash->username));
+      memory_copy(rehash->username, username, username_size);
+      memory_copy(rehash->password, password, password_size);
+      rehash->password_size = password_size;
+
+      rehash->entry.callback = process_password_rehash;
+      rehash->entry.data = rehash;
+      platform_submit_work(password_hash_scheduler.queue, &rehash->entry);
+   }
+}
+
+static void
+derive_password_hash_blocking(Password_Hash_Job *job)
+{
+   // NOTE(law): Blocks until job->password_hash has been derived. The job is
+   // added to the open batch with a matching iteration count if there is one,
+   // otherwise it opens a new batch and submits it to the KDF threads.
+
+   job->submitted = platform_cpu_timestamp_counter();
+   job->queue_depth = 0;
+
+   if(!password_hash_scheduler.queue)
+   {
+      Password_Hash_Job *jobs[] = {job};
+      run_password_hash_batch(jobs, 1);
+      return;
+   }
+
+   job->completion.completed = false;
+
+   Password_Hash_Batch *new_batch = 0;
+
+   platform_lock(password_hash_scheduler.semaphore);
+   Password_Hash_Batch *batch = 0;
+   for(unsigned int index = 0; index < ARRAY_LENGTH(password_hash_scheduler.batches); ++index)
+   {
+      Password_Hash_Batch *test = password_hash_scheduler.batches + index;
+      if(test->in_use && test->open && test->iteration_count == job->iteration_count)
+      {
+         batch = test;
+         break;
+      }
+   }
+
+   if(!batch)
+   {
+      for(unsigned int index = 0; index < ARRAY_LENGTH(password_hash_scheduler.batches); ++index)
+      {
+         Password_Hash_Batch *test = password_hash_scheduler.batches + index;
+         if(!test->in_use)
+         {
+            batch = test;
+            break;
+         }
+      }
+      ASSERT(batch);
+
+      batch->in_use = true;
+      batch->open = true;
+      batch->iteration_count = job->iteration_count;
+      batch->job_count = 0;
+
+      new_batch = batch;
+   }
+
+   batch->jobs[batch->job_count++] = job;
+   if(batch->job_count == password_hash_scheduler.lane_width)
+   {
+      batch->open = false;
+   }
+   platform_unlock(password_hash_scheduler.semaphore);
+
+   if(new_batch)
+   {
+      new_batch->entry.callback = process_password_hash_batch;
+      new_batch->entry.data = new_batch;
+      job->queue_depth = platform_submit_work(password_hash_scheduler.queue, &new_batch->entry);
+   }
+
+   platform_wait_for_work(password_hash_scheduler.queue, &job->completion);
+}
@@ -5,13 +5,53 @@
 #include <stdarg.h>
 #include <stdlib.h>
 
-// TODO(law): All of the hand-written memory/string operations in this file are
-// intentionally written in a very straightforward, unoptimized way. They will
-// eventually require an optimization pass as they actually introduce
-// bottlenecks in practice.
+// NOTE(law): Every parser, template and database path goes through the memory
+// and string primitives below, so each one has SSE2/AVX2 and NEON versions,
+// picked once at startup by initialize_memory_backend(). Anything under 16
+// bytes stays with the byte loops, since the call through the function pointer
+// would cost more than the work. The vector versions use unaligned loads and
+// stores, and finish a partial tail with one last vector that overlaps the
+// previous one instead of falling back to bytes.
+
+static unsigned int
+memory_lowest_set_bit(uint64_t value)
+{
+   ASSERT(value);
+
+#if defined(_MSC_VER)
+   unsigned long result;
+   _BitScanForward64(&result, value);
+#else
+   unsigned int result = __builtin_ctzll(value);
+#endif
+
+   return (unsigned int)result;
+}
+
+static void
+memory_copy_scalar(void *destination, void *source, size_t size)
+{
+   unsigned char *destination_bytes = destination;
+   unsigned char *source_bytes = source;
+
+   for(size_t index = 0; index < size; ++index)
+   {
+      *destination_bytes++ = *source_bytes++;
+   }
+}
+
+static void
+memory_set_scalar(void *destination, size_t size, unsigned char value)
+{
+   unsigned char *bytes = destination;
+   for(size_t index = 0; index < size; ++index)
+   {
+      *bytes++ = value;
+   }
+}
 
 static size_t
-string_length(char *string)
+string_length_scalar(char *string)
 {
    size_t result = 0;
 
@@ -24,7 +64,7 @@ string_length(char *string)
 }
 
 static bool
-bytes_are_equal(void *a, void *b, size_t size)
+bytes_are_equal_scalar(void *a, void *b, size_t size)
 {
    bool result = true;
 
@@ -43,6 +83,445 @@ bytes_are_equal(void *a, void *b, size_t size)
    return result;
 }
 
+// NOTE(law): The vector copies load their last vector before storing anything,
+// so copying down within a buffer (destination before source) still works the
+// way it did with the byte loop. The string length functions only use aligned
+// loads, which can't cross into the next page, so reading past the terminator
+// within the same vector can't fault.
+
+#if defined(PLATFORM_X64)
+static void
+memory_copy_x86_sse2(void *destination, void *source, size_t size)
+{
+   ASSERT(size >= 16);
+
+   unsigned char *destination_bytes = destination;
+   unsigned char *source_bytes = source;
+
+   __m128i tail = _mm_loadu_si128((__m128i *)(source_bytes + size - 16));
+   for(size_t offset = 0; offset + 16 < size; offset += 16)
+   {
+      __m128i block = _mm_loadu_si128((__m128i *)(source_bytes + offset));
+      _mm_storeu_si128((__m128i *)(destination_bytes + offset), block);
+   }
+   _mm_storeu_si128((__m128i *)(destination_bytes + size - 16), tail);
+}
+
+static void
+memory_set_x86_sse2(void *destination, size_t size, unsigned char value)
+{
+   ASSERT(size >= 16);
+
+   unsigned char *bytes = destination;
+   __m128i values = _mm_set1_epi8((char)value);
+
+   for(size_t offset = 0; offset + 16 < size; offset += 16)
+   {
+      _mm_storeu_si128((__m128i *)(bytes + offset), values);
+   }
+   _mm_storeu_si128((__m128i *)(bytes + size - 16), values);
+}
+
+static size_t
+string_length_x86_sse2(char *string)
+{
+   uintptr_t address = (uintptr_t)string;
+   __m128i *block = (__m128i *)(address & ~(uintptr_t)15);
+   __m128i zero = _mm_setzero_si128();
+
+   // NOTE(law): Bytes in the first block that come before the string are
+   // shifted out of the mask.
+   uint32_t mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(block), zero));
+   mask >>= (address & 15);
+   if(mask)
+   {
+      return memory_lowest_set_bit(mask);
+   }
+
+   do
+   {
+      block++;
+      mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_load_si128(block), zero));
+   } while(!mask);
+
+   size_t result = ((char *)block - string) + memory_lowest_set_bit(mask);
+   return result;
+}
+
+static bool
+bytes_are_equal_x86_sse2(void *a, void *b, size_t size)
+{
+   ASSERT(size >= 16);
+
+   unsigned char *a_bytes = (unsigned char *)a;
+   unsigned char *b_bytes = (unsigned char *)b;
+
+   for(size_t offset = 0; offset + 16 < size; offset += 16)
+   {
+      __m128i a_block = _mm_loadu_si128((__m128i *)(a_bytes + offset));
+      __m128i b_block = _mm_loadu_si128((__m128i *)(b_bytes + offset));
+      if(_mm_movemask_epi8(_mm_cmpeq_epi8(a_block, b_block)) != 0xFFFF)
+      {
+         return false;
+      }
+   }
+
+   __m128i a_tail = _mm_loadu_si128((__m128i *)(a_bytes + size - 16));
+   __m128i b_tail = _mm_loadu_si128((__m128i *)(b_bytes + size - 16));
+
+   bool result = (_mm_movemask_epi8(_mm_cmpeq_epi8(a_tail, b_tail)) == 0xFFFF);
+   return result;
+}
+
+PLATFORM_TARGET("avx2")
+static void
+memory_copy_x86_avx2(void *destination, void *source, size_t size)
+{
+   if(size < 32)
+   {
+      memory_copy_x86_sse2(destination, source, size);
+      return;
+   }
+
+   unsigned char *destination_bytes = destination;
+   unsigned char *source_bytes = source;
+
+   __m256i tail = _mm256_loadu_si256((__m256i *)(source_bytes + size - 32));
+   for(size_t offset = 0; offset + 32 < size; offset += 32)
+   {
+      __m256i block = _mm256_loadu_si256((__m256i *)(source_bytes + offset));
+      _mm256_storeu_si256((__m256i *)(destination_bytes + offset), block);
+   }
+   _mm256_storeu_si256((__m256i *)(destination_bytes + size - 32), tail);
+}
+
+PLATFORM_TARGET("avx2")
+static void
+memory_set_x86_avx2(void *destination, size_t size, unsigned char value)
+{
+   if(size < 32)
+   {
+      memory_set_x86_sse2(destination, size, value);
+      return;
+   }
+
+   unsigned char *bytes = destination;
+   __m256i values = _mm256_set1_epi8((char)value);
+
+   for(size_t offset = 0; offset + 32 < size; offset += 32)
+   {
+      _mm256_storeu_si256((__m256i *)(bytes + offset), values);
+   }
+   _mm256_storeu_si256((__m256i *)(bytes + size - 32), values);
+}
+
+PLATFORM_TARGET("avx2")
+static size_t
+string_length_x86_avx2(char *string)
+{
+   uintptr_t address = (uintptr_t)string;
+   __m256i *block = (__m256i *)(address & ~(uintptr_t)31);
+   __m256i zero = _mm256_setzero_si256();
+
+   uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256(block), zero));
+   mask >>= (address & 31);
+   if(mask)
+   {
+      return memory_lowest_set_bit(mask);
+   }
+
+   do
+   {
+      block++;
+      mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_load_si256(block), zero));
+   } while(!mask);
+
+   size_t result = ((char *)block - string) + memory_lowest_set_bit(mask);
+   return result;
+}
+
+PLATFORM_TARGET("avx2")
+static bool
+bytes_are_equal_x86_avx2(void *a, void *b, size_t size)
+{
+   if(size < 32)
+   {
+      return bytes_are_equal_x86_sse2(a, b, size);
+   }
+
+   unsigned char *a_bytes = (unsigned char *)a;
+   unsigned char *b_bytes = (unsigned char *)b;
+
+   for(size_t offset = 0; offset + 32 < size; offset += 32)
+   {
+      __m256i a_block = _mm256_loadu_si256((__m256i *)(a_bytes + offset));
+      __m256i b_block = _mm256_loadu_si256((__m256i *)(b_bytes + offset));
+      if((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a_block, b_block)) != 0xFFFFFFFF)
+      {
+         return false;
+      }
+   }
+
+   __m256i a_tail = _mm256_loadu_si256((__m256i *)(a_bytes + size - 32));
+   __m256i b_tail = _mm256_loadu_si256((__m256i *)(b_bytes + size - 32));
+
+   bool result = ((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a_tail, b_tail)) == 0xFFFFFFFF);
+   return result;
+}
+#endif
+
+#if defined(PLATFORM_ARM64)
+static void
+memory_copy_arm_neon(void *destination, void *source, size_t size)
+{
+   ASSERT(size >= 16);
+
+   uint8_t *destination_bytes = destination;
+   uint8_t *source_bytes = source;
+
+   uint8x16_t tail = vld1q_u8(source_bytes + size - 16);
+   for(size_t offset = 0; offset + 16 < size; offset += 16)
+   {
+      vst1q_u8(destination_bytes + offset, vld1q_u8(source_bytes + offset));
+   }
+   vst1q_u8(destination_bytes + size - 16, tail);
+}
+
+static void
+memory_set_arm_neon(void *destination, size_t size, unsigned char value)
+{
+   ASSERT(size >= 16);
+
+   uint8_t *bytes = destination;
+   uint8x16_t values = vdupq_n_u8(value);
+
+   for(size_t offset = 0; offset + 16 < size; offset += 16)
+   {
+      vst1q_u8(bytes + offset, values);
+   }
+   vst1q_u8(bytes + size - 16, values);
+}
+
+static uint64_t
+memory_arm_neon_zero_mask(uint8_t *block)
+{
+   // NOTE(law): NEON has no movemask. Narrowing the comparison by 4 bits per
+   // byte packs it into a 64-bit value with a nibble per byte instead.
+
+   uint8x16_t zeros = vceqq_u8(vld1q_u8(block), vdupq_n_u8(0));
+   uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(zeros), 4);
+
+   uint64_t result = vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+   return result;
+}
+
+static size_t
+string_length_arm_neon(char *string)
+{
+   uintptr_t address = (uintptr_t)string;
+   uint8_t *block = (uint8_t *)(address & ~(uintptr_t)15);
+
+   uint64_t mask = memory_arm_neon_zero_mask(block) >> (4 * (address & 15));
+   if(mask)
+   {
+      return memory_lowest_set_bit(mask) / 4;
+   }
+
+   do
+   {
+      block += 16;
+      mask = memory_arm_neon_zero_mask(block);
+   } while(!mask);
+
+   size_t result = ((char *)block - string) + (memory_lowest_set_bit(mask) / 4);
+   return result;
+}
+
+static bool
+bytes_are_equal_arm_neon(void *a, void *b, size_t size)
+{
+   ASSERT(size >= 16);
+
+   uint8_t *a_bytes = (uint8_t *)a;
+   uint8_t *b_bytes = (uint8_t *)b;
+
+   for(size_t offset = 0; offset + 16 < size; offset += 16)
+   {
+      if(vminvq_u8(vceqq_u8(vld1q_u8(a_bytes + offset), vld1q_u8(b_bytes + offset))) != 0xFF)
+      {
+         return false;
+      }
+   }
+
+   uint8x16_t equal = vceqq_u8(vld1q_u8(a_bytes + size - 16), vld1q_u8(b_bytes + size - 16));
+
+   bool result = (vminvq_u8(equal) == 0xFF);
+   return result;
+}
+#endif
+
+typedef void Memory_Copy(void *destination, void *source, size_t size);
+typedef void Memory_Set(void *destination, size_t size, unsigned char value);
+typedef size_t String_Length(char *string);
+typedef bool Bytes_Are_Equal(void *a, void *b, size_t size);
+
+static Memory_Backend global_memory_backend = MEMORY_BACKEND_SCALAR;
+static Memory_Copy *global_memory_copy = memory_copy_scalar;
+static Memory_Set *global_memory_set = memory_set_scalar;
+static String_Length *global_string_length = string_length_scalar;
+static Bytes_Are_Equal *global_bytes_are_equal = bytes_are_equal_scalar;
+
+static bool
+memory_backend_is_supported(Memory_Backend backend)
+{
+   Platform_Cpu_Features features = platform_query_cpu_features();
+
+   bool result = false;
+   switch(backend)
+   {
+      case MEMORY_BACKEND_SCALAR:   {result = true;} break;
+#if defined(PLATFORM_X64)
+      case MEMORY_BACKEND_X86_SSE2: {result = true;} break;
+      case MEMORY_BACKEND_X86_AVX2: {result = features.x86_avx2;} break;
+#endif
+#if defined(PLATFORM_ARM64)
+      case MEMORY_BACKEND_ARM_NEON: {result = true;} break;
+#endif
+      default: {result = false;} break;
+   }
+   (void)features;
+
+   return result;
+}
+
+static char *
+memory_backend_name(Memory_Backend backend)
+{
+   char *result = "unknown";
+   switch(backend)
+   {
+      case MEMORY_BACKEND_SCALAR:   {result = "scalar";} break;
+      case MEMORY_BACKEND_X86_SSE2: {result = "x86 SSE2";} break;
+      case MEMORY_BACKEND_X86_AVX2: {result = "x86 AVX2";} break;
+      case MEMORY_BACKEND_ARM_NEON: {result = "ARM NEON";} break;
+      default: break;
+   }
+
+   return result;
+}
+
+static void
+set_memory_backend(Memory_Backend backend)
+{
+   ASSERT(memory_backend_is_supported(backend));
+
+   global_memory_backend = backend;
+   switch(backend)
+   {
+#if defined(PLATFORM_X64)
+      case MEMORY_BACKEND_X86_SSE2:
+      {
+         global_memory_copy = memory_copy_x86_sse2;
+         global_memory_set = memory_set_x86_sse2;
+         global_string_length = string_length_x86_sse2;
+         global_bytes_are_equal = bytes_are_equal_x86_sse2;
+      } break;
+
+      case MEMORY_BACKEND_X86_AVX2:
+      {
+         global_memory_copy = memory_copy_x86_avx2;
+         global_memory_set = memory_set_x86_avx2;
+         global_string_length = string_length_x86_avx2;
+         global_bytes_are_equal = bytes_are_equal_x86_avx2;
+      } break;
+#endif
+#if defined(PLATFORM_ARM64)
+      case MEMORY_BACKEND_ARM_NEON:
+      {
+         global_memory_copy = memory_copy_arm_neon;
+         global_memory_set = memory_set_arm_neon;
+         global_string_length = string_length_arm_neon;
+         global_bytes_are_equal = bytes_are_equal_arm_neon;
+      } break;
+#endif
+      default:
+      {
+         global_memory_copy = memory_copy_scalar;
+         global_memory_set = memory_set_scalar;
+         global_string_length = string_length_scalar;
+         global_bytes_are_equal = bytes_are_equal_scalar;
+      } break;
+   }
+}
+
+static void
+initialize_memory_backend(void)
+{
+   // NOTE(law): Like the SHA256 and CRC32C backends, this is picked once at
+   // startup before any other threads are launched.
+
+   Memory_Backend backend = MEMORY_BACKEND_SCALAR;
+   if(memory_backend_is_supported(MEMORY_BACKEND_X86_AVX2))
+   {
+      backend = MEMORY_BACKEND_X86_AVX2;
+   }
+   else if(memory_backend_is_supported(MEMORY_BACKEND_X86_SSE2))
+   {
+      backend = MEMORY_BACKEND_X86_SSE2;
+   }
+   else if(memory_backend_is_supported(MEMORY_BACKEND_ARM_NEON))
+   {
+      backend = MEMORY_BACKEND_ARM_NEON;
+   }
+
+   set_memory_backend(backend);
+   platform_log_message("Memory backend: %s.", memory_backend_name(backend));
+}
+
+static size_t
+string_length(char *string)
+{
+   size_t result = global_string_length(string);
+   return result;
+}
+
+static bool
+bytes_are_equal(void *a, void *b, size_t size)
+{
+   bool result;
+   if(size < 16)
+   {
+      result = bytes_are_equal_scalar(a, b, size);
+   }
+   else
+   {
+      result = global_bytes_are_equal(a, b, size);
+   }
+
+   return result;
+}
+
+static bool
+bytes_are_equal_constant_time(void *a, void *b, size_t size)
+{
+   // NOTE(law): Looks at every byte no matter where the first difference is, so
+   // the time taken doesn't reveal how much of a secret (e.g. a password hash)
+   // was matched. The accumulator is volatile to keep the compiler from adding
+   // an early exit of its own.
+
+   unsigned char *a_bytes = (unsigned char *)a;
+   unsigned char *b_bytes = (unsigned char *)b;
+
+   volatile unsigned char difference = 0;
+   for(size_t index = 0; index < size; ++index)
+   {
+      difference |= a_bytes[index] ^ b_bytes[index];
+   }
+
+   bool result = (difference == 0);
+   return result;
+}
+
 static bool
 strings_are_equal(char *a, char *b)
 {
@@ -142,24 +621,26 @@ format_string(char *destination, size_t size, char *format, ...)
 static void
 memory_copy(void *destination, void *source, size_t size)
 {
-   // TODO(law): Speed up with SIMD.
-   unsigned char *destination_bytes = destination;
-   unsigned char *source_bytes = source;
-
-   for(size_t index = 0; index < size; ++index)
+   if(size < 16)
    {
-      *destination_bytes++ = *source_bytes++;
+      memory_copy_scalar(destination, source, size);
+   }
+   else
+   {
+      global_memory_copy(destination, source, size);
    }
 }
 
 static void
 memory_set(void *destination, size_t size, unsigned char value)
 {
-   // TODO(law): Speed up with SIMD.
-   unsigned char *bytes = destination;
-   for(size_t index = 0; index < size; ++index)
+   if(size < 16)
    {
-      *bytes++ = value;
+      memory_set_scalar(destination, size, value);
+   }
+   else
+   {
+      global_memory_set(destination, size, value);
    }
 }
 
@@ -169,13 +650,137 @@ zero_memory(void *destination, size_t size)
    memory_set(destination, size, 0);
 }
 
+static char hexadecimal_digit_pairs[] =
+   "000102030405060708090a0b0c0d0e0f"
+   "101112131415161718191a1b1c1d1e1f"
+   "202122232425262728292a2b2c2d2e2f"
+   "303132333435363738393a3b3c3d3e3f"
+   "404142434445464748494a4b4c4d4e4f"
+   "505152535455565758595a5b5c5d5e5f"
+   "606162636465666768696a6b6c6d6e6f"
+   "707172737475767778797a7b7c7d7e7f"
+   "808182838485868788898a8b8c8d8e8f"
+   "909192939495969798999a9b9c9d9e9f"
+   "a0a1a2a3a4a5a6a7a8a9aaabacadaeaf"
+   "b0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+   "c0c1c2c3c4c5c6c7c8c9cacbcccdcecf"
+   "d0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+   "e0e1e2e3e4e5e6e7e8e9eaebecedeeef"
+   "f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+static unsigned char
+hexadecimal_digit_value(char character)
+{
+   // NOTE(law): Branch-free conversion of a single hexadecimal digit. The low
+   // nibble of '0'-'9' is already the value, and the low nibble of 'A'-'F' and
+   // 'a'-'f' is 1-6, which bit 6 (set for letters only) shifts up by 9. The
+   // result is meaningless for non-hexadecimal characters, so validate with
+   // is_hexadecimal_digit() first if the input is untrusted.
+
+   unsigned char result = (unsigned char)((character & 0xf) + (9 * ((character >> 6) & 1)));
+   return result;
+}
+
+static void
+bytes_to_hexadecimal_string(char *destination, void *source, size_t size)
+{
+   // NOTE(law): Write the lowercase hexadecimal encoding of size bytes to
+   // destination, followed by a null terminator (so destination must hold at
+   // least 2*size + 1 characters). Runs of 16 bytes are encoded with SSE2 or
+   // NEON, which are part of the baseline for both 64-bit targets, and the tail
+   // is looked up two digits at a time.
+
+   unsigned char *bytes = source;
+
+#if defined(PLATFORM_X64)
+   __m128i low_nibble_mask = _mm_set1_epi8(0x0f);
+   __m128i nine = _mm_set1_epi8(9);
+   __m128i digit_offset = _mm_set1_epi8('0');
+   __m128i letter_offset = _mm_set1_epi8('a' - '0' - 10);
+
+   while(size >= 16)
+   {
+      __m128i input = _mm_loadu_si128((__m128i *)bytes);
+      __m128i high = _mm_and_si128(_mm_srli_epi16(input, 4), low_nibble_mask);
+      __m128i low = _mm_and_si128(input, low_nibble_mask);
+
+      // Interleave so the high nibble of each byte comes first.
+      __m128i nibbles[2];
+      nibbles[0] = _mm_unpacklo_epi8(high, low);
+      nibbles[1] = _mm_unpackhi_epi8(high, low);
+
+      for(unsigned int index = 0; index < 2; ++index)
+      {
+         __m128i is_letter = _mm_cmpgt_epi8(nibbles[index], nine);
+         __m128i characters = _mm_add_epi8(nibbles[index], digit_offset);
+         characters = _mm_add_epi8(characters, _mm_and_si128(is_letter, letter_offset));
+
+         _mm_storeu_si128((__m128i *)(destination + (16 * index)), characters);
+      }
+
+      bytes += 16;
+      destination += 32;
+      size -= 16;
+   }
+#elif defined(PLATFORM_ARM64)
+   uint8x16_t low_nibble_mask = vdupq_n_u8(0x0f);
+   uint8x16_t nine = vdupq_n_u8(9);
+   uint8x16_t digit_offset = vdupq_n_u8('0');
+   uint8x16_t letter_offset = vdupq_n_u8('a' - '0' - 10);
+
+   while(size >= 16)
+   {
+      uint8x16_t input = vld1q_u8(bytes);
+
+      uint8x16x2_t characters;
+      characters.val[0] = vshrq_n_u8(input, 4);
+      characters.val[1] = vandq_u8(input, low_nibble_mask);
+
+      for(unsigned int index = 0; index < 2; ++index)
+      {
+         uint8x16_t nibbles = characters.val[index];
+         uint8x16_t is_letter = vcgtq_u8(nibbles, nine);
+         characters.val[index] = vaddq_u8(vaddq_u8(nibbles, digit_offset), vandq_u8(is_letter, letter_offset));
+      }
+
+      // NOTE(law): vst2q interleaves the two registers, putting the high nibble
+      // of each byte first.
+      vst2q_u8((uint8_t *)destination, characters);
+
+      bytes += 16;
+      destination += 32;
+      size -= 16;
+   }
+#endif
+
+   while(size > 0)
+   {
+      char *pair = hexadecimal_digit_pairs + (2 * (*bytes++));
+      *destination++ = pair[0];
+      *destination++ = pair[1];
+      size--;
+   }
+
+   *destination = 0;
+}
+
 static void
 print_bytes(Request_State *request, void *source, size_t size)
 {
+   // NOTE(law): Encode into a local buffer so that a run of bytes goes out in a
+   // few OUT() calls rather than one call per byte.
+
    unsigned char *bytes = source;
-   for(size_t index = 0; index < size; ++index)
+   while(size > 0)
    {
-      OUT("%02x", bytes[index]);
+      char text[(2 * 128) + 1];
+      size_t count = (size < 128) ? size : 128;
+
+      bytes_to_hexadecimal_string(text, bytes, count);
+      OUT("%s", text);
+
+      bytes += count;
+      size -= count;
    }
 }
 
@@ -188,13 +793,12 @@ hexadecimal_string_to_bytes(unsigned char *destination, size_t destination_size,
 
    while(source_size > 0)
    {
-      char hex_byte_string[3];
-      hex_byte_string[0] = *source++;
-      hex_byte_string[1] = *source++;
-      hex_byte_string[2] = 0;
+      unsigned char high = hexadecimal_digit_value(source[0]);
+      unsigned char low = hexadecimal_digit_value(source[1]);
 
-      *destination++ = (unsigned char)hexadecimal_string_to_integer(hex_byte_string);
+      *destination++ = (unsigned char)((high << 4) | low);
 
+      source += 2;
       destination_size -= 1;
       source_size      -= 2;
    }
@@ -203,11 +807,87 @@ hexadecimal_string_to_bytes(unsigned char *destination, size_t destination_size,
 static void
 initialize_arena(Memory_Arena *arena, unsigned char *base_address, size_t size)
 {
+   zero_memory(arena, sizeof(*arena));
+
    arena->base_address = base_address;
    arena->size = size;
    arena->used = 0;
 }
 
+static char *
+page_backing_name(Page_Backing backing)
+{
+   char *result = "small";
+   switch(backing)
+   {
+      case PAGE_BACKING_SMALL:            {result = "small";} break;
+      case PAGE_BACKING_TRANSPARENT_HUGE: {result = "transparent huge";} break;
+      case PAGE_BACKING_HUGE:             {result = "huge";} break;
+   }
+
+   return result;
+}
+
+static bool
+reserve_arena(Memory_Arena *arena, size_t soft_limit, unsigned int flags)
+{
+   // NOTE(law): Nothing is committed up front, so an arena costs nothing but
+   // address space until it's used. flags are passed on to
+   // platform_reserve_memory().
+
+   zero_memory(arena, sizeof(*arena));
+
+   size_t reserve_size = MAXIMUM(soft_limit, ARENA_RESERVE_SIZE);
+   arena->base_address = platform_reserve_memory(reserve_size, flags, &arena->page_backing);
+   if(arena->base_address)
+   {
+      arena->reserve_size = reserve_size;
+      arena->soft_limit = soft_limit;
+   }
+
+   bool result = (arena->base_address != 0);
+   return result;
+}
+
+static bool
+grow_arena(Memory_Arena *arena, size_t size)
+{
+   // NOTE(law): Commit enough of a growable arena's reservation to fit size
+   // more bytes.
+
+   bool result = false;
+
+   size_t needed = arena->used + size;
+   if(arena->reserve_size && needed >= arena->used && needed <= arena->reserve_size)
+   {
+      size_t commit_size = (needed + ARENA_COMMIT_SIZE - 1) & ~(size_t)(ARENA_COMMIT_SIZE - 1);
+      commit_size = MINIMUM(commit_size, arena->reserve_size);
+
+      result = platform_commit_memory(arena->base_address + arena->size, commit_size - arena->size);
+      if(result)
+      {
+         arena->size = commit_size;
+
+         if(arena->soft_limit && arena->size > arena->soft_limit && !arena->soft_limit_reported)
+         {
+            platform_log_message("[WARNING] Arena has grown past its soft limit of %zu bytes.", arena->soft_limit);
+            arena->soft_limit_reported = true;
+         }
+      }
+   }
+
+   return result;
+}
+
+static void
+reset_arena(Memory_Arena *arena)
+{
+   // NOTE(law): Committed memory is kept for reuse.
+
+   ASSERT(arena->temporary_count == 0);
+   arena->used = 0;
+}
+
 #define PUSH_SIZE(arena, size)           push_size_((arena), (size))
 #define PUSH_STRUCT(arena, Type) (Type *)push_size_((arena), sizeof(Type))
 
@@ -216,16 +896,266 @@ push_size_(Memory_Arena *arena, size_t size)
 {
    void *result = 0;
 
-   if(size <= (arena->size - arena->used))
+   if(size <= (arena->size - arena->used) || grow_arena(arena, size))
    {
       result = arena->base_address + arena->used;
       arena->used += size;
+      arena->high_water_mark = MAXIMUM(arena->high_water_mark, arena->used);
    }
    else
    {
-      // TODO(law): Replace with a growing arena.
       platform_log_message("[WARNING] Arena is full, failed to allocate memory.");
    }
 
    return result;
 }
+
+static void
+trim_arena(Memory_Arena *arena)
+{
+   // NOTE(law): Return committed pages beyond the arena's working set to the
+   // OS, so that a single large request doesn't keep its memory resident for
+   // the life of the process. Only growable arenas are trimmed, and only while
+   // nothing is in use.
+
+   ASSERT(arena->used == 0);
+
+   if(arena->reserve_size)
+   {
+      size_t decayed = arena->working_set - (arena->working_set >> ARENA_TRIM_DECAY_SHIFT);
+      arena->working_set = MAXIMUM(decayed, arena->high_water_mark);
+      arena->high_water_mark = 0;
+
+      size_t keep_size = (arena->working_set + ARENA_COMMIT_SIZE - 1) & ~(size_t)(ARENA_COMMIT_SIZE - 1);
+      if(arena->size > keep_size + ARENA_TRIM_SLACK)
+      {
+         platform_decommit_memory(arena->base_address + keep_size, arena->size - keep_size);
+         arena->size = keep_size;
+      }
+   }
+}
+
+static Temporary_Memory
+begin_temporary_memory(Memory_Arena *arena)
+{
+   // NOTE(law): Everything pushed onto the arena between this and the matching
+   // end_temporary_memory() is released at once. Scopes nest.
+
+   Temporary_Memory result;
+   result.arena = arena;
+   result.used = arena->used;
+
+   arena->temporary_count++;
+
+   return result;
+}
+
+static void
+end_temporary_memory(Temporary_Memory temporary)
+{
+   Memory_Arena *arena = temporary.arena;
+
+   ASSERT(arena->temporary_count > 0);
+   ASSERT(arena->used >= temporary.used);
+
+   arena->used = temporary.used;
+   arena->temporary_count--;
+}
+
+#if DEVELOPMENT_BUILD
+static void
+test_memory_arena(void)
+{
+   // NOTE(law): Grow an arena well past its soft limit, and check that
+   // temporary memory hands back exactly what was pushed within it.
+
+   Memory_Arena arena;
+   bool reserved = reserve_arena(&arena, 2 * ARENA_COMMIT_SIZE, 0);
+   ASSERT(reserved);
+   ASSERT(arena.size == 0);
+
+   unsigned char *first = PUSH_SIZE(&arena, 100);
+   ASSERT(first && arena.size == ARENA_COMMIT_SIZE);
+   memory_set(first, 100, 0xAB);
+
+   Temporary_Memory outer = begin_temporary_memory(&arena);
+   {
+      unsigned char *large = PUSH_SIZE(&arena, 4 * ARENA_COMMIT_SIZE);
+      ASSERT(large && arena.size == 5 * ARENA_COMMIT_SIZE);
+      memory_set(large, 4 * ARENA_COMMIT_SIZE, 0xCD);
+
+      Temporary_Memory inner = begin_temporary_memory(&arena);
+      unsigned char *small = PUSH_SIZE(&arena, 1);
+      ASSERT(small);
+      end_temporary_memory(inner);
+
+      ASSERT(arena.used == 100 + (4 * ARENA_COMMIT_SIZE));
+   }
+   end_temporary_memory(outer);
+
+   ASSERT(arena.used == 100 && arena.temporary_count == 0);
+   ASSERT(first[0] == 0xAB && first[99] == 0xAB);
+
+   // NOTE(law): Committed memory is kept, and pushing past the reservation
+   // fails without committing anything.
+   unsigned char *overflow = PUSH_SIZE(&arena, arena.reserve_size);
+   ASSERT(!overflow);
+   ASSERT(arena.size == 5 * ARENA_COMMIT_SIZE);
+
+   reset_arena(&arena);
+   ASSERT(arena.used == 0 && arena.size == 5 * ARENA_COMMIT_SIZE);
+
+   // NOTE(law): A large peak is kept through the next few trims, and then
+   // returned bit by bit as the working set estimate decays. Decommitted
+   // memory comes back zeroed once it's needed again.
+   unsigned char *peak = PUSH_SIZE(&arena, ARENA_TRIM_SLACK + (8 * ARENA_COMMIT_SIZE));
+   ASSERT(peak);
+   memory_set(peak, ARENA_TRIM_SLACK + (8 * ARENA_COMMIT_SIZE), 0xEF);
+
+   size_t peak_size = arena.size;
+   reset_arena(&arena);
+   trim_arena(&arena);
+   ASSERT(arena.size == peak_size);
+
+   for(unsigned int trim = 0; trim < 64; ++trim)
+   {
+      trim_arena(&arena);
+   }
+   ASSERT(arena.size < peak_size && arena.size <= ARENA_TRIM_SLACK);
+   ASSERT(arena.working_set < ARENA_COMMIT_SIZE);
+
+   peak = PUSH_SIZE(&arena, peak_size);
+   ASSERT(peak && peak[peak_size - 1] == 0);
+   reset_arena(&arena);
+
+   platform_release_memory(arena.base_address, arena.reserve_size);
+}
+
+static void
+test_memory_primitives(void)
+{
+   // NOTE(law): Check every backend supported by the current CPU against the
+   // byte loops, at every alignment and at sizes on both sides of each vector
+   // width. Bytes just outside the range must be left alone.
+
+   Memory_Backend selected_backend = global_memory_backend;
+
+   unsigned char source[256];
+   for(unsigned int index = 0; index < sizeof(source); ++index)
+   {
+      source[index] = (unsigned char)(((index * 7) % 255) + 1);
+   }
+
+   for(Memory_Backend backend = 0; backend < MEMORY_BACKEND_COUNT; ++backend)
+   {
+      if(!memory_backend_is_supported(backend))
+      {
+         continue;
+      }
+
+      set_memory_backend(backend);
+
+      for(unsigned int alignment = 0; alignment < 32; ++alignment)
+      {
+         for(unsigned int size = 0; size <= 160; ++size)
+         {
+            unsigned char buffer[256];
+            unsigned char *destination = buffer + alignment + 8;
+
+            memory_set_scalar(buffer, sizeof(buffer), 0xEE);
+            memory_copy(destination, source + (31 - alignment), size);
+            ASSERT(bytes_are_equal_scalar(destination, source + (31 - alignment), size));
+            ASSERT(destination[-1] == 0xEE && destination[size] == 0xEE);
+
+            ASSERT(bytes_are_equal(destination, source + (31 - alignment), size));
+            ASSERT(bytes_are_equal_constant_time(destination, source + (31 - alignment), size));
+            if(size > 0)
+            {
+               unsigned int positions[] = {0, size / 2, size - 1};
+               for(unsigned int index = 0; index < ARRAY_LENGTH(positions); ++index)
+               {
+                  destination[positions[index]] ^= 0x10;
+                  ASSERT(!bytes_are_equal(destination, source + (31 - alignment), size));
+                  ASSERT(!bytes_are_equal_constant_time(destination, source + (31 - alignment), size));
+                  destination[positions[index]] ^= 0x10;
+               }
+            }
+
+            destination[size] = 0;
+            ASSERT(string_length((char *)destination) == size);
+
+            memory_set_scalar(buffer, sizeof(buffer), 0xEE);
+            memory_set(destination, size, 0x5A);
+            for(unsigned int index = 0; index < size; ++index)
+            {
+               ASSERT(destination[index] == 0x5A);
+            }
+            ASSERT(destination[-1] == 0xEE && destination[size] == 0xEE);
+         }
+      }
+
+      // NOTE(law): Copying down within the same buffer.
+      unsigned char buffer[256];
+      for(unsigned int shift = 1; shift < 40; ++shift)
+      {
+         memory_copy_scalar(buffer, source, sizeof(buffer));
+         memory_copy(buffer, buffer + shift, 200);
+         ASSERT(bytes_are_equal_scalar(buffer, source + shift, 200));
+      }
+   }
+
+   set_memory_backend(selected_backend);
+}
+
+static void
+test_platform_allocator(void)
+{
+   // NOTE(law): Every size maps to a class big enough to hold it, and memory is
+   // aligned and zeroed whether it's fresh, reused or given its own mapping.
+
+   Platform_Allocator_Statistics before;
+   platform_get_allocator_statistics(&before);
+
+   size_t previous_block_size = 0;
+   for(unsigned int index = 0; index < PLATFORM_SIZE_CLASS_COUNT; ++index)
+   {
+      size_t block_size = before.size_classes[index].block_size;
+      ASSERT(block_size > previous_block_size && (block_size % 16) == 0);
+      previous_block_size = block_size;
+   }
+   ASSERT(previous_block_size == PLATFORM_SIZE_CLASS_MAXIMUM);
+
+   size_t sizes[] = {0, 1, 16, 112, 113, 1000, 4080, 4081, 32752, 32753, 100000};
+   for(unsigned int round = 0; round < 2; ++round)
+   {
+      unsigned char *allocations[ARRAY_LENGTH(sizes)];
+      for(unsigned int index = 0; index < ARRAY_LENGTH(sizes); ++index)
+      {
+         size_t size = sizes[index];
+
+         unsigned char *memory = platform_allocate(size);
+         ASSERT(memory && ((uintptr_t)memory % 16) == 0);
+
+         for(size_t byte = 0; byte < size; ++byte)
+         {
+            ASSERT(memory[byte] == 0);
+         }
+         memory_set(memory, size, 0xAB);
+
+         allocations[index] = memory;
+      }
+
+      for(unsigned int index = 0; index < ARRAY_LENGTH(sizes); ++index)
+      {
+         platform_deallocate(allocations[index]);
+      }
+   }
+
+   Platform_Allocator_Statistics after;
+   platform_get_allocator_statistics(&after);
+
+   ASSERT(after.large_allocation_count == before.large_allocation_count + 4);
+   ASSERT(after.large_deallocation_count == before.large_deallocation_count + 4);
+   ASSERT(after.large_mapped_size == before.large_mapped_size);
+}
+#endif
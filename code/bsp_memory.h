@@ -11,12 +11,71 @@
 #define MEBIBYTES(v) (1024LL * KIBIBYTES(v))
 #define GIBIBYTES(v) (1024LL * MEBIBYTES(v))
 
+typedef enum
+{
+   MEMORY_BACKEND_SCALAR,
+   MEMORY_BACKEND_X86_SSE2,
+   MEMORY_BACKEND_X86_AVX2,
+   MEMORY_BACKEND_ARM_NEON,
+
+   MEMORY_BACKEND_COUNT,
+} Memory_Backend;
+
+// NOTE(law): An arena either wraps a fixed block of memory provided by the
+// caller (initialize_arena()), or reserves a large range of address space and
+// commits it in ARENA_COMMIT_SIZE steps as it fills up (reserve_arena()). A
+// growable arena only warns once it passes its soft limit, and only fails once
+// its whole reservation is used up.
+
+// NOTE(law): What the OS actually backed a region with, when huge pages were
+// asked for (see PLATFORM_MEMORY_HUGE_PAGES).
+typedef enum
+{
+   PAGE_BACKING_SMALL,
+   PAGE_BACKING_TRANSPARENT_HUGE,
+   PAGE_BACKING_HUGE,
+} Page_Backing;
+
+// NOTE(law): The flags used for large, long-lived regions (the arenas and the
+// database indexes), depending on the HUGE_PAGES build setting.
+#if HUGE_PAGES
+#  define HUGE_PAGE_FLAGS PLATFORM_MEMORY_HUGE_PAGES
+#else
+#  define HUGE_PAGE_FLAGS 0
+#endif
+
+#define ARENA_RESERVE_SIZE GIBIBYTES(64)
+#define ARENA_COMMIT_SIZE KIBIBYTES(64)
+
+// NOTE(law): trim_arena() keeps an estimate of how much of an arena is
+// actually needed, which follows any new peak immediately and otherwise decays
+// by 1/2^ARENA_TRIM_DECAY_SHIFT per trim. Committed memory beyond the estimate
+// is only returned to the OS once there's more than ARENA_TRIM_SLACK of it, so
+// that small fluctuations don't cost a system call every time.
+#define ARENA_TRIM_DECAY_SHIFT 3
+#define ARENA_TRIM_SLACK MEBIBYTES(1)
+
 typedef struct
 {
    unsigned char *base_address;
-   size_t size;
+   size_t size; // Bytes usable without committing more, i.e. committed so far.
    size_t used;
+   size_t high_water_mark; // The most used since the last trim.
+   size_t working_set;
+
+   size_t reserve_size;
+   size_t soft_limit;
+   bool soft_limit_reported;
+
+   unsigned int temporary_count;
+   Page_Backing page_backing;
 } Memory_Arena;
 
+typedef struct
+{
+   Memory_Arena *arena;
+   size_t used;
+} Temporary_Memory;
+
 #define BSP_MEMORY_H
 #endif
@@ -2,6 +2,26 @@
 /* (c) copyright 2022 Lawrence D. Kern /////////////////////////////////////// */
 /* /////////////////////////////////////////////////////////////////////////// */
 
+static uint32_t sha256_round_constants[64] =
+{
+   0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+   0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+   0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+   0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+   0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+   0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+   0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+   0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+   0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+   0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+   0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+   0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+   0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+   0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+   0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+   0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
 static uint32_t
 rotate_right_32(uint32_t value, uint32_t shift)
 {
@@ -17,127 +37,789 @@ rotate_right_32(uint32_t value, uint32_t shift)
    return result;
 }
 
+static void
+consume_sha256_chunks_scalar(SHA256_State *state, uint8_t *chunks, size_t chunk_count)
+{
+   uint32_t *k = sha256_round_constants;
+
+   for(size_t chunk_index = 0; chunk_index < chunk_count; ++chunk_index)
+   {
+      uint8_t *chunk = chunks + (64 * chunk_index);
+      uint32_t w[64] = {0};
+
+      for(unsigned int index = 0; index < 16; ++index)
+      {
+         w[index] = ((uint32_t)chunk[(sizeof(uint32_t) * index) + 0] << 24 |
+                     (uint32_t)chunk[(sizeof(uint32_t) * index) + 1] << 16 |
+                     (uint32_t)chunk[(sizeof(uint32_t) * index) + 2] << 8  |
+                     (uint32_t)chunk[(sizeof(uint32_t) * index) + 3] << 0);
+      }
+
+      for(unsigned int index = 16; index < 64; ++index)
+      {
+         uint32_t s0 = (rotate_right_32(w[index - 15], 7)  ^
+                        rotate_right_32(w[index - 15], 18) ^
+                        (w[index - 15] >> 3));
+
+         uint32_t s1 = (rotate_right_32(w[index - 2], 17) ^
+                        rotate_right_32(w[index - 2], 19) ^
+                        (w[index - 2] >> 10));
+
+         w[index] = w[index - 16] + s0 + w[index - 7] + s1;
+      }
+
+      uint32_t a = state->h[0];
+      uint32_t b = state->h[1];
+      uint32_t c = state->h[2];
+      uint32_t d = state->h[3];
+      uint32_t e = state->h[4];
+      uint32_t f = state->h[5];
+      uint32_t g = state->h[6];
+      uint32_t h = state->h[7];
+
+      for(unsigned int index = 0; index < 64; ++index)
+      {
+         uint32_t S1 = (rotate_right_32(e, 6)  ^
+                        rotate_right_32(e, 11) ^
+                        rotate_right_32(e, 25));
+
+         uint32_t ch = (e & f) ^ ((~e) & g);
+         uint32_t temp1 = h + S1 + ch + k[index] + w[index];
+
+         uint32_t S0 = (rotate_right_32(a, 2)  ^
+                        rotate_right_32(a, 13) ^
+                        rotate_right_32(a, 22));
+
+         uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+         uint32_t temp2 = S0 + maj;
+
+         h = g;
+         g = f;
+         f = e;
+         e = d + temp1;
+         d = c;
+         c = b;
+         b = a;
+         a = temp1 + temp2;
+      }
+
+      state->h[0] += a;
+      state->h[1] += b;
+      state->h[2] += c;
+      state->h[3] += d;
+      state->h[4] += e;
+      state->h[5] += f;
+      state->h[6] += g;
+      state->h[7] += h;
+   }
+}
+
+#if defined(PLATFORM_X64)
+PLATFORM_TARGET("sha,ssse3,sse4.1")
+static void
+consume_sha256_chunks_x86_sha(SHA256_State *state, uint8_t *chunks, size_t chunk_count)
+{
+   // NOTE(law): The sha256rnds2 instruction expects the working variables split
+   // across two registers as ABEF and CDGH (most significant lane first), so
+   // the state is shuffled into that arrangement on the way in and back out.
+
+   __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+   __m128i temp = _mm_loadu_si128((__m128i *)(state->h + 0));       // ABCD
+   __m128i state1 = _mm_loadu_si128((__m128i *)(state->h + 4));     // EFGH
+
+   temp = _mm_shuffle_epi32(temp, 0xB1);                            // CDAB
+   state1 = _mm_shuffle_epi32(state1, 0x1B);                        // EFGH
+   __m128i state0 = _mm_alignr_epi8(temp, state1, 8);               // ABEF
+   state1 = _mm_blend_epi16(state1, temp, 0xF0);                    // CDGH
+
+   for(size_t chunk_index = 0; chunk_index < chunk_count; ++chunk_index)
+   {
+      uint8_t *chunk = chunks + (64 * chunk_index);
+
+      __m128i saved_state0 = state0;
+      __m128i saved_state1 = state1;
+
+      // NOTE(law): Each group of four rounds consumes four message schedule
+      // words. The schedule only ever looks back 16 words, so it fits in a
+      // rotating window of four registers.
+      __m128i w[4];
+
+      for(unsigned int group = 0; group < 16; ++group)
+      {
+         __m128i words;
+         if(group < 4)
+         {
+            words = _mm_loadu_si128((__m128i *)(chunk + (16 * group)));
+            words = _mm_shuffle_epi8(words, byte_swap);
+         }
+         else
+         {
+            __m128i w16 = w[(group - 4) & 3];
+            __m128i w12 = w[(group - 3) & 3];
+            __m128i w8  = w[(group - 2) & 3];
+            __m128i w4  = w[(group - 1) & 3];
+
+            words = _mm_sha256msg1_epu32(w16, w12);
+            words = _mm_add_epi32(words, _mm_alignr_epi8(w4, w8, 4));
+            words = _mm_sha256msg2_epu32(words, w4);
+         }
+         w[group & 3] = words;
+
+         __m128i k = _mm_loadu_si128((__m128i *)(sha256_round_constants + (4 * group)));
+         __m128i message = _mm_add_epi32(words, k);
+
+         state1 = _mm_sha256rnds2_epu32(state1, state0, message);
+         message = _mm_shuffle_epi32(message, 0x0E);
+         state0 = _mm_sha256rnds2_epu32(state0, state1, message);
+      }
+
+      state0 = _mm_add_epi32(state0, saved_state0);
+      state1 = _mm_add_epi32(state1, saved_state1);
+   }
+
+   temp = _mm_shuffle_epi32(state0, 0x1B);                          // FEBA
+   state1 = _mm_shuffle_epi32(state1, 0xB1);                        // DCHG
+   state0 = _mm_blend_epi16(temp, state1, 0xF0);                    // DCBA
+   state1 = _mm_alignr_epi8(state1, temp, 8);                       // HGFE
+
+   _mm_storeu_si128((__m128i *)(state->h + 0), state0);
+   _mm_storeu_si128((__m128i *)(state->h + 4), state1);
+}
+#endif
+
+#if defined(PLATFORM_ARM64)
+PLATFORM_TARGET("+crypto")
+static void
+consume_sha256_chunks_arm_sha2(SHA256_State *state, uint8_t *chunks, size_t chunk_count)
+{
+   uint32x4_t state0 = vld1q_u32(state->h + 0); // ABCD
+   uint32x4_t state1 = vld1q_u32(state->h + 4); // EFGH
+
+   for(size_t chunk_index = 0; chunk_index < chunk_count; ++chunk_index)
+   {
+      uint8_t *chunk = chunks + (64 * chunk_index);
+
+      uint32x4_t saved_state0 = state0;
+      uint32x4_t saved_state1 = state1;
+
+      uint32x4_t w[4];
+      for(unsigned int index = 0; index < 4; ++index)
+      {
+         w[index] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(chunk + (16 * index))));
+      }
+
+      for(unsigned int group = 0; group < 16; ++group)
+      {
+         uint32x4_t k = vld1q_u32(sha256_round_constants + (4 * group));
+         uint32x4_t message = vaddq_u32(w[group & 3], k);
+
+         if(group < 12)
+         {
+            // NOTE(law): Extend the schedule by four words, overwriting the
+            // oldest entry in the window once it has been consumed above.
+            uint32x4_t words = vsha256su0q_u32(w[group & 3], w[(group + 1) & 3]);
+            w[group & 3] = vsha256su1q_u32(words, w[(group + 2) & 3], w[(group + 3) & 3]);
+         }
+
+         uint32x4_t previous_state0 = state0;
+         state0 = vsha256hq_u32(state0, state1, message);
+         state1 = vsha256h2q_u32(state1, previous_state0, message);
+      }
+
+      state0 = vaddq_u32(state0, saved_state0);
+      state1 = vaddq_u32(state1, saved_state1);
+   }
+
+   vst1q_u32(state->h + 0, state0);
+   vst1q_u32(state->h + 4, state1);
+}
+#endif
+
+typedef void SHA256_Consume_Chunks(SHA256_State *state, uint8_t *chunks, size_t chunk_count);
+
+static SHA256_Backend global_sha256_backend = SHA256_BACKEND_SCALAR;
+static SHA256_Consume_Chunks *global_sha256_consume_chunks = consume_sha256_chunks_scalar;
+
+static bool
+sha256_backend_is_supported(SHA256_Backend backend)
+{
+   Platform_Cpu_Features features = platform_query_cpu_features();
+
+   bool result = false;
+   switch(backend)
+   {
+      case SHA256_BACKEND_SCALAR:   {result = true;} break;
+#if defined(PLATFORM_X64)
+      case SHA256_BACKEND_X86_SHA:  {result = features.x86_sha;} break;
+#endif
+#if defined(PLATFORM_ARM64)
+      case SHA256_BACKEND_ARM_SHA2: {result = features.arm_sha2;} break;
+#endif
+      default: {result = false;} break;
+   }
+
+   return result;
+}
+
+static char *
+sha256_backend_name(SHA256_Backend backend)
+{
+   char *result = "unknown";
+   switch(backend)
+   {
+      case SHA256_BACKEND_SCALAR:   {result = "scalar";} break;
+      case SHA256_BACKEND_X86_SHA:  {result = "x86 SHA extensions";} break;
+      case SHA256_BACKEND_ARM_SHA2: {result = "ARMv8 SHA2";} break;
+      default: break;
+   }
+
+   return result;
+}
+
+static void
+set_sha256_backend(SHA256_Backend backend)
+{
+   ASSERT(sha256_backend_is_supported(backend));
+
+   global_sha256_backend = backend;
+   switch(backend)
+   {
+#if defined(PLATFORM_X64)
+      case SHA256_BACKEND_X86_SHA:  {global_sha256_consume_chunks = consume_sha256_chunks_x86_sha;} break;
+#endif
+#if defined(PLATFORM_ARM64)
+      case SHA256_BACKEND_ARM_SHA2: {global_sha256_consume_chunks = consume_sha256_chunks_arm_sha2;} break;
+#endif
+      default: {global_sha256_consume_chunks = consume_sha256_chunks_scalar;} break;
+   }
+}
+
+static void
+consume_sha256_chunks(SHA256_State *state, uint8_t *chunks, size_t chunk_count)
+{
+   global_sha256_consume_chunks(state, chunks, chunk_count);
+}
+
 static void
 consume_sha256_chunk(SHA256_State *state, uint8_t *chunk)
 {
-   uint32_t w[64] = {0};
+   global_sha256_consume_chunks(state, chunk, 1);
+}
 
+#if defined(PLATFORM_X64)
+PLATFORM_TARGET("avx2")
+static void
+sha256_transpose_8x8_avx2(__m256i *rows)
+{
+   // NOTE(law): Transpose an 8x8 matrix of 32-bit words, turning eight rows of
+   // per-message words into eight vectors holding one word from each message.
+   // The transpose is its own inverse, so it also converts back.
+
+   __m256i t0 = _mm256_unpacklo_epi32(rows[0], rows[1]);
+   __m256i t1 = _mm256_unpackhi_epi32(rows[0], rows[1]);
+   __m256i t2 = _mm256_unpacklo_epi32(rows[2], rows[3]);
+   __m256i t3 = _mm256_unpackhi_epi32(rows[2], rows[3]);
+   __m256i t4 = _mm256_unpacklo_epi32(rows[4], rows[5]);
+   __m256i t5 = _mm256_unpackhi_epi32(rows[4], rows[5]);
+   __m256i t6 = _mm256_unpacklo_epi32(rows[6], rows[7]);
+   __m256i t7 = _mm256_unpackhi_epi32(rows[6], rows[7]);
+
+   __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+   __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+   __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+   __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+   __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+   __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+   __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+   __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+   rows[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+   rows[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+   rows[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+   rows[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+   rows[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+   rows[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+   rows[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+   rows[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+PLATFORM_TARGET("avx2")
+static void
+sha256_load_message_words_avx2(__m256i *w, uint8_t **chunks)
+{
+   // NOTE(law): Load the 16 big-endian message words of eight chunks into w,
+   // with lane i of w[t] holding word t of chunks[i].
+
+   __m256i byte_swap = _mm256_set_epi8(12, 13, 14, 15,  8,  9, 10, 11,
+                                       4,  5,  6,  7,  0,  1,  2,  3,
+                                       12, 13, 14, 15,  8,  9, 10, 11,
+                                       4,  5,  6,  7,  0,  1,  2,  3);
+
+   for(unsigned int half = 0; half < 2; ++half)
+   {
+      __m256i *rows = w + (8 * half);
+      for(unsigned int lane = 0; lane < 8; ++lane)
+      {
+         rows[lane] = _mm256_loadu_si256((__m256i *)(chunks[lane] + (32 * half)));
+      }
+
+      sha256_transpose_8x8_avx2(rows);
+
+      for(unsigned int index = 0; index < 8; ++index)
+      {
+         rows[index] = _mm256_shuffle_epi8(rows[index], byte_swap);
+      }
+   }
+}
+
+PLATFORM_TARGET("avx2")
+static __m256i
+sha256_rotate_right_avx2(__m256i value, int shift)
+{
+   __m256i result = _mm256_or_si256(_mm256_srli_epi32(value, shift),
+                                    _mm256_slli_epi32(value, 32 - shift));
+   return result;
+}
+
+PLATFORM_TARGET("avx2")
+static void
+consume_sha256_chunk_lanes_avx2(SHA256_State *states, uint8_t **chunks)
+{
+   // NOTE(law): This is the scalar round function from
+   // consume_sha256_chunks_scalar(), run on eight independent messages at once.
+
+   __m256i s[8];
+   for(unsigned int lane = 0; lane < 8; ++lane)
+   {
+      s[lane] = _mm256_loadu_si256((__m256i *)states[lane].h);
+   }
+   sha256_transpose_8x8_avx2(s);
+
+   __m256i w[16];
+   sha256_load_message_words_avx2(w, chunks);
+
+   __m256i a = s[0];
+   __m256i b = s[1];
+   __m256i c = s[2];
+   __m256i d = s[3];
+   __m256i e = s[4];
+   __m256i f = s[5];
+   __m256i g = s[6];
+   __m256i h = s[7];
+
+   for(unsigned int index = 0; index < 64; ++index)
+   {
+      if(index >= 16)
+      {
+         // NOTE(law): The schedule is kept as a rolling window of 16 words,
+         // where w[index & 15] currently holds w[index - 16].
+         __m256i w15 = w[(index + 1) & 15];
+         __m256i w7  = w[(index + 9) & 15];
+         __m256i w2  = w[(index + 14) & 15];
+
+         __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(sha256_rotate_right_avx2(w15, 7),
+                                                        sha256_rotate_right_avx2(w15, 18)),
+                                       _mm256_srli_epi32(w15, 3));
+
+         __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(sha256_rotate_right_avx2(w2, 17),
+                                                        sha256_rotate_right_avx2(w2, 19)),
+                                       _mm256_srli_epi32(w2, 10));
+
+         w[index & 15] = _mm256_add_epi32(_mm256_add_epi32(w[index & 15], s0),
+                                          _mm256_add_epi32(w7, s1));
+      }
+
+      __m256i S1 = _mm256_xor_si256(_mm256_xor_si256(sha256_rotate_right_avx2(e, 6),
+                                                     sha256_rotate_right_avx2(e, 11)),
+                                    sha256_rotate_right_avx2(e, 25));
+
+      __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+
+      __m256i k = _mm256_set1_epi32((int)sha256_round_constants[index]);
+      __m256i temp1 = _mm256_add_epi32(_mm256_add_epi32(h, S1),
+                                       _mm256_add_epi32(_mm256_add_epi32(ch, k), w[index & 15]));
+
+      __m256i S0 = _mm256_xor_si256(_mm256_xor_si256(sha256_rotate_right_avx2(a, 2),
+                                                     sha256_rotate_right_avx2(a, 13)),
+                                    sha256_rotate_right_avx2(a, 22));
+
+      __m256i maj = _mm256_xor_si256(_mm256_xor_si256(_mm256_and_si256(a, b), _mm256_and_si256(a, c)),
+                                     _mm256_and_si256(b, c));
+
+      __m256i temp2 = _mm256_add_epi32(S0, maj);
+
+      h = g;
+      g = f;
+      f = e;
+      e = _mm256_add_epi32(d, temp1);
+      d = c;
+      c = b;
+      b = a;
+      a = _mm256_add_epi32(temp1, temp2);
+   }
+
+   s[0] = _mm256_add_epi32(s[0], a);
+   s[1] = _mm256_add_epi32(s[1], b);
+   s[2] = _mm256_add_epi32(s[2], c);
+   s[3] = _mm256_add_epi32(s[3], d);
+   s[4] = _mm256_add_epi32(s[4], e);
+   s[5] = _mm256_add_epi32(s[5], f);
+   s[6] = _mm256_add_epi32(s[6], g);
+   s[7] = _mm256_add_epi32(s[7], h);
+
+   sha256_transpose_8x8_avx2(s);
+   for(unsigned int lane = 0; lane < 8; ++lane)
+   {
+      _mm256_storeu_si256((__m256i *)states[lane].h, s[lane]);
+   }
+}
+
+PLATFORM_TARGET("avx2,avx512f")
+static void
+consume_sha256_chunk_lanes_avx512(SHA256_State *states, uint8_t **chunks)
+{
+   // NOTE(law): The sixteen lanes are loaded as two groups of eight using the
+   // AVX2 transpose, then joined into 512-bit vectors. AVX-512 adds a native
+   // rotate and three-input logic ops, which covers most of the round function.
+
+   __m256i low_state[8];
+   __m256i high_state[8];
+   for(unsigned int lane = 0; lane < 8; ++lane)
+   {
+      low_state[lane] = _mm256_loadu_si256((__m256i *)states[lane].h);
+      high_state[lane] = _mm256_loadu_si256((__m256i *)states[lane + 8].h);
+   }
+   sha256_transpose_8x8_avx2(low_state);
+   sha256_transpose_8x8_avx2(high_state);
+
+   __m256i low_words[16];
+   __m256i high_words[16];
+   sha256_load_message_words_avx2(low_words, chunks);
+   sha256_load_message_words_avx2(high_words, chunks + 8);
+
+   __m512i s[8];
+   for(unsigned int index = 0; index < 8; ++index)
+   {
+      s[index] = _mm512_inserti64x4(_mm512_castsi256_si512(low_state[index]), high_state[index], 1);
+   }
+
+   __m512i w[16];
    for(unsigned int index = 0; index < 16; ++index)
    {
-      w[index] = ((uint32_t)chunk[(sizeof(uint32_t) * index) + 0] << 24 |
-                  (uint32_t)chunk[(sizeof(uint32_t) * index) + 1] << 16 |
-                  (uint32_t)chunk[(sizeof(uint32_t) * index) + 2] << 8  |
-                  (uint32_t)chunk[(sizeof(uint32_t) * index) + 3] << 0);
-   }
-
-   for(unsigned int index = 16; index < 64; ++index)
-   {
-      uint32_t s0 = (rotate_right_32(w[index - 15], 7)  ^
-                     rotate_right_32(w[index - 15], 18) ^
-                     (w[index - 15] >> 3));
-
-      uint32_t s1 = (rotate_right_32(w[index - 2], 17) ^
-                     rotate_right_32(w[index - 2], 19) ^
-                     (w[index - 2] >> 10));
-
-      w[index] = w[index - 16] + s0 + w[index - 7] + s1;
-   }
-
-   uint32_t a = state->h[0];
-   uint32_t b = state->h[1];
-   uint32_t c = state->h[2];
-   uint32_t d = state->h[3];
-   uint32_t e = state->h[4];
-   uint32_t f = state->h[5];
-   uint32_t g = state->h[6];
-   uint32_t h = state->h[7];
-
-   uint32_t k[] =
-   {
-      0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
-      0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
-      0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
-      0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
-      0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
-      0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
-      0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
-      0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
-      0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
-      0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
-      0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
-      0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
-      0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
-      0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
-      0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
-      0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
-   };
+      w[index] = _mm512_inserti64x4(_mm512_castsi256_si512(low_words[index]), high_words[index], 1);
+   }
+
+   __m512i a = s[0];
+   __m512i b = s[1];
+   __m512i c = s[2];
+   __m512i d = s[3];
+   __m512i e = s[4];
+   __m512i f = s[5];
+   __m512i g = s[6];
+   __m512i h = s[7];
 
    for(unsigned int index = 0; index < 64; ++index)
    {
-      uint32_t S1 = (rotate_right_32(e, 6)  ^
-                     rotate_right_32(e, 11) ^
-                     rotate_right_32(e, 25));
+      if(index >= 16)
+      {
+         __m512i w15 = w[(index + 1) & 15];
+         __m512i w7  = w[(index + 9) & 15];
+         __m512i w2  = w[(index + 14) & 15];
+
+         __m512i s0 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(w15, 7),
+                                                _mm512_ror_epi32(w15, 18),
+                                                _mm512_srli_epi32(w15, 3), 0x96); // xor
+
+         __m512i s1 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(w2, 17),
+                                                _mm512_ror_epi32(w2, 19),
+                                                _mm512_srli_epi32(w2, 10), 0x96); // xor
+
+         w[index & 15] = _mm512_add_epi32(_mm512_add_epi32(w[index & 15], s0),
+                                          _mm512_add_epi32(w7, s1));
+      }
+
+      __m512i S1 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(e, 6),
+                                             _mm512_ror_epi32(e, 11),
+                                             _mm512_ror_epi32(e, 25), 0x96); // xor
+
+      __m512i ch = _mm512_ternarylogic_epi32(e, f, g, 0xca); // e ? f : g
 
-      uint32_t ch = (e & f) ^ ((~e) & g);
-      uint32_t temp1 = h + S1 + ch + k[index] + w[index];
+      __m512i k = _mm512_set1_epi32((int)sha256_round_constants[index]);
+      __m512i temp1 = _mm512_add_epi32(_mm512_add_epi32(h, S1),
+                                       _mm512_add_epi32(_mm512_add_epi32(ch, k), w[index & 15]));
 
-      uint32_t S0 = (rotate_right_32(a, 2)  ^
-                     rotate_right_32(a, 13) ^
-                     rotate_right_32(a, 22));
+      __m512i S0 = _mm512_ternarylogic_epi32(_mm512_ror_epi32(a, 2),
+                                             _mm512_ror_epi32(a, 13),
+                                             _mm512_ror_epi32(a, 22), 0x96); // xor
 
-      uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
-      uint32_t temp2 = S0 + maj;
+      __m512i maj = _mm512_ternarylogic_epi32(a, b, c, 0xe8); // majority
+
+      __m512i temp2 = _mm512_add_epi32(S0, maj);
 
       h = g;
       g = f;
       f = e;
-      e = d + temp1;
+      e = _mm512_add_epi32(d, temp1);
       d = c;
       c = b;
       b = a;
-      a = temp1 + temp2;
+      a = _mm512_add_epi32(temp1, temp2);
+   }
+
+   s[0] = _mm512_add_epi32(s[0], a);
+   s[1] = _mm512_add_epi32(s[1], b);
+   s[2] = _mm512_add_epi32(s[2], c);
+   s[3] = _mm512_add_epi32(s[3], d);
+   s[4] = _mm512_add_epi32(s[4], e);
+   s[5] = _mm512_add_epi32(s[5], f);
+   s[6] = _mm512_add_epi32(s[6], g);
+   s[7] = _mm512_add_epi32(s[7], h);
+
+   for(unsigned int index = 0; index < 8; ++index)
+   {
+      low_state[index] = _mm512_castsi512_si256(s[index]);
+      high_state[index] = _mm512_extracti64x4_epi64(s[index], 1);
    }
+   sha256_transpose_8x8_avx2(low_state);
+   sha256_transpose_8x8_avx2(high_state);
 
-   state->h[0] += a;
-   state->h[1] += b;
-   state->h[2] += c;
-   state->h[3] += d;
-   state->h[4] += e;
-   state->h[5] += f;
-   state->h[6] += g;
-   state->h[7] += h;
+   for(unsigned int lane = 0; lane < 8; ++lane)
+   {
+      _mm256_storeu_si256((__m256i *)states[lane].h, low_state[lane]);
+      _mm256_storeu_si256((__m256i *)states[lane + 8].h, high_state[lane]);
+   }
 }
+#endif
 
-static SHA256
-hash_sha256(unsigned char *message, size_t message_size)
+typedef void SHA256_Consume_Chunk_Lanes(SHA256_State *states, uint8_t **chunks);
+
+static SHA256_Lane_Backend global_sha256_lane_backend = SHA256_LANE_BACKEND_SERIAL;
+static SHA256_Consume_Chunk_Lanes *global_sha256_consume_chunk_lanes = 0;
+static unsigned int global_sha256_lane_width = 1;
+
+static bool
+sha256_lane_backend_is_supported(SHA256_Lane_Backend backend)
 {
-   // This implementation is based on the pseudo-code provided on the SHA-2
-   // wikipedia page: https://en.wikipedia.org/wiki/SHA-2
+   Platform_Cpu_Features features = platform_query_cpu_features();
 
-   SHA256 result = {0};
+   bool result = false;
+   switch(backend)
+   {
+      case SHA256_LANE_BACKEND_SERIAL: {result = true;} break;
+#if defined(PLATFORM_X64)
+      case SHA256_LANE_BACKEND_AVX2:   {result = features.x86_avx2;} break;
+      case SHA256_LANE_BACKEND_AVX512: {result = features.x86_avx512f;} break;
+#endif
+      default: {result = false;} break;
+   }
 
-   SHA256_State state = {0};
-   state.h[0] = 0x6a09e667;
-   state.h[1] = 0xbb67ae85;
-   state.h[2] = 0x3c6ef372;
-   state.h[3] = 0xa54ff53a;
-   state.h[4] = 0x510e527f;
-   state.h[5] = 0x9b05688c;
-   state.h[6] = 0x1f83d9ab;
-   state.h[7] = 0x5be0cd19;
+   return result;
+}
 
-   uint64_t input_bit_count = message_size * 8;
-   uint64_t remaining_filled_bits = input_bit_count;
-   while(remaining_filled_bits >= 512)
+static char *
+sha256_lane_backend_name(SHA256_Lane_Backend backend)
+{
+   char *result = "unknown";
+   switch(backend)
    {
-      // Each of these iterations consumes a chunk that contains a full 512 bits
-      // of message data.
-      consume_sha256_chunk(&state, (uint8_t *)message);
+      case SHA256_LANE_BACKEND_SERIAL: {result = "serial";} break;
+      case SHA256_LANE_BACKEND_AVX2:   {result = "AVX2 (8 lanes)";} break;
+      case SHA256_LANE_BACKEND_AVX512: {result = "AVX-512 (16 lanes)";} break;
+      default: break;
+   }
+
+   return result;
+}
 
-      remaining_filled_bits -= 512;
-      message += 64;
+static void
+set_sha256_lane_backend(SHA256_Lane_Backend backend)
+{
+   ASSERT(sha256_lane_backend_is_supported(backend));
+
+   global_sha256_lane_backend = backend;
+   switch(backend)
+   {
+#if defined(PLATFORM_X64)
+      case SHA256_LANE_BACKEND_AVX2:
+      {
+         global_sha256_consume_chunk_lanes = consume_sha256_chunk_lanes_avx2;
+         global_sha256_lane_width = 8;
+      } break;
+
+      case SHA256_LANE_BACKEND_AVX512:
+      {
+         global_sha256_consume_chunk_lanes = consume_sha256_chunk_lanes_avx512;
+         global_sha256_lane_width = 16;
+      } break;
+#endif
+
+      default:
+      {
+         global_sha256_consume_chunk_lanes = 0;
+         global_sha256_lane_width = 1;
+      } break;
+   }
+}
+
+static void
+consume_sha256_chunk_lanes(SHA256_State *states, uint8_t **chunks, unsigned int lane_count)
+{
+   // NOTE(law): Consume one chunk for each of lane_count independent states.
+   // Full groups go through the vector backend directly. A partial group is
+   // padded out to the vector width by repeating its first lane, and the
+   // padding results are thrown away.
+
+   ASSERT(lane_count <= SHA256_MAX_LANE_COUNT);
+
+   unsigned int width = global_sha256_lane_width;
+   if(width > 1)
+   {
+      while(lane_count >= width)
+      {
+         global_sha256_consume_chunk_lanes(states, chunks);
+
+         states += width;
+         chunks += width;
+         lane_count -= width;
+      }
+
+      if(lane_count > 1)
+      {
+         SHA256_State padded_states[SHA256_MAX_LANE_COUNT];
+         uint8_t *padded_chunks[SHA256_MAX_LANE_COUNT];
+
+         for(unsigned int lane = 0; lane < width; ++lane)
+         {
+            unsigned int source_lane = (lane < lane_count) ? lane : 0;
+            padded_states[lane] = states[source_lane];
+            padded_chunks[lane] = chunks[source_lane];
+         }
+
+         global_sha256_consume_chunk_lanes(padded_states, padded_chunks);
+
+         for(unsigned int lane = 0; lane < lane_count; ++lane)
+         {
+            states[lane] = padded_states[lane];
+         }
+
+         lane_count = 0;
+      }
+   }
+
+   for(unsigned int lane = 0; lane < lane_count; ++lane)
+   {
+      consume_sha256_chunk(states + lane, chunks[lane]);
+   }
+}
+
+static void
+initialize_sha256_backend(void)
+{
+   // NOTE(law): This is called once at startup, before any request threads are
+   // launched, so the backends never change while hashing is in progress.
+
+   SHA256_Backend backend = SHA256_BACKEND_SCALAR;
+   if(sha256_backend_is_supported(SHA256_BACKEND_X86_SHA))
+   {
+      backend = SHA256_BACKEND_X86_SHA;
+   }
+   else if(sha256_backend_is_supported(SHA256_BACKEND_ARM_SHA2))
+   {
+      backend = SHA256_BACKEND_ARM_SHA2;
    }
 
+   set_sha256_backend(backend);
+   platform_log_message("SHA256 compression backend: %s.", sha256_backend_name(backend));
+
+   SHA256_Lane_Backend lane_backend = SHA256_LANE_BACKEND_SERIAL;
+   if(sha256_lane_backend_is_supported(SHA256_LANE_BACKEND_AVX512))
+   {
+      lane_backend = SHA256_LANE_BACKEND_AVX512;
+   }
+   else if(sha256_lane_backend_is_supported(SHA256_LANE_BACKEND_AVX2))
+   {
+      lane_backend = SHA256_LANE_BACKEND_AVX2;
+   }
+
+   set_sha256_lane_backend(lane_backend);
+   platform_log_message("SHA256 lane backend: %s.", sha256_lane_backend_name(lane_backend));
+}
+
+static void
+initialize_sha256_state(SHA256_State *state)
+{
+   state->h[0] = 0x6a09e667;
+   state->h[1] = 0xbb67ae85;
+   state->h[2] = 0x3c6ef372;
+   state->h[3] = 0xa54ff53a;
+   state->h[4] = 0x510e527f;
+   state->h[5] = 0x9b05688c;
+   state->h[6] = 0x1f83d9ab;
+   state->h[7] = 0x5be0cd19;
+}
+
+static void
+sha256_state_to_bytes(unsigned char *bytes, SHA256_State *state)
+{
+   // Fill out a 32 byte array with the state words in Big Endian order.
+   for(unsigned int index = 0; index < 8; ++index)
+   {
+      bytes[(4 * index) + 0] = (uint8_t)(state->h[index] >> 24);
+      bytes[(4 * index) + 1] = (uint8_t)(state->h[index] >> 16);
+      bytes[(4 * index) + 2] = (uint8_t)(state->h[index] >>  8);
+      bytes[(4 * index) + 3] = (uint8_t)(state->h[index] >>  0);
+   }
+}
+
+static SHA256
+sha256_state_to_hash(SHA256_State *state)
+{
+   SHA256 result;
+   sha256_state_to_bytes(result.bytes, state);
+
+   return result;
+}
+
+static void
+format_sha256_text(char *destination, SHA256 *hash)
+{
+   // NOTE(law): Format the digest as a 65 byte string (including null
+   // terminator), using lowercase hexadecimal characters.
+   bytes_to_hexadecimal_string(destination, hash->bytes, sizeof(hash->bytes));
+}
+
+static bool
+sha256_text_is_equal(SHA256 *hash, char *text)
+{
+   char hash_text[SHA256_TEXT_LENGTH + 1];
+   format_sha256_text(hash_text, hash);
+
+   bool result = strings_are_equal(hash_text, text);
+   return result;
+}
+
+static void
+finalize_sha256(SHA256_State *state, unsigned char *message, size_t message_size, uint64_t prefix_size)
+{
+   // NOTE(law): Consume the rest of a message, including the final padding.
+   // The state may already have consumed prefix_size bytes of the message
+   // (which must be a multiple of the 64 byte chunk size), as is the case when
+   // resuming from a precomputed HMAC midstate.
+
+   ASSERT((prefix_size % 64) == 0);
+
+   uint64_t input_bit_count = (prefix_size + message_size) * 8;
+   uint64_t remaining_filled_bits = message_size * 8;
+
+   // Consume every chunk that contains a full 512 bits of message data in a
+   // single call, so accelerated backends can keep the state in registers.
+   size_t full_chunk_count = message_size / 64;
+   consume_sha256_chunks(state, (uint8_t *)message, full_chunk_count);
+
+   remaining_filled_bits -= 512 * (uint64_t)full_chunk_count;
+   message += 64 * full_chunk_count;
+
    // Assemble and consume final partially-filled chunk(s).
    uint8_t chunk[64] = {0};
    uint64_t byte_index_for_one_bit = message_size % 64;
@@ -149,88 +831,242 @@ hash_sha256(unsigned char *message, size_t message_size)
       // unused bit in the penultimate chunk and pad the remaining space
       // (including the final chunk) with 0's.
 
-      // Assemble the penultimate chunk into a local buffer.
-      memory_copy(chunk, message, byte_index_for_one_bit);
-      chunk[byte_index_for_one_bit] = 0x80; // 0x80 == 0b10000000
-      for(uint64_t index = byte_index_for_one_bit + 1; index < 64; ++index)
+      // Assemble the penultimate chunk into a local buffer.
+      memory_copy(chunk, message, byte_index_for_one_bit);
+      chunk[byte_index_for_one_bit] = 0x80; // 0x80 == 0b10000000
+      for(uint64_t index = byte_index_for_one_bit + 1; index < 64; ++index)
+      {
+         chunk[index] = 0;
+      }
+
+      // Consume the penultimate chunk.
+      consume_sha256_chunk(state, chunk);
+
+      // Clear the local buffer to zero to process the final chunk.
+      zero_memory(chunk, 64);
+   }
+   else
+   {
+      // If there was at least 65 bits of unused space in the first
+      // partially-filled chunk, then that chunk is the final chunk. Add the 1
+      // bit to the first unused bit in the final chunk and pad the remaining
+      // space with 0's.
+
+      // Assemble the final chunk into a local buffer.
+      memory_copy(chunk, message, byte_index_for_one_bit);
+      chunk[byte_index_for_one_bit] = 0x80; // 0x80 == 0b10000000
+      for(uint64_t index = (byte_index_for_one_bit + 1); index < 64; ++index)
+      {
+         chunk[index] = 0;
+      }
+   }
+
+   // Store the 64 bit value for the initial input size in bits at the end of
+   // the final chunk in Big Endian order.
+   chunk[56] = (uint8_t)(input_bit_count >> 56);
+   chunk[57] = (uint8_t)(input_bit_count >> 48);
+   chunk[58] = (uint8_t)(input_bit_count >> 40);
+   chunk[59] = (uint8_t)(input_bit_count >> 32);
+   chunk[60] = (uint8_t)(input_bit_count >> 24);
+   chunk[61] = (uint8_t)(input_bit_count >> 16);
+   chunk[62] = (uint8_t)(input_bit_count >> 8);
+   chunk[63] = (uint8_t)(input_bit_count >> 0);
+
+   // Consume the final chunk.
+   consume_sha256_chunk(state, chunk);
+}
+
+static void
+sha256_begin_from_state(SHA256_Context *context, SHA256_State *state, uint64_t prefix_size)
+{
+   // NOTE(law): Resume hashing from a state that has already consumed
+   // prefix_size bytes (e.g. an HMAC padded key midstate).
+
+   ASSERT((prefix_size % 64) == 0);
+
+   context->state = *state;
+   context->buffer_size = 0;
+   context->message_size = prefix_size;
+}
+
+static void
+sha256_begin(SHA256_Context *context)
+{
+   SHA256_State state;
+   initialize_sha256_state(&state);
+
+   sha256_begin_from_state(context, &state, 0);
+}
+
+static void
+sha256_update(SHA256_Context *context, unsigned char *message, size_t message_size)
+{
+   context->message_size += message_size;
+
+   // Top off a partially filled buffer first.
+   if(context->buffer_size > 0)
+   {
+      size_t copy_size = 64 - context->buffer_size;
+      if(copy_size > message_size)
+      {
+         copy_size = message_size;
+      }
+
+      memory_copy(context->buffer + context->buffer_size, message, copy_size);
+      context->buffer_size += copy_size;
+
+      message += copy_size;
+      message_size -= copy_size;
+
+      if(context->buffer_size < 64)
+      {
+         return;
+      }
+
+      consume_sha256_chunk(&context->state, context->buffer);
+      context->buffer_size = 0;
+   }
+
+   // Consume full chunks straight out of the caller's memory.
+   size_t full_chunk_count = message_size / 64;
+   consume_sha256_chunks(&context->state, (uint8_t *)message, full_chunk_count);
+
+   message += 64 * full_chunk_count;
+   message_size -= 64 * full_chunk_count;
+
+   // Hold on to whatever is left until the next update.
+   memory_copy(context->buffer, message, message_size);
+   context->buffer_size = message_size;
+}
+
+static SHA256_State
+sha256_end_state(SHA256_Context *context)
+{
+   uint64_t prefix_size = context->message_size - context->buffer_size;
+   finalize_sha256(&context->state, context->buffer, context->buffer_size, prefix_size);
+
+   return context->state;
+}
+
+static SHA256
+sha256_end(SHA256_Context *context)
+{
+   SHA256_State state = sha256_end_state(context);
+
+   SHA256 result = sha256_state_to_hash(&state);
+   return result;
+}
+
+static SHA256
+hash_sha256(unsigned char *message, size_t message_size)
+{
+   // This implementation is based on the pseudo-code provided on the SHA-2
+   // wikipedia page: https://en.wikipedia.org/wiki/SHA-2
+
+   SHA256_Context context;
+   sha256_begin(&context);
+   sha256_update(&context, message, message_size);
+
+   SHA256 result = sha256_end(&context);
+   return result;
+}
+
+static SHA256
+hash_sha256_string(char *message)
+{
+   // NOTE(law): This only works on null-terminated C strings. Technically an
+   // input message could contain a 0-byte, which would throw off the count of
+   // string_length.
+
+   SHA256 result = hash_sha256((unsigned char *)message, string_length(message));
+   return result;
+}
+
+static void
+finalize_sha256_lanes(SHA256 *results,
+                      SHA256_State *states,
+                      unsigned char **messages,
+                      size_t message_size,
+                      uint64_t prefix_size,
+                      unsigned int lane_count)
+{
+   // NOTE(law): The lane-parallel version of finalize_sha256(). Each state may
+   // already have consumed prefix_size bytes (a multiple of the chunk size), as
+   // with HMAC key midstates. All of the messages must be the same size, which
+   // means every lane shares the same padding layout and consumes the same
+   // number of chunks. The states are consumed in place.
+
+   ASSERT(lane_count <= SHA256_MAX_LANE_COUNT);
+   ASSERT((prefix_size % 64) == 0);
+
+   uint8_t *chunks[SHA256_MAX_LANE_COUNT];
+
+   size_t full_chunk_count = message_size / 64;
+   for(size_t chunk_index = 0; chunk_index < full_chunk_count; ++chunk_index)
+   {
+      for(unsigned int lane = 0; lane < lane_count; ++lane)
       {
-         chunk[index] = 0;
+         chunks[lane] = messages[lane] + (64 * chunk_index);
       }
 
-      // Consume the penultimate chunk.
-      consume_sha256_chunk(&state, chunk);
-
-      // Clear the local buffer to zero to process the final chunk.
-      zero_memory(chunk, 64);
+      consume_sha256_chunk_lanes(states, chunks, lane_count);
    }
-   else
+
+   // Assemble the final one or two chunks of each lane, using the same padding
+   // rules as hash_sha256().
+   size_t remaining_size = message_size % 64;
+   size_t tail_size = (remaining_size < 56) ? 64 : 128;
+   uint64_t input_bit_count = (prefix_size + message_size) * 8;
+
+   uint8_t tails[SHA256_MAX_LANE_COUNT][128];
+   for(unsigned int lane = 0; lane < lane_count; ++lane)
    {
-      // If there was at least 65 bits of unused space in the first
-      // partially-filled chunk, then that chunk is the final chunk. Add the 1
-      // bit to the first unused bit in the final chunk and pad the remaining
-      // space with 0's.
+      uint8_t *tail = tails[lane];
+      zero_memory(tail, tail_size);
 
-      // Assemble the final chunk into a local buffer.
-      memory_copy(chunk, message, byte_index_for_one_bit);
-      chunk[byte_index_for_one_bit] = 0x80; // 0x80 == 0b10000000
-      for(uint64_t index = (byte_index_for_one_bit + 1); index < 64; ++index)
+      memory_copy(tail, messages[lane] + (64 * full_chunk_count), remaining_size);
+      tail[remaining_size] = 0x80;
+
+      for(unsigned int index = 0; index < 8; ++index)
       {
-         chunk[index] = 0;
+         tail[tail_size - 1 - index] = (uint8_t)(input_bit_count >> (8 * index));
       }
    }
 
-   // Store the 64 bit value for the initial input size in bits at the end of
-   // the final chunk in Big Endian order.
-   chunk[56] = (uint8_t)(input_bit_count >> 56);
-   chunk[57] = (uint8_t)(input_bit_count >> 48);
-   chunk[58] = (uint8_t)(input_bit_count >> 40);
-   chunk[59] = (uint8_t)(input_bit_count >> 32);
-   chunk[60] = (uint8_t)(input_bit_count >> 24);
-   chunk[61] = (uint8_t)(input_bit_count >> 16);
-   chunk[62] = (uint8_t)(input_bit_count >> 8);
-   chunk[63] = (uint8_t)(input_bit_count >> 0);
+   for(size_t offset = 0; offset < tail_size; offset += 64)
+   {
+      for(unsigned int lane = 0; lane < lane_count; ++lane)
+      {
+         chunks[lane] = tails[lane] + offset;
+      }
 
-   // Consume the final chunk.
-   consume_sha256_chunk(&state, chunk);
+      consume_sha256_chunk_lanes(states, chunks, lane_count);
+   }
 
-   // Fill out the output byte array
-   for(unsigned int index = 0; index < 8; ++index)
+   for(unsigned int lane = 0; lane < lane_count; ++lane)
    {
-      result.bytes[(4 * index) + 0] = (uint8_t)(state.h[index] >> 24);
-      result.bytes[(4 * index) + 1] = (uint8_t)(state.h[index] >> 16);
-      result.bytes[(4 * index) + 2] = (uint8_t)(state.h[index] >>  8);
-      result.bytes[(4 * index) + 3] = (uint8_t)(state.h[index] >>  0);
+      results[lane] = sha256_state_to_hash(states + lane);
    }
-
-   // Format the output bytes into a 65 bit string (including null terminator),
-   // using lowercase hexadecimal characters with 0-padding.
-   format_string(result.text, 65, "%08x%08x%08x%08x%08x%08x%08x%08x",
-                 state.h[0],
-                 state.h[1],
-                 state.h[2],
-                 state.h[3],
-                 state.h[4],
-                 state.h[5],
-                 state.h[6],
-                 state.h[7]);
-
-   return result;
 }
 
-static SHA256
-hash_sha256_string(char *message)
+static void
+hash_sha256_lanes(SHA256 *results, unsigned char **messages, size_t message_size, unsigned int lane_count)
 {
-   // NOTE(law): This only works on null-terminated C strings. Technically an
-   // input message could contain a 0-byte, which would throw off the count of
-   // string_length.
+   // NOTE(law): Hash lane_count independent messages of the same size at once.
 
-   SHA256 result = hash_sha256((unsigned char *)message, string_length(message));
-   return result;
+   ASSERT(lane_count <= SHA256_MAX_LANE_COUNT);
+
+   SHA256_State states[SHA256_MAX_LANE_COUNT];
+   for(unsigned int lane = 0; lane < lane_count; ++lane)
+   {
+      initialize_sha256_state(states + lane);
+   }
+
+   finalize_sha256_lanes(results, states, messages, message_size, 0, lane_count);
 }
 
-static SHA256
-hmac_sha256(unsigned char *key, size_t key_size,
-            unsigned char *message, size_t message_size)
+static void
+initialize_hmac_sha256_key(HMAC_SHA256_Key *result, unsigned char *key, size_t key_size)
 {
    // Implementation based on the description provided by
    // https://datatracker.ietf.org/doc/html/rfc2104
@@ -239,11 +1075,12 @@ hmac_sha256(unsigned char *key, size_t key_size,
    uint8_t inner_padded_key[64] = {0};
    uint8_t outer_padded_key[64] = {0};
 
+   SHA256 hash;
    if(key_size > 64)
    {
       // If the provided key was longer than the block size (64 bytes), then
       // truncate it by using it's hashed value instead.
-      SHA256 hash = hash_sha256(key, key_size);
+      hash = hash_sha256(key, key_size);
 
       key = hash.bytes;
       key_size = sizeof(hash.bytes);
@@ -258,30 +1095,132 @@ hmac_sha256(unsigned char *key, size_t key_size,
       outer_padded_key[index] ^= 0x5c;
    }
 
-   // TODO(law): Make this work without requiring an explicit dynamic
-   // allocation to hold the inner message.
+   // The padded keys are exactly one chunk each, so they can be consumed up
+   // front and the resulting midstates reused for every message.
+   initialize_sha256_state(&result->inner);
+   consume_sha256_chunk(&result->inner, inner_padded_key);
+
+   initialize_sha256_state(&result->outer);
+   consume_sha256_chunk(&result->outer, outer_padded_key);
+}
+
+static void
+hmac_sha256_begin_keyed(HMAC_SHA256_Context *context, HMAC_SHA256_Key *key)
+{
+   // The message is hashed on top of the inner padded key.
+   sha256_begin_from_state(&context->inner, &key->inner, 64);
+   context->outer = key->outer;
+}
+
+static void
+hmac_sha256_begin(HMAC_SHA256_Context *context, unsigned char *key, size_t key_size)
+{
+   HMAC_SHA256_Key hmac_key;
+   initialize_hmac_sha256_key(&hmac_key, key, key_size);
+
+   hmac_sha256_begin_keyed(context, &hmac_key);
+}
+
+static void
+hmac_sha256_update(HMAC_SHA256_Context *context, unsigned char *message, size_t message_size)
+{
+   sha256_update(&context->inner, message, message_size);
+}
+
+static SHA256
+hmac_sha256_end(HMAC_SHA256_Context *context)
+{
+   SHA256_State inner = sha256_end_state(&context->inner);
 
-   // Append message to inner padded key
-   size_t inner_message_size = sizeof(inner_padded_key) + message_size;
-   unsigned char *inner_message = platform_allocate(inner_message_size);
+   unsigned char inner_hash[32];
+   sha256_state_to_bytes(inner_hash, &inner);
 
-   memory_copy(inner_message, inner_padded_key, sizeof(inner_padded_key));
-   memory_copy(inner_message + sizeof(inner_padded_key), message, message_size);
+   // Hash the inner hash on top of the outer padded key.
+   SHA256_State outer = context->outer;
+   finalize_sha256(&outer, inner_hash, sizeof(inner_hash), 64);
 
-   SHA256 inner_hash = hash_sha256(inner_message, inner_message_size);
-   platform_deallocate(inner_message);
+   SHA256 result = sha256_state_to_hash(&outer);
+   return result;
+}
 
-   // Append inner hash to outer padded key
-   unsigned char outer_message[sizeof(outer_padded_key) + sizeof(inner_hash.bytes)];
+static SHA256
+hmac_sha256_keyed(HMAC_SHA256_Key *key, unsigned char *message, size_t message_size)
+{
+   HMAC_SHA256_Context context;
+   hmac_sha256_begin_keyed(&context, key);
+   hmac_sha256_update(&context, message, message_size);
 
-   memory_copy(outer_message, outer_padded_key, sizeof(outer_padded_key));
-   memory_copy(outer_message + sizeof(outer_padded_key), inner_hash.bytes, sizeof(inner_hash.bytes));
+   SHA256 result = hmac_sha256_end(&context);
+   return result;
+}
 
-   SHA256 result = hash_sha256(outer_message, sizeof(outer_message));
+static SHA256
+hmac_sha256(unsigned char *key, size_t key_size,
+            unsigned char *message, size_t message_size)
+{
+   HMAC_SHA256_Context context;
+   hmac_sha256_begin(&context, key, key_size);
+   hmac_sha256_update(&context, message, message_size);
 
+   SHA256 result = hmac_sha256_end(&context);
    return result;
 }
 
+static void
+initialize_hmac_sha256_iteration_chunk(uint8_t *chunk)
+{
+   // NOTE(law): Both halves of an HMAC over a 32 byte message (the inner hash of
+   // the message, and the outer hash of the inner hash) consume exactly one
+   // chunk after the padded key: 32 bytes of data followed by fixed padding for
+   // a total length of 64 + 32 bytes. Only the first 32 bytes of the chunk ever
+   // change, so the padding is written once here.
+
+   uint64_t input_bit_count = (64 + 32) * 8;
+
+   zero_memory(chunk, 64);
+   chunk[32] = 0x80;
+
+   for(unsigned int index = 0; index < 8; ++index)
+   {
+      chunk[63 - index] = (uint8_t)(input_bit_count >> (8 * index));
+   }
+}
+
+static void
+hmac_sha256_lanes(SHA256 *results,
+                  unsigned char **keys, size_t *key_sizes,
+                  unsigned char **messages, size_t message_size,
+                  unsigned int lane_count)
+{
+   // NOTE(law): The lane-parallel version of hmac_sha256(). Each lane has its
+   // own key, but the messages must all be message_size bytes long so that the
+   // inner and outer hashes go through the lanes together. Both resume from
+   // the key midstates, so the padded keys are never rehashed.
+
+   ASSERT(lane_count <= SHA256_MAX_LANE_COUNT);
+
+   HMAC_SHA256_Key hmac_keys[SHA256_MAX_LANE_COUNT];
+   SHA256_State states[SHA256_MAX_LANE_COUNT];
+
+   for(unsigned int lane = 0; lane < lane_count; ++lane)
+   {
+      initialize_hmac_sha256_key(hmac_keys + lane, keys[lane], key_sizes[lane]);
+      states[lane] = hmac_keys[lane].inner;
+   }
+
+   SHA256 inner_hashes[SHA256_MAX_LANE_COUNT];
+   finalize_sha256_lanes(inner_hashes, states, messages, message_size, 64, lane_count);
+
+   unsigned char *outer_messages[SHA256_MAX_LANE_COUNT];
+   for(unsigned int lane = 0; lane < lane_count; ++lane)
+   {
+      states[lane] = hmac_keys[lane].outer;
+      outer_messages[lane] = inner_hashes[lane].bytes;
+   }
+
+   finalize_sha256_lanes(results, states, outer_messages, sizeof(inner_hashes[0].bytes), 64, lane_count);
+}
+
 static void
 pbkdf2_hmac_sha256(unsigned char *output_key,
                    unsigned int output_key_size,
@@ -306,48 +1245,68 @@ pbkdf2_hmac_sha256(unsigned char *output_key,
    // final block will not copy the full hash output.
    unsigned int final_block_size = output_key_size - ((block_count - 1) * 32);
 
+   // NOTE(law): The password is the HMAC key for every iteration, so its padded
+   // key midstates are computed once for the whole derivation.
+   HMAC_SHA256_Key key;
+   initialize_hmac_sha256_key(&key, password, password_size);
+
+   uint8_t inner_chunk[64];
+   uint8_t outer_chunk[64];
+   initialize_hmac_sha256_iteration_chunk(inner_chunk);
+   initialize_hmac_sha256_iteration_chunk(outer_chunk);
+
    // The iteration starts at one, since the block index is as a part of the
    // initial hash message of each iteration.
    for(unsigned int block_index = 1; block_index <= block_count; ++block_index)
    {
       // The first iteration concatenates the salt with the Big Endian encoding
       // of the 32-bit block index, and then uses that string as the initial
-      // hash message.
-
-      // TODO(law): This shouldn't need an allocation given the second part is
-      // always 4 bytes. Maybe require the provided salt to include an
-      // additional 4 unused bytes at the end?
-      size_t u1_size = salt_size + sizeof(unsigned int);
-      unsigned char *u1_message = platform_allocate(u1_size);
-
-      memory_copy(u1_message, salt, salt_size);
-
-      // Append the block index in Big Endian order.
-      u1_message[salt_size + 0] = (unsigned char)(block_index >> 24);
-      u1_message[salt_size + 1] = (unsigned char)(block_index >> 16);
-      u1_message[salt_size + 2] = (unsigned char)(block_index >>  8);
-      u1_message[salt_size + 3] = (unsigned char)(block_index >>  0);
+      // hash message. The two parts are streamed into the HMAC separately.
+      unsigned char block_index_bytes[4];
+      block_index_bytes[0] = (unsigned char)(block_index >> 24);
+      block_index_bytes[1] = (unsigned char)(block_index >> 16);
+      block_index_bytes[2] = (unsigned char)(block_index >>  8);
+      block_index_bytes[3] = (unsigned char)(block_index >>  0);
+
+      HMAC_SHA256_Context u1_context;
+      hmac_sha256_begin_keyed(&u1_context, &key);
+      hmac_sha256_update(&u1_context, salt, salt_size);
+      hmac_sha256_update(&u1_context, block_index_bytes, sizeof(block_index_bytes));
 
       // The first hash iteration will be used as an accumulator to xor
       // subsequent hash results.
-      SHA256 u1 = hmac_sha256(password, password_size, u1_message, u1_size);
+      SHA256 u1 = hmac_sha256_end(&u1_context);
 
-      unsigned char u_message[32] = {0};
-      memory_copy(u_message, u1.bytes, sizeof(u1.bytes));
+      SHA256_State accumulator = {0};
+      memory_copy(inner_chunk, u1.bytes, sizeof(u1.bytes));
 
       for(unsigned int index = 2; index <= iteration_count; ++index)
       {
-         // Calculate hash using the previous hash result as the message.
-         SHA256 u = hmac_sha256(password, password_size, u_message, sizeof(u_message));
-
-         // Accumulate xors into initial hash result.
-         for(unsigned int byte_index = 0; byte_index < 32; ++byte_index)
+         // Calculate hash using the previous hash result as the message. The
+         // message is already in place at the front of inner_chunk, so each
+         // iteration is exactly two compressions.
+         SHA256_State inner = key.inner;
+         consume_sha256_chunk(&inner, inner_chunk);
+         sha256_state_to_bytes(outer_chunk, &inner);
+
+         SHA256_State outer = key.outer;
+         consume_sha256_chunk(&outer, outer_chunk);
+
+         // Accumulate xors of the state words, and store the current hash as
+         // the message for the next iteration.
+         for(unsigned int word_index = 0; word_index < 8; ++word_index)
          {
-            u1.bytes[byte_index] ^= u.bytes[byte_index];
+            accumulator.h[word_index] ^= outer.h[word_index];
          }
+         sha256_state_to_bytes(inner_chunk, &outer);
+      }
 
-         // Store the current hash as the message for the next iteration.
-         memory_copy(u_message, u.bytes, sizeof(u.bytes));
+      // Fold the accumulated xors into the initial hash result.
+      unsigned char accumulator_bytes[32];
+      sha256_state_to_bytes(accumulator_bytes, &accumulator);
+      for(unsigned int byte_index = 0; byte_index < 32; ++byte_index)
+      {
+         u1.bytes[byte_index] ^= accumulator_bytes[byte_index];
       }
 
       // Concatenate the xor'ed result into the output key.
@@ -360,216 +1319,346 @@ pbkdf2_hmac_sha256(unsigned char *output_key,
       {
          memory_copy(block_address, u1.bytes, 32);
       }
-
-      platform_deallocate(u1_message);
    }
 }
 
 static void
-test_hash_sha256(unsigned int run_count)
+pbkdf2_hmac_sha256_lanes(unsigned char **output_keys,
+                         unsigned int output_key_size,
+                         unsigned char **passwords,
+                         size_t *password_sizes,
+                         unsigned char **salts,
+                         size_t salt_size,
+                         unsigned int iteration_count,
+                         unsigned int lane_count)
 {
-   for(unsigned int index = 0; index < run_count; ++index) // Basic stress test
+   // NOTE(law): The lane-parallel version of pbkdf2_hmac_sha256(). Every lane
+   // derives its own key from its own password and salt, but the output size,
+   // salt size and iteration count are shared so the lanes stay in lockstep.
+
+   ASSERT(lane_count <= SHA256_MAX_LANE_COUNT);
+
+   unsigned int block_count = output_key_size / 32;
+   if((output_key_size % 32) != 0)
    {
-      {
-         SHA256 hash;
+      block_count++;
+   }
 
-         unsigned char message_bytes[] = {0};
-         unsigned char answer_bytes[] =
-         {
-            0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14,
-            0x9a, 0xfb, 0xf4, 0xc8, 0x99, 0x6f, 0xb9, 0x24,
-            0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c,
-            0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55,
-         };
+   unsigned int final_block_size = output_key_size - ((block_count - 1) * 32);
 
-         char *message_text = "";
-         char *answer_text = "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855";
+   HMAC_SHA256_Key keys[SHA256_MAX_LANE_COUNT];
+   SHA256_State states[SHA256_MAX_LANE_COUNT];
+   SHA256_State accumulators[SHA256_MAX_LANE_COUNT];
 
-         hash = hash_sha256(message_bytes, 0);
-         ASSERT(bytes_are_equal(hash.bytes, answer_bytes, sizeof(hash.bytes)));
-         ASSERT(strings_are_equal(hash.text, answer_text));
+   uint8_t inner_chunk_memory[SHA256_MAX_LANE_COUNT][64];
+   uint8_t outer_chunk_memory[SHA256_MAX_LANE_COUNT][64];
+   uint8_t *inner_chunks[SHA256_MAX_LANE_COUNT];
+   uint8_t *outer_chunks[SHA256_MAX_LANE_COUNT];
 
-         hash = hash_sha256_string(message_text);
-         ASSERT(bytes_are_equal(hash.bytes, answer_bytes, sizeof(hash.bytes)));
-         ASSERT(strings_are_equal(hash.text, answer_text));
-      }
-      {
-         SHA256 hash;
+   for(unsigned int lane = 0; lane < lane_count; ++lane)
+   {
+      initialize_hmac_sha256_key(keys + lane, passwords[lane], password_sizes[lane]);
 
-         unsigned char message_bytes[] = {'a', 'b', 'c'};
-         unsigned char answer_bytes[] =
-         {
-            0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea,
-            0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
-            0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
-            0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad,
-         };
+      inner_chunks[lane] = inner_chunk_memory[lane];
+      outer_chunks[lane] = outer_chunk_memory[lane];
+      initialize_hmac_sha256_iteration_chunk(inner_chunks[lane]);
+      initialize_hmac_sha256_iteration_chunk(outer_chunks[lane]);
+   }
 
-         char *message_text = "abc";
-         char *answer_text = "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad";
+   for(unsigned int block_index = 1; block_index <= block_count; ++block_index)
+   {
+      unsigned char block_index_bytes[4];
+      block_index_bytes[0] = (unsigned char)(block_index >> 24);
+      block_index_bytes[1] = (unsigned char)(block_index >> 16);
+      block_index_bytes[2] = (unsigned char)(block_index >>  8);
+      block_index_bytes[3] = (unsigned char)(block_index >>  0);
+
+      SHA256 u1[SHA256_MAX_LANE_COUNT];
+      for(unsigned int lane = 0; lane < lane_count; ++lane)
+      {
+         // NOTE(law): The first iteration is only run once per block, so it
+         // isn't worth batching across lanes.
+         HMAC_SHA256_Context u1_context;
+         hmac_sha256_begin_keyed(&u1_context, keys + lane);
+         hmac_sha256_update(&u1_context, salts[lane], salt_size);
+         hmac_sha256_update(&u1_context, block_index_bytes, sizeof(block_index_bytes));
 
-         hash = hash_sha256(message_bytes, sizeof(message_bytes));
-         ASSERT(bytes_are_equal(hash.bytes, answer_bytes, sizeof(hash.bytes)));
-         ASSERT(strings_are_equal(hash.text, answer_text));
+         u1[lane] = hmac_sha256_end(&u1_context);
 
-         hash = hash_sha256_string(message_text);
-         ASSERT(bytes_are_equal(hash.bytes, answer_bytes, sizeof(hash.bytes)));
-         ASSERT(strings_are_equal(hash.text, answer_text));
+         zero_memory(accumulators + lane, sizeof(accumulators[lane]));
+         memory_copy(inner_chunks[lane], u1[lane].bytes, sizeof(u1[lane].bytes));
       }
+
+      for(unsigned int index = 2; index <= iteration_count; ++index)
       {
-         SHA256 hash;
+         for(unsigned int lane = 0; lane < lane_count; ++lane)
+         {
+            states[lane] = keys[lane].inner;
+         }
+         consume_sha256_chunk_lanes(states, inner_chunks, lane_count);
 
-         unsigned char message_bytes[] =
+         for(unsigned int lane = 0; lane < lane_count; ++lane)
          {
-            'a', 'b', 'c', 'd', 'b', 'c', 'd', 'e', 'c', 'd',
-            'e', 'f', 'd', 'e', 'f', 'g', 'e', 'f', 'g', 'h',
-            'f', 'g', 'h', 'i', 'g', 'h', 'i', 'j', 'h', 'i',
-            'j', 'k', 'i', 'j', 'k', 'l', 'j', 'k', 'l', 'm',
-            'k', 'l', 'm', 'n', 'l', 'm', 'n', 'o', 'm', 'n',
-            'o', 'p', 'n', 'o', 'p', 'q',
-         };
-         unsigned char answer_bytes[] =
+            sha256_state_to_bytes(outer_chunks[lane], states + lane);
+            states[lane] = keys[lane].outer;
+         }
+         consume_sha256_chunk_lanes(states, outer_chunks, lane_count);
+
+         for(unsigned int lane = 0; lane < lane_count; ++lane)
          {
-            0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8,
-            0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
-            0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67,
-            0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1,
-         };
+            for(unsigned int word_index = 0; word_index < 8; ++word_index)
+            {
+               accumulators[lane].h[word_index] ^= states[lane].h[word_index];
+            }
+            sha256_state_to_bytes(inner_chunks[lane], states + lane);
+         }
+      }
 
-         char *message_text = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
-         char *answer_text = "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1";
-
-         hash = hash_sha256(message_bytes, sizeof(message_bytes));
-         ASSERT(bytes_are_equal(hash.bytes, answer_bytes, sizeof(hash.bytes)));
-         ASSERT(strings_are_equal(hash.text, answer_text));
-
-         hash = hash_sha256_string(message_text);
-         ASSERT(bytes_are_equal(hash.bytes, answer_bytes, sizeof(hash.bytes)));
-         ASSERT(strings_are_equal(hash.text, answer_text));
-      }
-      {
-         SHA256 hash;
-
-         unsigned char message_bytes[] =
-         {
-            'E', 'v', 'e', 'n', 'i', 'e', 't', ' ', 'a', 'l', 'i', 'a',
-            's', ' ', 'a', 'u', 't', ' ', 'e', 't', ' ', 'c', 'o', 'r',
-            'r', 'u', 'p', 't', 'i', '.', ' ', 'A', 'c', 'c', 'u', 's',
-            'a', 'n', 't', 'i', 'u', 'm', ' ', 'a', 'u', 't', 'e', 'm',
-            ' ', 'n', 'o', 's', 't', 'r', 'u', 'm', ' ', 'm', 'a', 'x',
-            'i', 'm', 'e', ' ', 'r', 'e', 'p', 'e', 'l', 'l', 'a', 't',
-            '.', ' ', 'E', 's', 't', ' ', 'i', 'n', ' ', 'e', 'i', 'u',
-            's', ' ', 'q', 'u', 'a', 's', 'i', ' ', 'e', 's', 't', '.',
-            ' ', 'E', 'a', ' ', 'a', 's', 'p', 'e', 'r', 'i', 'o', 'r',
-            'e', 's', ' ', 'p', 'o', 'r', 'r', 'o', ' ', 'm', 'o', 'l',
-            'e', 's', 't', 'i', 'a', 'e', ' ', 'r', 'e', 'p', 'e', 'l',
-            'l', 'e', 'n', 'd', 'u', 's', '.', ' ', 'E', 's', 't', ' ',
-            'e', 'o', 's', ' ', 'q', 'u', 'i', ' ', 'i', 'l', 'l', 'u',
-            'm', '.', ' ', 'A', 's', 'p', 'e', 'r', 'i', 'o', 'r', 'e',
-            's', ' ', 'q', 'u', 'o', 'd', ' ', 'd', 'o', 'l', 'o', 'r',
-            'e', ' ', 'p', 'l', 'a', 'c', 'e', 'a', 't', ' ', 'e', 'o',
-            's', ' ', 'e', 'x', 'p', 'l', 'i', 'c', 'a', 'b', 'o', ' ',
-            'e', 'x', 'p', 'e', 'd', 'i', 't', 'a', '.', ' ', 'S', 'o',
-            'l', 'u', 't', 'a', ' ', 'n', 'i', 'h', 'i', 'l', ' ', 'v',
-            'o', 'l', 'u', 'p', 't', 'a', 't', 'e', 'm', ' ', 's', 'e',
-            'd', '.', ' ', 'O', 'm', 'n', 'i', 's', ' ', 'd', 'i', 'c',
-            't', 'a', ' ', 'd', 'e', 'l', 'e', 'n', 'i', 't', 'i', ' ',
-            'v', 'i', 't', 'a', 'e', ' ', 'p', 'r', 'a', 'e', 's', 'e',
-            'n', 't', 'i', 'u', 'm', ' ', 'm', 'o', 'l', 'e', 's', 't',
-            'i', 'a', 'e', ' ', 'c', 'o', 'n', 's', 'e', 'q', 'u', 'a',
-            't', 'u', 'r', '.', ' ', 'V', 'e', 'l', 'i', 't', ' ', 'e',
-            'x', 'p', 'e', 'd', 'i', 't', 'a', ' ', 'c', 'o', 'r', 'p',
-            'o', 'r', 'i', 's', ' ', 'e', 'x', '.', ' ', 'P', 'e', 'r',
-            'f', 'e', 'r', 'e', 'n', 'd', 'i', 's', ' ', 'e', 'u', 'm',
-            ' ', 'n', 'o', 'b', 'i', 's', ' ', 'q', 'u', 'i', ' ', 'a',
-            'u', 't', ' ', 'c', 'u', 'm', 'q', 'u', 'e', ' ', 'v', 'o',
-            'l', 'u', 'p', 't', 'a', 't', 'e', 's', '.', ' ', 'S', 'i',
-            'm', 'i', 'l', 'i', 'q', 'u', 'e', ' ', 'r', 'a', 't', 'i',
-            'o', 'n', 'e', ' ', 'p', 'a', 'r', 'i', 'a', 't', 'u', 'r',
-            ' ', 'q', 'u', 'i', ' ', 'e', 'x', 'p', 'e', 'd', 'i', 't',
-            'a', ' ', 'd', 'e', 'l', 'e', 'n', 'i', 't', 'i', ' ', 'i',
-            'l', 'l', 'u', 'm', ' ', 'v', 'o', 'l', 'u', 'p', 't', 'a',
-            't', 'e', 'm', '.', ' ', 'Q', 'u', 'i', ' ', 'f', 'a', 'c',
-            'i', 'l', 'i', 's', ' ', 'r', 'e', 'r', 'u', 'm', ' ', 'v',
-            'o', 'l', 'u', 'p', 't', 'a', 't', 'e', 's', '.', ' ', 'R',
-            'e', 'p', 'u', 'd', 'i', 'a', 'n', 'd', 'a', 'e', ' ', 's',
-            'u', 's', 'c', 'i', 'p', 'i', 't', ' ', 'a', 'u', 't', ' ',
-            'i', 'u', 's', 't', 'o', ' ', 'd', 'e', 'l', 'e', 'n', 'i',
-            't', 'i', ' ', 'n', 'o', 'n', ' ', 't', 'o', 't', 'a', 'm',
-            '.', ' ', 'S', 'e', 'd', ' ', 'a', ' ', 'a', 'p', 'e', 'r',
-            'i', 'a', 'm', ' ', 'f', 'a', 'c', 'e', 'r', 'e', ' ', 'q',
-            'u', 'a', 's', 'i', ' ', 'o', 'm', 'n', 'i', 's', ' ', 'f',
-            'a', 'c', 'i', 'l', 'i', 's', ' ', 'q', 'u', 'a', 'm', ' ',
-            'n', 'o', 'n', '.', ' ', 'Q', 'u', 'i', ' ', 'n', 'e', 'q',
-            'u', 'e', ' ', 'q', 'u', 'o', 'd', ' ', 'a', 'u', 't', ' ',
-            'o', 'f', 'f', 'i', 'c', 'i', 'i', 's', ' ', 'm', 'i', 'n',
-            'i', 'm', 'a', ' ', 'v', 'o', 'l', 'u', 'p', 't', 'a', 's',
-            '.', ' ', 'P', 'a', 'r', 'i', 'a', 't', 'u', 'r', ' ', 'o',
-            'c', 'c', 'a', 'e', 'c', 'a', 't', 'i', ' ', 'v', 'o', 'l',
-            'u', 'p', 't', 'a', 's', ' ', 'e', 's', 's', 'e', ' ', 'v',
-            'o', 'l', 'u', 'p', 't', 'a', 's', '.', ' ', 'C', 'o', 'm',
-            'm', 'o', 'd', 'i', ' ', 'r', 'e', 'p', 'e', 'l', 'l', 'a',
-            't', ' ', 'o', 'p', 't', 'i', 'o', ' ', 'e', 't', ' ', 'v',
-            'o', 'l', 'u', 'p', 't', 'a', 't', 'e', 'm', ' ', 'r', 'e',
-            'i', 'c', 'i', 'e', 'n', 'd', 'i', 's', ' ', 'd', 'o', 'l',
-            'o', 'r', 'u', 'm', '.', ' ', 'Q', 'u', 'a', 'm', ' ', 'd',
-            'o', 'l', 'o', 'r', 'u', 'm', ' ', 's', 'i', 'n', 't', ' ',
-            'e', 'i', 'u', 's', '.', ' ', 'Q', 'u', 'o', ' ', 'v', 'o',
-            'l', 'u', 'p', 't', 'a', 's', ' ', 'a', 'd', ' ', 'e', 'o',
-            's', ' ', 'd', 'i', 'g', 'n', 'i', 's', 's', 'i', 'm', 'o',
-            's', ' ', 'i', 'n', 'v', 'e', 'n', 't', 'o', 'r', 'e', ' ',
-            'q', 'u', 'i', ' ', 'l', 'i', 'b', 'e', 'r', 'o', '.', ' ',
-            'N', 'i', 'h', 'i', 'l', ' ', 'r', 'e', 'p', 'e', 'l', 'l',
-            'a', 't', ' ', 'o', 'm', 'n', 'i', 's', ' ', 'i', 'l', 'l',
-            'u', 'm', '.', ' ', 'E', 'u', 'm', ' ', 'v', 'o', 'l', 'u',
-            'p', 't', 'a', 's', ' ', 'v', 'o', 'l', 'u', 'p', 't', 'a',
-            's', ' ', 'v', 'e', 'l', ' ', 's', 'e', 'q', 'u', 'i', ' ',
-            's', 'e', 'd', ' ', 'r', 'e', 'i', 'c', 'i', 'e', 'n', 'd',
-            'i', 's', '.', ' ', 'D', 'o', 'l', 'o', 'r', 'i', 'b', 'u',
-            's', ' ', 'e', 's', 't', ' ', 'a', 'm', 'e', 't', ' ', 'a',
-            'n', 'i', 'm', 'i', ' ', 'h', 'i', 'c', '.',
-         };
-         unsigned char answer_bytes[] =
+      for(unsigned int lane = 0; lane < lane_count; ++lane)
+      {
+         unsigned char accumulator_bytes[32];
+         sha256_state_to_bytes(accumulator_bytes, accumulators + lane);
+         for(unsigned int byte_index = 0; byte_index < 32; ++byte_index)
          {
-            0x34, 0x0d, 0x3d, 0x2c, 0x6c, 0x19, 0x81, 0x12,
-            0x86, 0x0d, 0x0f, 0x6d, 0xda, 0xfe, 0x51, 0xa1,
-            0x7e, 0x95, 0xc4, 0x11, 0xa1, 0x18, 0x10, 0xc0,
-            0x15, 0x2e, 0xf2, 0x08, 0x08, 0xdd, 0x0e, 0x42,
-         };
+            u1[lane].bytes[byte_index] ^= accumulator_bytes[byte_index];
+         }
+
+         unsigned char *block_address = output_keys[lane] + (32 * (block_index - 1));
+         if(block_index == block_count)
+         {
+            memory_copy(block_address, u1[lane].bytes, final_block_size);
+         }
+         else
+         {
+            memory_copy(block_address, u1[lane].bytes, 32);
+         }
+      }
+   }
+}
 
-         char *message_text =
-         "Eveniet alias aut et corrupti. Accusantium autem nostrum maxime repellat."
-         " Est in eius quasi est. Ea asperiores porro molestiae repellendus. Est "
-         "eos qui illum. Asperiores quod dolore placeat eos explicabo expedita. "
-         "Soluta nihil voluptatem sed. Omnis dicta deleniti vitae praesentium "
-         "molestiae consequatur. Velit expedita corporis ex. Perferendis eum nobis "
-         "qui aut cumque voluptates. Similique ratione pariatur qui expedita "
-         "deleniti illum voluptatem. Qui facilis rerum voluptates. Repudiandae "
-         "suscipit aut iusto deleniti non totam. Sed a aperiam facere quasi omnis "
-         "facilis quam non. Qui neque quod aut officiis minima voluptas. Pariatur "
-         "occaecati voluptas esse voluptas. Commodi repellat optio et voluptatem "
-         "reiciendis dolorum. Quam dolorum sint eius. Quo voluptas ad eos "
-         "dignissimos inventore qui libero. Nihil repellat omnis illum. Eum "
-         "voluptas voluptas vel sequi sed reiciendis. Doloribus est amet animi hic.";
+static void
+test_hash_sha256(unsigned int run_count)
+{
+   // NOTE(law): Every compression backend supported by the current CPU is
+   // checked against the same known-answer vectors.
+   SHA256_Backend selected_backend = global_sha256_backend;
 
-         char *answer_text = "340d3d2c6c198112860d0f6ddafe51a17e95c411a11810c0152ef20808dd0e42";
+   for(SHA256_Backend backend = 0; backend < SHA256_BACKEND_COUNT; ++backend)
+   {
+      if(!sha256_backend_is_supported(backend))
+      {
+         continue;
+      }
 
-         hash = hash_sha256(message_bytes, sizeof(message_bytes));
-         ASSERT(bytes_are_equal(hash.bytes, answer_bytes, sizeof(hash.bytes)));
-         ASSERT(strings_are_equal(hash.text, answer_text));
+      set_sha256_backend(backend);
 
-         hash = hash_sha256_string(message_text);
-         ASSERT(bytes_are_equal(hash.bytes, answer_bytes, sizeof(hash.bytes)));
-         ASSERT(strings_are_equal(hash.text, answer_text));
+      for(unsigned int index = 0; index < run_count; ++index) // Basic stress test
+      {
+         {
+            SHA256 hash;
+
+            unsigned char message_bytes[] = {0};
+            unsigned char answer_bytes[] =
+            {
+               0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14,
+               0x9a, 0xfb, 0xf4, 0xc8, 0x99, 0x6f, 0xb9, 0x24,
+               0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c,
+               0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55,
+            };
+
+            char *message_text = "";
+            char *answer_text = "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855";
+
+            hash = hash_sha256(message_bytes, 0);
+            ASSERT(bytes_are_equal(hash.bytes, answer_bytes, sizeof(hash.bytes)));
+            ASSERT(sha256_text_is_equal(&hash, answer_text));
+
+            hash = hash_sha256_string(message_text);
+            ASSERT(bytes_are_equal(hash.bytes, answer_bytes, sizeof(hash.bytes)));
+            ASSERT(sha256_text_is_equal(&hash, answer_text));
+         }
+         {
+            SHA256 hash;
+
+            unsigned char message_bytes[] = {'a', 'b', 'c'};
+            unsigned char answer_bytes[] =
+            {
+               0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea,
+               0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+               0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+               0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad,
+            };
+
+            char *message_text = "abc";
+            char *answer_text = "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad";
+
+            hash = hash_sha256(message_bytes, sizeof(message_bytes));
+            ASSERT(bytes_are_equal(hash.bytes, answer_bytes, sizeof(hash.bytes)));
+            ASSERT(sha256_text_is_equal(&hash, answer_text));
+
+            hash = hash_sha256_string(message_text);
+            ASSERT(bytes_are_equal(hash.bytes, answer_bytes, sizeof(hash.bytes)));
+            ASSERT(sha256_text_is_equal(&hash, answer_text));
+         }
+         {
+            SHA256 hash;
+
+            unsigned char message_bytes[] =
+            {
+               'a', 'b', 'c', 'd', 'b', 'c', 'd', 'e', 'c', 'd',
+               'e', 'f', 'd', 'e', 'f', 'g', 'e', 'f', 'g', 'h',
+               'f', 'g', 'h', 'i', 'g', 'h', 'i', 'j', 'h', 'i',
+               'j', 'k', 'i', 'j', 'k', 'l', 'j', 'k', 'l', 'm',
+               'k', 'l', 'm', 'n', 'l', 'm', 'n', 'o', 'm', 'n',
+               'o', 'p', 'n', 'o', 'p', 'q',
+            };
+            unsigned char answer_bytes[] =
+            {
+               0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8,
+               0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+               0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67,
+               0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1,
+            };
+
+            char *message_text = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+            char *answer_text = "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1";
+
+            hash = hash_sha256(message_bytes, sizeof(message_bytes));
+            ASSERT(bytes_are_equal(hash.bytes, answer_bytes, sizeof(hash.bytes)));
+            ASSERT(sha256_text_is_equal(&hash, answer_text));
+
+            hash = hash_sha256_string(message_text);
+            ASSERT(bytes_are_equal(hash.bytes, answer_bytes, sizeof(hash.bytes)));
+            ASSERT(sha256_text_is_equal(&hash, answer_text));
+         }
+         {
+            SHA256 hash;
+
+            unsigned char message_bytes[] =
+            {
+               'E', 'v', 'e', 'n', 'i', 'e', 't', ' ', 'a', 'l', 'i', 'a',
+               's', ' ', 'a', 'u', 't', ' ', 'e', 't', ' ', 'c', 'o', 'r',
+               'r', 'u', 'p', 't', 'i', '.', ' ', 'A', 'c', 'c', 'u', 's',
+               'a', 'n', 't', 'i', 'u', 'm', ' ', 'a', 'u', 't', 'e', 'm',
+               ' ', 'n', 'o', 's', 't', 'r', 'u', 'm', ' ', 'm', 'a', 'x',
+               'i', 'm', 'e', ' ', 'r', 'e', 'p', 'e', 'l', 'l', 'a', 't',
+               '.', ' ', 'E', 's', 't', ' ', 'i', 'n', ' ', 'e', 'i', 'u',
+               's', ' ', 'q', 'u', 'a', 's', 'i', ' ', 'e', 's', 't', '.',
+               ' ', 'E', 'a', ' ', 'a', 's', 'p', 'e', 'r', 'i', 'o', 'r',
+               'e', 's', ' ', 'p', 'o', 'r', 'r', 'o', ' ', 'm', 'o', 'l',
+               'e', 's', 't', 'i', 'a', 'e', ' ', 'r', 'e', 'p', 'e', 'l',
+               'l', 'e', 'n', 'd', 'u', 's', '.', ' ', 'E', 's', 't', ' ',
+               'e', 'o', 's', ' ', 'q', 'u', 'i', ' ', 'i', 'l', 'l', 'u',
+               'm', '.', ' ', 'A', 's', 'p', 'e', 'r', 'i', 'o', 'r', 'e',
+               's', ' ', 'q', 'u', 'o', 'd', ' ', 'd', 'o', 'l', 'o', 'r',
+               'e', ' ', 'p', 'l', 'a', 'c', 'e', 'a', 't', ' ', 'e', 'o',
+               's', ' ', 'e', 'x', 'p', 'l', 'i', 'c', 'a', 'b', 'o', ' ',
+               'e', 'x', 'p', 'e', 'd', 'i', 't', 'a', '.', ' ', 'S', 'o',
+               'l', 'u', 't', 'a', ' ', 'n', 'i', 'h', 'i', 'l', ' ', 'v',
+               'o', 'l', 'u', 'p', 't', 'a', 't', 'e', 'm', ' ', 's', 'e',
+               'd', '.', ' ', 'O', 'm', 'n', 'i', 's', ' ', 'd', 'i', 'c',
+               't', 'a', ' ', 'd', 'e', 'l', 'e', 'n', 'i', 't', 'i', ' ',
+               'v', 'i', 't', 'a', 'e', ' ', 'p', 'r', 'a', 'e', 's', 'e',
+               'n', 't', 'i', 'u', 'm', ' ', 'm', 'o', 'l', 'e', 's', 't',
+               'i', 'a', 'e', ' ', 'c', 'o', 'n', 's', 'e', 'q', 'u', 'a',
+               't', 'u', 'r', '.', ' ', 'V', 'e', 'l', 'i', 't', ' ', 'e',
+               'x', 'p', 'e', 'd', 'i', 't', 'a', ' ', 'c', 'o', 'r', 'p',
+               'o', 'r', 'i', 's', ' ', 'e', 'x', '.', ' ', 'P', 'e', 'r',
+               'f', 'e', 'r', 'e', 'n', 'd', 'i', 's', ' ', 'e', 'u', 'm',
+               ' ', 'n', 'o', 'b', 'i', 's', ' ', 'q', 'u', 'i', ' ', 'a',
+               'u', 't', ' ', 'c', 'u', 'm', 'q', 'u', 'e', ' ', 'v', 'o',
+               'l', 'u', 'p', 't', 'a', 't', 'e', 's', '.', ' ', 'S', 'i',
+               'm', 'i', 'l', 'i', 'q', 'u', 'e', ' ', 'r', 'a', 't', 'i',
+               'o', 'n', 'e', ' ', 'p', 'a', 'r', 'i', 'a', 't', 'u', 'r',
+               ' ', 'q', 'u', 'i', ' ', 'e', 'x', 'p', 'e', 'd', 'i', 't',
+               'a', ' ', 'd', 'e', 'l', 'e', 'n', 'i', 't', 'i', ' ', 'i',
+               'l', 'l', 'u', 'm', ' ', 'v', 'o', 'l', 'u', 'p', 't', 'a',
+               't', 'e', 'm', '.', ' ', 'Q', 'u', 'i', ' ', 'f', 'a', 'c',
+               'i', 'l', 'i', 's', ' ', 'r', 'e', 'r', 'u', 'm', ' ', 'v',
+               'o', 'l', 'u', 'p', 't', 'a', 't', 'e', 's', '.', ' ', 'R',
+               'e', 'p', 'u', 'd', 'i', 'a', 'n', 'd', 'a', 'e', ' ', 's',
+               'u', 's', 'c', 'i', 'p', 'i', 't', ' ', 'a', 'u', 't', ' ',
+               'i', 'u', 's', 't', 'o', ' ', 'd', 'e', 'l', 'e', 'n', 'i',
+               't', 'i', ' ', 'n', 'o', 'n', ' ', 't', 'o', 't', 'a', 'm',
+               '.', ' ', 'S', 'e', 'd', ' ', 'a', ' ', 'a', 'p', 'e', 'r',
+               'i', 'a', 'm', ' ', 'f', 'a', 'c', 'e', 'r', 'e', ' ', 'q',
+               'u', 'a', 's', 'i', ' ', 'o', 'm', 'n', 'i', 's', ' ', 'f',
+               'a', 'c', 'i', 'l', 'i', 's', ' ', 'q', 'u', 'a', 'm', ' ',
+               'n', 'o', 'n', '.', ' ', 'Q', 'u', 'i', ' ', 'n', 'e', 'q',
+               'u', 'e', ' ', 'q', 'u', 'o', 'd', ' ', 'a', 'u', 't', ' ',
+               'o', 'f', 'f', 'i', 'c', 'i', 'i', 's', ' ', 'm', 'i', 'n',
+               'i', 'm', 'a', ' ', 'v', 'o', 'l', 'u', 'p', 't', 'a', 's',
+               '.', ' ', 'P', 'a', 'r', 'i', 'a', 't', 'u', 'r', ' ', 'o',
+               'c', 'c', 'a', 'e', 'c', 'a', 't', 'i', ' ', 'v', 'o', 'l',
+               'u', 'p', 't', 'a', 's', ' ', 'e', 's', 's', 'e', ' ', 'v',
+               'o', 'l', 'u', 'p', 't', 'a', 's', '.', ' ', 'C', 'o', 'm',
+               'm', 'o', 'd', 'i', ' ', 'r', 'e', 'p', 'e', 'l', 'l', 'a',
+               't', ' ', 'o', 'p', 't', 'i', 'o', ' ', 'e', 't', ' ', 'v',
+               'o', 'l', 'u', 'p', 't', 'a', 't', 'e', 'm', ' ', 'r', 'e',
+               'i', 'c', 'i', 'e', 'n', 'd', 'i', 's', ' ', 'd', 'o', 'l',
+               'o', 'r', 'u', 'm', '.', ' ', 'Q', 'u', 'a', 'm', ' ', 'd',
+               'o', 'l', 'o', 'r', 'u', 'm', ' ', 's', 'i', 'n', 't', ' ',
+               'e', 'i', 'u', 's', '.', ' ', 'Q', 'u', 'o', ' ', 'v', 'o',
+               'l', 'u', 'p', 't', 'a', 's', ' ', 'a', 'd', ' ', 'e', 'o',
+               's', ' ', 'd', 'i', 'g', 'n', 'i', 's', 's', 'i', 'm', 'o',
+               's', ' ', 'i', 'n', 'v', 'e', 'n', 't', 'o', 'r', 'e', ' ',
+               'q', 'u', 'i', ' ', 'l', 'i', 'b', 'e', 'r', 'o', '.', ' ',
+               'N', 'i', 'h', 'i', 'l', ' ', 'r', 'e', 'p', 'e', 'l', 'l',
+               'a', 't', ' ', 'o', 'm', 'n', 'i', 's', ' ', 'i', 'l', 'l',
+               'u', 'm', '.', ' ', 'E', 'u', 'm', ' ', 'v', 'o', 'l', 'u',
+               'p', 't', 'a', 's', ' ', 'v', 'o', 'l', 'u', 'p', 't', 'a',
+               's', ' ', 'v', 'e', 'l', ' ', 's', 'e', 'q', 'u', 'i', ' ',
+               's', 'e', 'd', ' ', 'r', 'e', 'i', 'c', 'i', 'e', 'n', 'd',
+               'i', 's', '.', ' ', 'D', 'o', 'l', 'o', 'r', 'i', 'b', 'u',
+               's', ' ', 'e', 's', 't', ' ', 'a', 'm', 'e', 't', ' ', 'a',
+               'n', 'i', 'm', 'i', ' ', 'h', 'i', 'c', '.',
+            };
+            unsigned char answer_bytes[] =
+            {
+               0x34, 0x0d, 0x3d, 0x2c, 0x6c, 0x19, 0x81, 0x12,
+               0x86, 0x0d, 0x0f, 0x6d, 0xda, 0xfe, 0x51, 0xa1,
+               0x7e, 0x95, 0xc4, 0x11, 0xa1, 0x18, 0x10, 0xc0,
+               0x15, 0x2e, 0xf2, 0x08, 0x08, 0xdd, 0x0e, 0x42,
+            };
+
+            char *message_text =
+            "Eveniet alias aut et corrupti. Accusantium autem nostrum maxime repellat."
+            " Est in eius quasi est. Ea asperiores porro molestiae repellendus. Est "
+            "eos qui illum. Asperiores quod dolore placeat eos explicabo expedita. "
+            "Soluta nihil voluptatem sed. Omnis dicta deleniti vitae praesentium "
+            "molestiae consequatur. Velit expedita corporis ex. Perferendis eum nobis "
+            "qui aut cumque voluptates. Similique ratione pariatur qui expedita "
+            "deleniti illum voluptatem. Qui facilis rerum voluptates. Repudiandae "
+            "suscipit aut iusto deleniti non totam. Sed a aperiam facere quasi omnis "
+            "facilis quam non. Qui neque quod aut officiis minima voluptas. Pariatur "
+            "occaecati voluptas esse voluptas. Commodi repellat optio et voluptatem "
+            "reiciendis dolorum. Quam dolorum sint eius. Quo voluptas ad eos "
+            "dignissimos inventore qui libero. Nihil repellat omnis illum. Eum "
+            "voluptas voluptas vel sequi sed reiciendis. Doloribus est amet animi hic.";
+
+            char *answer_text = "340d3d2c6c198112860d0f6ddafe51a17e95c411a11810c0152ef20808dd0e42";
+
+            hash = hash_sha256(message_bytes, sizeof(message_bytes));
+            ASSERT(bytes_are_equal(hash.bytes, answer_bytes, sizeof(hash.bytes)));
+            ASSERT(sha256_text_is_equal(&hash, answer_text));
+
+            hash = hash_sha256_string(message_text);
+            ASSERT(bytes_are_equal(hash.bytes, answer_bytes, sizeof(hash.bytes)));
+            ASSERT(sha256_text_is_equal(&hash, answer_text));
 
+         }
       }
    }
+
+   set_sha256_backend(selected_backend);
 }
 
 #define TEST_HMAC_SHA256()                                                    \
    SHA256 hash = hmac_sha256(key, sizeof(key), message, sizeof(message));     \
    ASSERT(bytes_are_equal(hash.bytes, correct_bytes, sizeof(correct_bytes))); \
-   ASSERT(bytes_are_equal(hash.text, correct_text, string_length(correct_text)))
+   char hash_text[SHA256_TEXT_LENGTH + 1];                                    \
+   format_sha256_text(hash_text, &hash);                                      \
+   ASSERT(bytes_are_equal(hash_text, correct_text, string_length(correct_text)))
 
 static void
 test_hmac_sha256(unsigned int run_count)
@@ -895,3 +1984,194 @@ test_pbkdf2_hmac_sha256(unsigned int run_count)
       }
    }
 }
+
+static void
+test_hash_sha256_lanes(unsigned int run_count)
+{
+   // NOTE(law): The lane-parallel hashes are checked against hash_sha256() for
+   // every lane backend supported by the current CPU, across message sizes
+   // that hit each of the padding cases and lane counts that hit both full and
+   // partial vector groups.
+
+   SHA256_Lane_Backend selected_backend = global_sha256_lane_backend;
+
+   size_t message_sizes[] = {0, 3, 55, 56, 63, 64, 65, 119, 120, 200};
+
+   unsigned char message_memory[SHA256_MAX_LANE_COUNT][200];
+   unsigned char *messages[SHA256_MAX_LANE_COUNT];
+   for(unsigned int lane = 0; lane < SHA256_MAX_LANE_COUNT; ++lane)
+   {
+      for(unsigned int index = 0; index < sizeof(message_memory[lane]); ++index)
+      {
+         message_memory[lane][index] = (unsigned char)((31 * lane) + (7 * index));
+      }
+      messages[lane] = message_memory[lane];
+   }
+
+   for(SHA256_Lane_Backend backend = 0; backend < SHA256_LANE_BACKEND_COUNT; ++backend)
+   {
+      if(!sha256_lane_backend_is_supported(backend))
+      {
+         continue;
+      }
+
+      set_sha256_lane_backend(backend);
+
+      for(unsigned int index = 0; index < run_count; ++index)
+      {
+         for(unsigned int size_index = 0; size_index < ARRAY_LENGTH(message_sizes); ++size_index)
+         {
+            size_t message_size = message_sizes[size_index];
+            for(unsigned int lane_count = 1; lane_count <= SHA256_MAX_LANE_COUNT; ++lane_count)
+            {
+               SHA256 hashes[SHA256_MAX_LANE_COUNT];
+               hash_sha256_lanes(hashes, messages, message_size, lane_count);
+
+               for(unsigned int lane = 0; lane < lane_count; ++lane)
+               {
+                  SHA256 answer = hash_sha256(messages[lane], message_size);
+                  ASSERT(bytes_are_equal(hashes[lane].bytes, answer.bytes, sizeof(answer.bytes)));
+               }
+
+               // NOTE(law): The messages double as HMAC keys of varying size.
+               size_t key_sizes[SHA256_MAX_LANE_COUNT];
+               for(unsigned int lane = 0; lane < lane_count; ++lane)
+               {
+                  key_sizes[lane] = 10 * lane;
+               }
+
+               hmac_sha256_lanes(hashes, messages, key_sizes, messages, message_size, lane_count);
+
+               for(unsigned int lane = 0; lane < lane_count; ++lane)
+               {
+                  SHA256 answer = hmac_sha256(messages[lane], key_sizes[lane], messages[lane], message_size);
+                  ASSERT(bytes_are_equal(hashes[lane].bytes, answer.bytes, sizeof(answer.bytes)));
+               }
+            }
+         }
+      }
+   }
+
+   set_sha256_lane_backend(selected_backend);
+}
+
+static void
+test_pbkdf2_hmac_sha256_lanes(unsigned int run_count)
+{
+   // NOTE(law): Each lane gets a different password (including one longer than
+   // the HMAC block size), and is checked against pbkdf2_hmac_sha256().
+
+   SHA256_Lane_Backend selected_backend = global_sha256_lane_backend;
+
+   unsigned char password_memory[SHA256_MAX_LANE_COUNT][80];
+   unsigned char salt_memory[SHA256_MAX_LANE_COUNT][SALT_LENGTH];
+   unsigned char key_memory[SHA256_MAX_LANE_COUNT][40];
+
+   unsigned char *passwords[SHA256_MAX_LANE_COUNT];
+   size_t password_sizes[SHA256_MAX_LANE_COUNT];
+   unsigned char *salts[SHA256_MAX_LANE_COUNT];
+   unsigned char *keys[SHA256_MAX_LANE_COUNT];
+
+   for(unsigned int lane = 0; lane < SHA256_MAX_LANE_COUNT; ++lane)
+   {
+      for(unsigned int index = 0; index < sizeof(password_memory[lane]); ++index)
+      {
+         password_memory[lane][index] = (unsigned char)('a' + ((lane + index) % 26));
+      }
+      for(unsigned int index = 0; index < sizeof(salt_memory[lane]); ++index)
+      {
+         salt_memory[lane][index] = (unsigned char)((lane * 13) ^ index);
+      }
+
+      passwords[lane] = password_memory[lane];
+      password_sizes[lane] = (lane == 3) ? sizeof(password_memory[lane]) : (1 + lane);
+      salts[lane] = salt_memory[lane];
+      keys[lane] = key_memory[lane];
+   }
+
+   for(SHA256_Lane_Backend backend = 0; backend < SHA256_LANE_BACKEND_COUNT; ++backend)
+   {
+      if(!sha256_lane_backend_is_supported(backend))
+      {
+         continue;
+      }
+
+      set_sha256_lane_backend(backend);
+
+      for(unsigned int index = 0; index < run_count; ++index)
+      {
+         unsigned int lane_count = 1 + (index % SHA256_MAX_LANE_COUNT);
+         unsigned int iteration_count = 1 + (index * 37);
+
+         pbkdf2_hmac_sha256_lanes(keys, sizeof(key_memory[0]),
+                                  passwords, password_sizes,
+                                  salts, SALT_LENGTH,
+                                  iteration_count, lane_count);
+
+         for(unsigned int lane = 0; lane < lane_count; ++lane)
+         {
+            unsigned char answer[sizeof(key_memory[0])];
+            pbkdf2_hmac_sha256(answer, sizeof(answer),
+                               passwords[lane], password_sizes[lane],
+                               salts[lane], SALT_LENGTH,
+                               iteration_count);
+
+            ASSERT(bytes_are_equal(keys[lane], answer, sizeof(answer)));
+         }
+      }
+   }
+
+   set_sha256_lane_backend(selected_backend);
+}
+
+static void
+test_sha256_streaming(unsigned int run_count)
+{
+   // NOTE(law): Feed the same messages through the incremental interface in
+   // pieces of varying sizes, and check the results against the single-call
+   // versions.
+
+   unsigned char message[300];
+   for(unsigned int index = 0; index < sizeof(message); ++index)
+   {
+      message[index] = (unsigned char)(index * 11);
+   }
+
+   unsigned char key[] = {'k', 'e', 'y'};
+
+   for(unsigned int index = 0; index < run_count; ++index)
+   {
+      for(size_t message_size = 0; message_size <= sizeof(message); message_size += 23)
+      {
+         SHA256 answer = hash_sha256(message, message_size);
+         SHA256 hmac_answer = hmac_sha256(key, sizeof(key), message, message_size);
+
+         for(size_t piece_size = 1; piece_size <= 130; piece_size += 17)
+         {
+            SHA256_Context context;
+            sha256_begin(&context);
+
+            HMAC_SHA256_Context hmac_context;
+            hmac_sha256_begin(&hmac_context, key, sizeof(key));
+
+            for(size_t offset = 0; offset < message_size; offset += piece_size)
+            {
+               size_t size = message_size - offset;
+               if(size > piece_size)
+               {
+                  size = piece_size;
+               }
+
+               sha256_update(&context, message + offset, size);
+               hmac_sha256_update(&hmac_context, message + offset, size);
+            }
+
+            SHA256 hash = sha256_end(&context);
+            ASSERT(bytes_are_equal(hash.bytes, answer.bytes, sizeof(answer.bytes)));
+
+            SHA256 hmac = hmac_sha256_end(&hmac_context);
+            ASSERT(bytes_are_equal(hmac.bytes, hmac_answer.bytes, sizeof(hmac_answer.bytes)));
+         }
+      }
+   }
+}
@@ -7,14 +7,66 @@
 
 typedef struct
 {
+   // NOTE(law): Only the binary digest is produced by the hash functions. Use
+   // format_sha256_text() for the hexadecimal version when it's needed.
    unsigned char bytes[32];
-   char text[65]; // Includes null terminator.
 } SHA256;
 
+#define SHA256_TEXT_LENGTH 64
+
 typedef struct
 {
    uint32_t h[8];
 } SHA256_State;
 
+typedef struct
+{
+   // NOTE(law): An incremental hash in progress. Input is buffered until a full
+   // 64 byte chunk is available, so the caller can supply the message in pieces
+   // of any size.
+   SHA256_State state;
+   uint8_t buffer[64];
+   size_t buffer_size;
+   uint64_t message_size;
+} SHA256_Context;
+
+typedef struct
+{
+   // NOTE(law): The states reached after consuming the inner (ipad) and outer
+   // (opad) padded key blocks. They only depend on the key, so they can be
+   // computed once and cloned for every message hashed under that key.
+   SHA256_State inner;
+   SHA256_State outer;
+} HMAC_SHA256_Key;
+
+typedef struct
+{
+   SHA256_Context inner;
+   SHA256_State outer;
+} HMAC_SHA256_Context;
+
+typedef enum
+{
+   SHA256_BACKEND_SCALAR,
+   SHA256_BACKEND_X86_SHA,
+   SHA256_BACKEND_ARM_SHA2,
+
+   SHA256_BACKEND_COUNT,
+} SHA256_Backend;
+
+// NOTE(law): The lane backends hash several independent messages at once, one
+// per 32-bit vector lane.
+
+#define SHA256_MAX_LANE_COUNT 16
+
+typedef enum
+{
+   SHA256_LANE_BACKEND_SERIAL,
+   SHA256_LANE_BACKEND_AVX2,
+   SHA256_LANE_BACKEND_AVX512,
+
+   SHA256_LANE_BACKEND_COUNT,
+} SHA256_Lane_Backend;
+
 #define BSP_SHA256_H
 #endif
@@ -3,6 +3,14 @@
 SET DEVELOPMENT_BUILD=1
 SET APPLICATION_PORT=6969
 SET REQUEST_THREAD_COUNT=8
+SET KDF_THREAD_COUNT=4
+SET KDF_QUEUE_DEPTH=64
+SET KDF_BATCH_TIMEOUT_MICROSECONDS=200
+SET KDF_LATENCY_BUDGET_MILLISECONDS=250
+SET SESSION_TOKENS=0
+SET DATABASE_MAP_FILES=1
+SET DATABASE_THREAD_COUNT=4
+SET HUGE_PAGES=1
 
 SET CODE_PATH=..\code
 SET DATA_PATH=..\data
@@ -16,6 +24,14 @@ SET COMPILER_FLAGS=%COMPILER_FLAGS% -DAPPLICATION_PORT=%APPLICATION_PORT%
 SET COMPILER_FLAGS=%COMPILER_FLAGS% -DDEVELOPMENT_BUILD=%DEVELOPMENT_BUILD%
 SET COMPILER_FLAGS=%COMPILER_FLAGS% -DWORKING_DIRECTORY=%DEPLOYMENT_PATH%
 SET COMPILER_FLAGS=%COMPILER_FLAGS% -DREQUEST_THREAD_COUNT=%REQUEST_THREAD_COUNT%
+SET COMPILER_FLAGS=%COMPILER_FLAGS% -DKDF_THREAD_COUNT=%KDF_THREAD_COUNT%
+SET COMPILER_FLAGS=%COMPILER_FLAGS% -DKDF_QUEUE_DEPTH=%KDF_QUEUE_DEPTH%
+SET COMPILER_FLAGS=%COMPILER_FLAGS% -DKDF_BATCH_TIMEOUT_MICROSECONDS=%KDF_BATCH_TIMEOUT_MICROSECONDS%
+SET COMPILER_FLAGS=%COMPILER_FLAGS% -DKDF_LATENCY_BUDGET_MILLISECONDS=%KDF_LATENCY_BUDGET_MILLISECONDS%
+SET COMPILER_FLAGS=%COMPILER_FLAGS% -DSESSION_TOKENS=%SESSION_TOKENS%
+SET COMPILER_FLAGS=%COMPILER_FLAGS% -DDATABASE_MAP_FILES=%DATABASE_MAP_FILES%
+SET COMPILER_FLAGS=%COMPILER_FLAGS% -DDATABASE_THREAD_COUNT=%DATABASE_THREAD_COUNT%
+SET COMPILER_FLAGS=%COMPILER_FLAGS% -DHUGE_PAGES=%HUGE_PAGES%
 
 IF %DEVELOPMENT_BUILD%==1 (
    SET COMPILER_FLAGS=%COMPILER_FLAGS% -wd4100 -wd4101 -wd4189
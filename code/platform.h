@@ -50,20 +50,84 @@ typedef struct
 #define BSP_INITIALIZE_APPLICATION(name) void name(void)
 extern BSP_INITIALIZE_APPLICATION(bsp_initialize_application);
 
-#define BSP_PROCESS_REQUEST(name) \
-   void name(Request_State *request, unsigned char *arena_base_address, size_t arena_size)
+#define BSP_PROCESS_REQUEST(name) void name(Request_State *request, Memory_Arena *arena)
 extern BSP_PROCESS_REQUEST(bsp_process_request);
 
+// NOTE(law): Called by each request thread once a response has been sent.
+#define BSP_FINISH_REQUEST(name) void name(Memory_Arena *arena)
+extern BSP_FINISH_REQUEST(bsp_finish_request);
+
+// NOTE(law): Called by the platform layer when the operator asks for a backup
+// (SIGUSR1 on Linux, Ctrl+Break on Windows), on a thread of its own.
+#define BSP_BACKUP_DATABASE(name) void name(void)
+extern BSP_BACKUP_DATABASE(bsp_backup_database);
+
 
 // NOTE(law): The following function prototypes must be implemented on a
 // per-platform basis.
 
+// NOTE(law): Allocations are zeroed and 16-byte aligned. Sizes up to
+// PLATFORM_SIZE_CLASS_MAXIMUM are carved from size class slabs with a
+// per-thread cache in front of them, and anything larger gets its own mapping.
 #define PLATFORM_ALLOCATE(name) void *name(size_t size)
 extern PLATFORM_ALLOCATE(platform_allocate);
 
 #define PLATFORM_DEALLOCATE(name) void name(void *memory)
 extern PLATFORM_DEALLOCATE(platform_deallocate);
 
+#define PLATFORM_SIZE_CLASS_COUNT 39
+#define PLATFORM_SIZE_CLASS_MAXIMUM KIBIBYTES(32)
+
+typedef struct
+{
+   size_t block_size;
+   uint64_t allocation_count;
+   uint64_t deallocation_count;
+   size_t span_size;
+   size_t free_count;
+} Platform_Size_Class_Statistics;
+
+typedef struct
+{
+   Platform_Size_Class_Statistics size_classes[PLATFORM_SIZE_CLASS_COUNT];
+
+   uint64_t large_allocation_count;
+   uint64_t large_deallocation_count;
+   size_t large_mapped_size;
+} Platform_Allocator_Statistics;
+
+// NOTE(law): Each thread reports its counts in batches, so the totals can trail
+// the true values by a batch per thread. free_count only covers the blocks that
+// aren't sitting in a thread's cache.
+#define PLATFORM_GET_ALLOCATOR_STATISTICS(name) void name(Platform_Allocator_Statistics *statistics)
+extern PLATFORM_GET_ALLOCATOR_STATISTICS(platform_get_allocator_statistics);
+
+// NOTE(law): PLATFORM_MEMORY_HUGE_PAGES asks for a region to be backed by huge
+// pages, which cuts down on TLB misses when a large region is accessed at
+// random. It's only a request: regions smaller than a huge page are left alone,
+// anything else falls back to regular pages if huge ones aren't available, and
+// the backing that was actually used is returned.
+#define PLATFORM_MEMORY_HUGE_PAGES (1 << 0)
+
+// NOTE(law): Reserved memory is only address space, and has to be committed
+// (in whole pages) before it's touched.
+#define PLATFORM_RESERVE_MEMORY(name) void *name(size_t size, unsigned int flags, Page_Backing *backing)
+extern PLATFORM_RESERVE_MEMORY(platform_reserve_memory);
+
+// NOTE(law): Page-aligned, zeroed memory for regions that live as long as the
+// process. It is never freed.
+#define PLATFORM_ALLOCATE_PAGES(name) void *name(size_t size, unsigned int flags, Page_Backing *backing)
+extern PLATFORM_ALLOCATE_PAGES(platform_allocate_pages);
+
+#define PLATFORM_COMMIT_MEMORY(name) bool name(void *memory, size_t size)
+extern PLATFORM_COMMIT_MEMORY(platform_commit_memory);
+
+#define PLATFORM_DECOMMIT_MEMORY(name) void name(void *memory, size_t size)
+extern PLATFORM_DECOMMIT_MEMORY(platform_decommit_memory);
+
+#define PLATFORM_RELEASE_MEMORY(name) void name(void *memory, size_t size)
+extern PLATFORM_RELEASE_MEMORY(platform_release_memory);
+
 #define PLATFORM_LOG_MESSAGE(name) void name(char *format, ...)
 extern PLATFORM_LOG_MESSAGE(platform_log_message);
 
@@ -79,9 +143,53 @@ extern PLATFORM_FREE_FILE(platform_free_file);
 #define PLATFORM_READ_FILE(name) Platform_File name(char *file_name)
 extern PLATFORM_READ_FILE(platform_read_file);
 
+// NOTE(law): Map an entire existing file into memory, copy-on-write. Pages are
+// shared with the page cache (and so with other processes reading the file)
+// until they are written to, and writes through the mapping never reach the
+// file. The mapping lasts for the life of the process. An empty or missing file
+// returns a zeroed Platform_File. On Windows the file is read into private
+// pages instead, since a mapped file can't be replaced (see platform_win32.c).
+#define PLATFORM_MAP_FILE(name) Platform_File name(char *file_name)
+extern PLATFORM_MAP_FILE(platform_map_file);
+
 #define PLATFORM_APPEND_FILE(name) bool name(char *file_name, void *memory, size_t size)
 extern PLATFORM_APPEND_FILE(platform_append_file);
 
+#define PLATFORM_DELETE_FILE(name) bool name(char *file_name)
+extern PLATFORM_DELETE_FILE(platform_delete_file);
+
+// NOTE(law): Files that are kept open for repeated writes and syncs, rather than
+// being opened for each call. The file is created if needed. The name must stay
+// valid until the handle is closed.
+#define PLATFORM_OPEN_FILE(name) struct Platform_File_Handle *name(char *file_name)
+extern PLATFORM_OPEN_FILE(platform_open_file);
+
+#define PLATFORM_CLOSE_FILE(name) void name(struct Platform_File_Handle *file)
+extern PLATFORM_CLOSE_FILE(platform_close_file);
+
+// NOTE(law): Atomically rename source_file_name over the handle's file, and
+// reopen the handle on the result. On failure the handle is left on the
+// original file.
+#define PLATFORM_REPLACE_FILE(name) bool name(struct Platform_File_Handle *file, char *source_file_name)
+extern PLATFORM_REPLACE_FILE(platform_replace_file);
+
+#define PLATFORM_WRITE_FILE_HANDLE(name) \
+   bool name(struct Platform_File_Handle *file, size_t offset, void *memory, size_t size)
+extern PLATFORM_WRITE_FILE_HANDLE(platform_write_file_handle);
+
+// NOTE(law): Returns the number of bytes read, which is only less than size if
+// the file ends first (or on failure).
+#define PLATFORM_READ_FILE_HANDLE(name) \
+   size_t name(struct Platform_File_Handle *file, size_t offset, void *memory, size_t size)
+extern PLATFORM_READ_FILE_HANDLE(platform_read_file_handle);
+
+// NOTE(law): Blocks until everything written to the file is on disk.
+#define PLATFORM_SYNC_FILE(name) bool name(struct Platform_File_Handle *file)
+extern PLATFORM_SYNC_FILE(platform_sync_file);
+
+#define PLATFORM_TRUNCATE_FILE(name) bool name(struct Platform_File_Handle *file, size_t size)
+extern PLATFORM_TRUNCATE_FILE(platform_truncate_file);
+
 #define PLATFORM_GENERATE_RANDOM_BYTES(name) void name(void *destination, size_t size)
 extern PLATFORM_GENERATE_RANDOM_BYTES(platform_generate_random_bytes);
 
@@ -94,6 +202,48 @@ extern PLATFORM_LOCK(platform_lock);
 #define PLATFORM_UNLOCK(name) void name(struct Platform_Semaphore *semaphore)
 extern PLATFORM_UNLOCK(platform_unlock);
 
+// NOTE(law): A work queue is a fixed set of worker threads fed by a bounded
+// queue of entries. Entries are owned by the submitter (typically on its
+// stack), and must stay alive until platform_wait_for_work() returns for them.
+
+#define PLATFORM_WORK_QUEUE_CALLBACK(name) void name(void *data)
+typedef PLATFORM_WORK_QUEUE_CALLBACK(Platform_Work_Queue_Callback);
+
+typedef struct
+{
+   Platform_Work_Queue_Callback *callback;
+   void *data;
+
+   volatile bool completed;
+
+   // NOTE(law): Optionally set by whoever completes an entry, when the work it
+   // stands for didn't succeed. Cleared by the submitter.
+   volatile bool failed;
+} Platform_Work_Entry;
+
+#define PLATFORM_INITIALIZE_WORK_QUEUE(name) \
+   struct Platform_Work_Queue *name(unsigned int thread_count, unsigned int max_entry_count)
+extern PLATFORM_INITIALIZE_WORK_QUEUE(platform_initialize_work_queue);
+
+// NOTE(law): Submission blocks while the queue is full. The return value is the
+// number of entries that were already waiting ahead of this one.
+#define PLATFORM_SUBMIT_WORK(name) \
+   unsigned int name(struct Platform_Work_Queue *queue, Platform_Work_Entry *entry)
+extern PLATFORM_SUBMIT_WORK(platform_submit_work);
+
+#define PLATFORM_WAIT_FOR_WORK(name) \
+   void name(struct Platform_Work_Queue *queue, Platform_Work_Entry *entry)
+extern PLATFORM_WAIT_FOR_WORK(platform_wait_for_work);
+
+// NOTE(law): Marks an entry that was never submitted as completed and wakes its
+// waiters. This lets one callback finish work on behalf of several entries.
+#define PLATFORM_COMPLETE_WORK(name) \
+   void name(struct Platform_Work_Queue *queue, Platform_Work_Entry *entry)
+extern PLATFORM_COMPLETE_WORK(platform_complete_work);
+
+#define PLATFORM_SLEEP(name) void name(unsigned int microseconds)
+extern PLATFORM_SLEEP(platform_sleep);
+
 
 #define PLATFORM_H
 #endif
@@ -0,0 +1,401 @@
+/* /////////////////////////////////////////////////////////////////////////// */
+/* (c) copyright 2023 Lawrence D. Kern /////////////////////////////////////// */
+/* /////////////////////////////////////////////////////////////////////////// */
+
+// NOTE(law): The general purpose allocator shared by the platform layers. Small
+// and medium allocations are rounded up to one of PLATFORM_SIZE_CLASS_COUNT
+// block sizes (16 byte steps up to 128, then four steps per doubling up to
+// PLATFORM_SIZE_CLASS_MAXIMUM) and carved out of spans that are mapped once and
+// kept. Each thread caches a few free blocks per class, so the common case of
+// allocating and freeing on the same thread doesn't take a lock or make a
+// syscall. Larger allocations get a mapping of their own, which is returned to
+// the OS when freed.
+//
+// Blocks are zeroed as they are freed rather than as they are handed out. That
+// keeps platform_allocate()'s zeroed contract (fresh spans are zero already),
+// and means passwords and keys don't sit around in freed blocks.
+//
+// The including platform layer supplies platform_map_memory() and
+// platform_unmap_memory().
+
+#define PLATFORM_ALLOCATOR_HEADER_SIZE 16
+#define PLATFORM_ALLOCATOR_LARGE_CLASS PLATFORM_SIZE_CLASS_COUNT
+#define PLATFORM_ALLOCATOR_SPAN_SIZE KIBIBYTES(64)
+#define PLATFORM_ALLOCATOR_BATCH_SIZE KIBIBYTES(16)
+
+typedef struct
+{
+   // NOTE(law): Sits just before the address that is handed out. Free blocks
+   // reuse the first field as their next pointer.
+   size_t mapping_size;
+   size_t size_class;
+} Platform_Block_Header;
+
+typedef struct Platform_Free_Block
+{
+   struct Platform_Free_Block *next;
+} Platform_Free_Block;
+
+typedef struct
+{
+   volatile long lock;
+
+   Platform_Free_Block *free_list;
+   size_t free_count;
+
+   unsigned char *span_cursor;
+   unsigned char *span_end;
+   size_t span_size;
+
+   uint64_t allocation_count;
+   uint64_t deallocation_count;
+} Platform_Size_Class;
+
+typedef struct
+{
+   Platform_Free_Block *head;
+   unsigned int count;
+
+   unsigned int pending_allocation_count;
+   unsigned int pending_deallocation_count;
+} Platform_Thread_Cache_Class;
+
+static Platform_Size_Class platform_size_classes[PLATFORM_SIZE_CLASS_COUNT];
+static volatile long platform_large_lock;
+static uint64_t platform_large_allocation_count;
+static uint64_t platform_large_deallocation_count;
+static size_t platform_large_mapped_size;
+
+// NOTE(law): Blocks cached by a thread are lost if the thread exits. Request and
+// work queue threads live as long as the process, so that isn't an issue yet.
+static PLATFORM_THREAD_LOCAL Platform_Thread_Cache_Class platform_thread_cache[PLATFORM_SIZE_CLASS_COUNT];
+
+static void *platform_map_memory(size_t size);
+static void platform_unmap_memory(void *memory, size_t size);
+
+#if defined(_MSC_VER)
+#  define PLATFORM_ALLOCATOR_TRY_LOCK(lock) (InterlockedCompareExchange((lock), 1, 0) == 0)
+#  define PLATFORM_ALLOCATOR_UNLOCK(lock) InterlockedExchange((lock), 0)
+#else
+#  define PLATFORM_ALLOCATOR_TRY_LOCK(lock) __sync_bool_compare_and_swap((lock), 0, 1)
+#  define PLATFORM_ALLOCATOR_UNLOCK(lock) __sync_lock_release(lock)
+#endif
+
+static void
+platform_allocator_lock(volatile long *lock)
+{
+   while(*lock || !PLATFORM_ALLOCATOR_TRY_LOCK(lock))
+   {
+      platform_spin_pause();
+   }
+}
+
+static void
+platform_allocator_unlock(volatile long *lock)
+{
+   PLATFORM_ALLOCATOR_UNLOCK(lock);
+}
+
+static unsigned int
+platform_highest_set_bit(size_t value)
+{
+   ASSERT(value);
+
+#if defined(_MSC_VER)
+   unsigned long result;
+   _BitScanReverse64(&result, value);
+#else
+   unsigned int result = 63 - __builtin_clzll(value);
+#endif
+
+   return (unsigned int)result;
+}
+
+static unsigned int
+platform_size_class_index(size_t block_size)
+{
+   // NOTE(law): block_size includes the header. Classes 0-6 are 32 to 128 bytes
+   // in 16 byte steps, after which every doubling is split into four steps.
+
+   unsigned int result;
+   if(block_size <= 128)
+   {
+      block_size = MAXIMUM(block_size, 32);
+      result = (unsigned int)((block_size + 15) / 16) - 2;
+   }
+   else
+   {
+      size_t value = block_size - 1;
+      unsigned int shift = platform_highest_set_bit(value);
+
+      result = 7 + (4 * (shift - 7)) + (unsigned int)((value - ((size_t)1 << shift)) >> (shift - 2));
+   }
+
+   return result;
+}
+
+static size_t
+platform_size_class_block_size(unsigned int index)
+{
+   size_t result;
+   if(index < 7)
+   {
+      result = 32 + (16 * index);
+   }
+   else
+   {
+      size_t base = (size_t)128 << ((index - 7) / 4);
+      result = base + ((((index - 7) % 4) + 1) * (base / 4));
+   }
+
+   return result;
+}
+
+static unsigned int
+platform_size_class_batch_count(size_t block_size)
+{
+   // NOTE(law): How many blocks move between a thread cache and its class at a
+   // time. A thread holds on to at most two batches.
+
+   size_t result = PLATFORM_ALLOCATOR_BATCH_SIZE / block_size;
+   result = MAXIMUM(2, MINIMUM(32, result));
+
+   return (unsigned int)result;
+}
+
+static void
+platform_fold_thread_statistics(Platform_Size_Class *size_class, Platform_Thread_Cache_Class *cache)
+{
+   // NOTE(law): The caller holds the class lock.
+
+   size_class->allocation_count += cache->pending_allocation_count;
+   size_class->deallocation_count += cache->pending_deallocation_count;
+
+   cache->pending_allocation_count = 0;
+   cache->pending_deallocation_count = 0;
+}
+
+static void
+platform_refill_thread_cache(unsigned int index, Platform_Thread_Cache_Class *cache)
+{
+   Platform_Size_Class *size_class = platform_size_classes + index;
+
+   size_t block_size = platform_size_class_block_size(index);
+   unsigned int batch_count = platform_size_class_batch_count(block_size);
+
+   platform_allocator_lock(&size_class->lock);
+   {
+      platform_fold_thread_statistics(size_class, cache);
+
+      for(unsigned int count = 0; count < batch_count; ++count)
+      {
+         Platform_Free_Block *block = size_class->free_list;
+         if(block)
+         {
+            size_class->free_list = block->next;
+            size_class->free_count--;
+         }
+         else
+         {
+            if((size_t)(size_class->span_end - size_class->span_cursor) < block_size)
+            {
+               // NOTE(law): Spans are never unmapped. A class's footprint is
+               // its high water mark, and the blocks go back on the free list.
+               size_t span_size = MAXIMUM(PLATFORM_ALLOCATOR_SPAN_SIZE, 8 * block_size);
+               unsigned char *span = platform_map_memory(span_size);
+               if(!span)
+               {
+                  break;
+               }
+
+               size_class->span_cursor = span;
+               size_class->span_end = span + span_size;
+               size_class->span_size += span_size;
+            }
+
+            block = (Platform_Free_Block *)size_class->span_cursor;
+            size_class->span_cursor += block_size;
+         }
+
+         block->next = cache->head;
+         cache->head = block;
+         cache->count++;
+      }
+   }
+   platform_allocator_unlock(&size_class->lock);
+}
+
+static void
+platform_drain_thread_cache(unsigned int index, Platform_Thread_Cache_Class *cache, unsigned int drain_count)
+{
+   Platform_Size_Class *size_class = platform_size_classes + index;
+
+   platform_allocator_lock(&size_class->lock);
+   {
+      platform_fold_thread_statistics(size_class, cache);
+
+      for(unsigned int count = 0; count < drain_count && cache->head; ++count)
+      {
+         Platform_Free_Block *block = cache->head;
+         cache->head = block->next;
+         cache->count--;
+
+         block->next = size_class->free_list;
+         size_class->free_list = block;
+         size_class->free_count++;
+      }
+   }
+   platform_allocator_unlock(&size_class->lock);
+}
+
+static void
+platform_flush_thread_statistics(unsigned int index, Platform_Thread_Cache_Class *cache)
+{
+   Platform_Size_Class *size_class = platform_size_classes + index;
+
+   platform_allocator_lock(&size_class->lock);
+   {
+      platform_fold_thread_statistics(size_class, cache);
+   }
+   platform_allocator_unlock(&size_class->lock);
+}
+
+extern
+PLATFORM_ALLOCATE(platform_allocate)
+{
+   void *result = 0;
+
+   size_t block_size = size + PLATFORM_ALLOCATOR_HEADER_SIZE;
+   if(size <= PLATFORM_SIZE_CLASS_MAXIMUM - PLATFORM_ALLOCATOR_HEADER_SIZE)
+   {
+      unsigned int index = platform_size_class_index(block_size);
+      Platform_Thread_Cache_Class *cache = platform_thread_cache + index;
+
+      if(!cache->head)
+      {
+         platform_refill_thread_cache(index, cache);
+      }
+
+      Platform_Block_Header *header = (Platform_Block_Header *)cache->head;
+      if(header)
+      {
+         cache->head = cache->head->next;
+         cache->count--;
+
+         header->mapping_size = 0;
+         header->size_class = index;
+
+         result = header + 1;
+
+         cache->pending_allocation_count++;
+         size_t pending_count = cache->pending_allocation_count + cache->pending_deallocation_count;
+         if(pending_count >= platform_size_class_batch_count(platform_size_class_block_size(index)))
+         {
+            platform_flush_thread_statistics(index, cache);
+         }
+      }
+   }
+   else if(block_size > size)
+   {
+      Platform_Block_Header *header = platform_map_memory(block_size);
+      if(header)
+      {
+         header->mapping_size = block_size;
+         header->size_class = PLATFORM_ALLOCATOR_LARGE_CLASS;
+
+         result = header + 1;
+
+         platform_allocator_lock(&platform_large_lock);
+         {
+            platform_large_allocation_count++;
+            platform_large_mapped_size += block_size;
+         }
+         platform_allocator_unlock(&platform_large_lock);
+      }
+   }
+
+   if(!result)
+   {
+      platform_log_message("[ERROR] Failed to allocate %zu bytes.", size);
+   }
+
+   return result;
+}
+
+extern
+PLATFORM_DEALLOCATE(platform_deallocate)
+{
+   if(!memory)
+   {
+      return;
+   }
+
+   Platform_Block_Header *header = (Platform_Block_Header *)memory - 1;
+   if(header->size_class == PLATFORM_ALLOCATOR_LARGE_CLASS)
+   {
+      size_t mapping_size = header->mapping_size;
+      platform_unmap_memory(header, mapping_size);
+
+      platform_allocator_lock(&platform_large_lock);
+      {
+         platform_large_deallocation_count++;
+         platform_large_mapped_size -= mapping_size;
+      }
+      platform_allocator_unlock(&platform_large_lock);
+   }
+   else
+   {
+      unsigned int index = (unsigned int)header->size_class;
+      ASSERT(index < PLATFORM_SIZE_CLASS_COUNT);
+
+      size_t block_size = platform_size_class_block_size(index);
+      unsigned int batch_count = platform_size_class_batch_count(block_size);
+
+      memset(memory, 0, block_size - PLATFORM_ALLOCATOR_HEADER_SIZE);
+
+      Platform_Thread_Cache_Class *cache = platform_thread_cache + index;
+
+      Platform_Free_Block *block = (Platform_Free_Block *)header;
+      block->next = cache->head;
+      cache->head = block;
+      cache->count++;
+
+      cache->pending_deallocation_count++;
+      if(cache->count > (2 * batch_count))
+      {
+         platform_drain_thread_cache(index, cache, batch_count);
+      }
+      else if((cache->pending_allocation_count + cache->pending_deallocation_count) >= batch_count)
+      {
+         platform_flush_thread_statistics(index, cache);
+      }
+   }
+}
+
+extern
+PLATFORM_GET_ALLOCATOR_STATISTICS(platform_get_allocator_statistics)
+{
+   for(unsigned int index = 0; index < PLATFORM_SIZE_CLASS_COUNT; ++index)
+   {
+      Platform_Size_Class *size_class = platform_size_classes + index;
+      Platform_Size_Class_Statistics *result = statistics->size_classes + index;
+
+      platform_allocator_lock(&size_class->lock);
+      {
+         result->block_size = platform_size_class_block_size(index);
+         result->allocation_count = size_class->allocation_count;
+         result->deallocation_count = size_class->deallocation_count;
+         result->span_size = size_class->span_size;
+         result->free_count = size_class->free_count;
+      }
+      platform_allocator_unlock(&size_class->lock);
+   }
+
+   platform_allocator_lock(&platform_large_lock);
+   {
+      statistics->large_allocation_count = platform_large_allocation_count;
+      statistics->large_deallocation_count = platform_large_deallocation_count;
+      statistics->large_mapped_size = platform_large_mapped_size;
+   }
+   platform_allocator_unlock(&platform_large_lock);
+}
@@ -3,8 +3,50 @@
 /* (c) copyright 2023 Lawrence D. Kern /////////////////////////////////////// */
 /* /////////////////////////////////////////////////////////////////////////// */
 
+#include <stdbool.h>
 #include <stdint.h>
 
+#if defined(__aarch64__) || defined(_M_ARM64)
+#  define PLATFORM_ARM64 1
+#  include <arm_neon.h>
+#  if defined(_MSC_VER)
+#     include <intrin.h>
+#  else
+#     include <arm_acle.h>
+#  endif
+#  if defined(__linux__)
+#     include <sys/auxv.h>
+#  elif defined(_WIN32)
+#     include <windows.h>
+#  endif
+#elif defined(__x86_64__) || defined(_M_X64)
+#  define PLATFORM_X64 1
+#  if defined(_MSC_VER)
+#     include <intrin.h>
+#  else
+#     include <cpuid.h>
+#     include <x86intrin.h>
+#  endif
+#endif
+
+// NOTE(law): Code paths that use instructions beyond the compiler's baseline
+// target are marked with PLATFORM_TARGET. MSVC makes every intrinsic available
+// regardless of the target, so the attribute is only needed for GCC/Clang. It
+// is up to the caller to check platform_query_cpu_features() before actually
+// executing one of these functions.
+
+#if defined(__GNUC__) || defined(__clang__)
+#  define PLATFORM_TARGET(features) __attribute__((target(features)))
+#else
+#  define PLATFORM_TARGET(features)
+#endif
+
+#if defined(_MSC_VER)
+#  define PLATFORM_THREAD_LOCAL __declspec(thread)
+#else
+#  define PLATFORM_THREAD_LOCAL __thread
+#endif
+
 static uint64_t
 platform_cpu_timestamp_counter(void)
 {
@@ -19,5 +61,118 @@ platform_cpu_timestamp_counter(void)
    return result;
 }
 
+// NOTE(law): Fences for code that shares memory between threads without a lock
+// (e.g. seqlocks). An acquire fence keeps later loads and stores from moving
+// above earlier loads, and a release fence keeps earlier loads and stores from
+// moving below later stores. x64 already guarantees both orderings in
+// hardware, so MSVC only needs a compiler barrier there.
+
+#if defined(_MSC_VER)
+#  if defined(PLATFORM_ARM64)
+#     define platform_acquire_fence() __dmb(_ARM64_BARRIER_ISH)
+#     define platform_release_fence() __dmb(_ARM64_BARRIER_ISH)
+#     define platform_spin_pause() __yield()
+#  else
+#     define platform_acquire_fence() _ReadWriteBarrier()
+#     define platform_release_fence() _ReadWriteBarrier()
+#     define platform_spin_pause() _mm_pause()
+#  endif
+#else
+#  define platform_acquire_fence() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#  define platform_release_fence() __atomic_thread_fence(__ATOMIC_RELEASE)
+#  if defined(PLATFORM_ARM64)
+#     define platform_spin_pause() __asm__ volatile("yield")
+#  elif defined(PLATFORM_X64)
+#     define platform_spin_pause() _mm_pause()
+#  else
+#     define platform_spin_pause()
+#  endif
+#endif
+
+typedef struct
+{
+   bool x86_sha;     // SHA-NI: sha256rnds2, sha256msg1, sha256msg2
+   bool x86_sse42;   // SSE4.2: crc32
+   bool x86_avx2;    // 256-bit integer vectors (and OS support for saving them)
+   bool x86_avx512f; // 512-bit integer vectors (and OS support for saving them)
+   bool arm_sha2;    // ARMv8 crypto: sha256h, sha256h2, sha256su0, sha256su1
+   bool arm_crc32;   // ARMv8 CRC32: crc32cb, crc32ch, crc32cw, crc32cx
+} Platform_Cpu_Features;
+
+#if defined(PLATFORM_X64)
+static void
+platform_x86_cpuid(uint32_t leaf, uint32_t subleaf, uint32_t *registers)
+{
+#if defined(_MSC_VER)
+   __cpuidex((int *)registers, (int)leaf, (int)subleaf);
+#else
+   __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+static uint64_t
+platform_x86_xgetbv(uint32_t index)
+{
+#if defined(_MSC_VER)
+   uint64_t result = _xgetbv(index);
+#else
+   uint32_t low, high;
+   __asm__ volatile("xgetbv" : "=a" (low), "=d" (high) : "c" (index));
+   uint64_t result = ((uint64_t)high << 32) | low;
+#endif
+
+   return result;
+}
+#endif
+
+static Platform_Cpu_Features
+platform_query_cpu_features(void)
+{
+   Platform_Cpu_Features result = {0};
+
+#if defined(PLATFORM_X64)
+   uint32_t registers[4] = {0}; // eax, ebx, ecx, edx
+
+   platform_x86_cpuid(0, 0, registers);
+   uint32_t max_leaf = registers[0];
+
+   platform_x86_cpuid(1, 0, registers);
+   bool has_ssse3 = (registers[2] >> 9) & 1;
+   bool has_sse41 = (registers[2] >> 19) & 1;
+   result.x86_sse42 = (registers[2] >> 20) & 1;
+   bool has_osxsave = (registers[2] >> 27) & 1;
+
+   // NOTE(law): The wide vector registers are only usable if the OS saves them
+   // on context switches, which is reported through XCR0.
+   uint64_t xcr0 = (has_osxsave) ? platform_x86_xgetbv(0) : 0;
+   bool os_saves_ymm = (xcr0 & 0x06) == 0x06;
+   bool os_saves_zmm = (xcr0 & 0xe6) == 0xe6;
+
+   if(max_leaf >= 7)
+   {
+      platform_x86_cpuid(7, 0, registers);
+      result.x86_sha = ((registers[1] >> 29) & 1) && has_ssse3 && has_sse41;
+      result.x86_avx2 = ((registers[1] >> 5) & 1) && os_saves_ymm;
+      result.x86_avx512f = ((registers[1] >> 16) & 1) && os_saves_zmm && result.x86_avx2;
+   }
+#elif defined(PLATFORM_ARM64)
+#  if defined(__linux__)
+   // NOTE(law): HWCAP_SHA2 and HWCAP_CRC32 from <asm/hwcap.h>.
+   result.arm_sha2 = (getauxval(AT_HWCAP) & (1 << 6)) != 0;
+   result.arm_crc32 = (getauxval(AT_HWCAP) & (1 << 7)) != 0;
+#  elif defined(__APPLE__)
+   // NOTE(law): Every Apple arm64 core implements the crypto and CRC32
+   // extensions.
+   result.arm_sha2 = true;
+   result.arm_crc32 = true;
+#  elif defined(_WIN32)
+   result.arm_sha2 = IsProcessorFeaturePresent(PF_ARM_V8_CRYPTO_INSTRUCTIONS_AVAILABLE);
+   result.arm_crc32 = IsProcessorFeaturePresent(PF_ARM_V8_CRC32_INSTRUCTIONS_AVAILABLE);
+#  endif
+#endif
+
+   return result;
+}
+
 #define PLATFORM_INTRINSICS_H
 #endif
@@ -5,6 +5,7 @@
 #include <fcntl.h>
 #include <pthread.h>
 #include <semaphore.h>
+#include <signal.h>
 #include <sys/mman.h>
 #include <sys/random.h>
 #include <sys/stat.h>
@@ -13,6 +14,7 @@
 #include <errno.h>
 #include <stdarg.h>
 #include <string.h>
+#include <time.h>
 
 typedef struct Platform_Semaphore
 {
@@ -20,9 +22,29 @@ typedef struct Platform_Semaphore
    sem_t handle;
 } Platform_Semaphore;
 
+typedef struct Platform_File_Handle
+{
+   volatile int in_use;
+   int descriptor;
+   char *file_name;
+} Platform_File_Handle;
+
 #include "bsp.h"
 #include "platform.h"
 
+typedef struct Platform_Work_Queue
+{
+   pthread_mutex_t mutex;
+   pthread_cond_t entry_added;
+   pthread_cond_t entry_removed;
+   pthread_cond_t entry_completed;
+
+   unsigned int max_entry_count;
+   unsigned int entry_count;
+   unsigned int read_index;
+   Platform_Work_Entry **entries;
+} Platform_Work_Queue;
+
 extern
 PLATFORM_LOG_MESSAGE(platform_log_message)
 {
@@ -58,41 +80,203 @@ PLATFORM_LOG_MESSAGE(platform_log_message)
    }
 }
 
-extern
-PLATFORM_ALLOCATE(platform_allocate)
+static void *
+platform_map_memory(size_t size)
 {
-   // NOTE(law): munmap() requires the size of the allocation in order to free
-   // the virtual memory. This function smuggles the allocation size just before
-   // the address that it actually returns.
+   void *result = mmap(0, size, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE, -1, 0);
+   if(result == MAP_FAILED)
+   {
+      platform_log_message("[ERROR] Failed to allocate virtual memory.");
+      result = 0;
+   }
 
-   size_t allocation_size = size + sizeof(size_t);
-   void *allocation = mmap(0, allocation_size, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_PRIVATE, -1, 0);
+   return result;
+}
 
-   if(allocation == MAP_FAILED)
+static void
+platform_unmap_memory(void *memory, size_t size)
+{
+   if(munmap(memory, size) != 0)
+   {
+      platform_log_message("[ERROR] Failed to deallocate virtual memory.");
+   }
+}
+
+#define LINUX_HUGE_PAGE_SIZE MEBIBYTES(2)
+
+static bool
+linux_transparent_huge_pages_enabled(void)
+{
+   // NOTE(law): MADV_HUGEPAGE succeeds even if transparent huge pages are
+   // turned off system wide, so check the setting itself, which reads as
+   // "always [madvise] never" with the current mode in brackets.
+
+   static volatile int enabled = -1;
+   if(enabled < 0)
+   {
+      char setting[128] = {0};
+
+      int file = open("/sys/kernel/mm/transparent_hugepage/enabled", O_RDONLY);
+      if(file >= 0)
+      {
+         read(file, setting, sizeof(setting) - 1);
+         close(file);
+      }
+
+      enabled = (strstr(setting, "[always]") || strstr(setting, "[madvise]")) ? 1 : 0;
+   }
+
+   bool result = (enabled == 1);
+   return result;
+}
+
+static void *
+linux_map_aligned(size_t size, int protection, int flags, size_t alignment)
+{
+   // NOTE(law): Transparent huge pages only back ranges aligned to the huge
+   // page size, which mmap() doesn't guarantee. Map a little extra and unmap
+   // whatever sits outside the aligned range.
+
+   size = (size + 4095) & ~(size_t)4095;
+
+   unsigned char *mapping = mmap(0, size + alignment, protection, flags, -1, 0);
+   if(mapping == MAP_FAILED)
    {
-      platform_log_message("[ERROR] Failed to allocate virtual memory.");
       return 0;
    }
 
-   *(size_t *)allocation = allocation_size;
+   uintptr_t address = ((uintptr_t)mapping + alignment - 1) & ~(uintptr_t)(alignment - 1);
+   unsigned char *result = (unsigned char *)address;
+
+   size_t head = result - mapping;
+   size_t tail = alignment - head;
+   if(head)
+   {
+      munmap(mapping, head);
+   }
+   if(tail)
+   {
+      munmap(result + size, tail);
+   }
+
+   return result;
+}
+
+extern
+PLATFORM_RESERVE_MEMORY(platform_reserve_memory)
+{
+   // NOTE(law): MAP_NORESERVE keeps the reservation from counting against the
+   // system's commit limit until pages are actually committed. Explicit huge
+   // pages would have to be set aside up front, so a reservation can only get
+   // transparent ones.
+
+   int map_flags = MAP_ANONYMOUS|MAP_PRIVATE|MAP_NORESERVE;
+
+   void *result = 0;
+   *backing = PAGE_BACKING_SMALL;
+
+   if((flags & PLATFORM_MEMORY_HUGE_PAGES) && size >= LINUX_HUGE_PAGE_SIZE && linux_transparent_huge_pages_enabled())
+   {
+      result = linux_map_aligned(size, PROT_NONE, map_flags, LINUX_HUGE_PAGE_SIZE);
+      if(result && madvise(result, size, MADV_HUGEPAGE) == 0)
+      {
+         *backing = PAGE_BACKING_TRANSPARENT_HUGE;
+      }
+   }
+
+   if(!result)
+   {
+      result = mmap(0, size, PROT_NONE, map_flags, -1, 0);
+      if(result == MAP_FAILED)
+      {
+         platform_log_message("[ERROR] Failed to reserve virtual memory.");
+         result = 0;
+      }
+   }
 
-   void *result = (void *)((unsigned char *)allocation + sizeof(size_t));
    return result;
 }
 
 extern
-PLATFORM_DEALLOCATE(platform_deallocate)
+PLATFORM_ALLOCATE_PAGES(platform_allocate_pages)
 {
-   // NOTE(law): munmap() requires the size of the allocation in order to free
-   // the virtual memory. We always just want to dump the entire thing, so
-   // allocate() hides the allocation size just before the address it returns.
+   // NOTE(law): Explicit huge pages come out of the pool set aside with
+   // vm.nr_hugepages, and are reserved when the mapping is made, so an empty
+   // pool fails here rather than at first touch. Transparent huge pages are
+   // the next best thing.
 
-   void *allocation = (void *)((unsigned char *)memory - sizeof(size_t));
-   size_t allocation_size = *(size_t *)allocation;
+   int map_flags = MAP_ANONYMOUS|MAP_PRIVATE;
 
-   if(munmap(allocation, allocation_size) != 0)
+   void *result = 0;
+   *backing = PAGE_BACKING_SMALL;
+
+   if((flags & PLATFORM_MEMORY_HUGE_PAGES) && size >= LINUX_HUGE_PAGE_SIZE)
    {
-      platform_log_message("[ERROR] Failed to deallocate virtual memory.");
+      size_t huge_size = (size + LINUX_HUGE_PAGE_SIZE - 1) & ~(size_t)(LINUX_HUGE_PAGE_SIZE - 1);
+
+      result = mmap(0, huge_size, PROT_READ|PROT_WRITE, map_flags|MAP_HUGETLB, -1, 0);
+      if(result != MAP_FAILED)
+      {
+         *backing = PAGE_BACKING_HUGE;
+      }
+      else
+      {
+         result = 0;
+         if(linux_transparent_huge_pages_enabled())
+         {
+            result = linux_map_aligned(huge_size, PROT_READ|PROT_WRITE, map_flags, LINUX_HUGE_PAGE_SIZE);
+            if(result && madvise(result, huge_size, MADV_HUGEPAGE) == 0)
+            {
+               *backing = PAGE_BACKING_TRANSPARENT_HUGE;
+            }
+         }
+      }
+   }
+
+   if(!result)
+   {
+      result = mmap(0, size, PROT_READ|PROT_WRITE, map_flags, -1, 0);
+      if(result == MAP_FAILED)
+      {
+         platform_log_message("[ERROR] Failed to allocate virtual memory.");
+         result = 0;
+      }
+   }
+
+   return result;
+}
+
+extern
+PLATFORM_COMMIT_MEMORY(platform_commit_memory)
+{
+   bool result = (mprotect(memory, size, PROT_READ|PROT_WRITE) == 0);
+   if(!result)
+   {
+      platform_log_message("[ERROR] Failed to commit virtual memory.");
+   }
+
+   return result;
+}
+
+extern
+PLATFORM_DECOMMIT_MEMORY(platform_decommit_memory)
+{
+   // NOTE(law): MADV_DONTNEED drops the pages right away (and they read back
+   // as zeros), where MADV_FREE would leave them resident until the system is
+   // under memory pressure. The range goes back to being reserved only.
+
+   if(madvise(memory, size, MADV_DONTNEED) != 0 || mprotect(memory, size, PROT_NONE) != 0)
+   {
+      platform_log_message("[ERROR] Failed to decommit virtual memory.");
+   }
+}
+
+extern
+PLATFORM_RELEASE_MEMORY(platform_release_memory)
+{
+   if(munmap(memory, size) != 0)
+   {
+      platform_log_message("[ERROR] Failed to release virtual memory.");
    }
 }
 
@@ -151,6 +335,48 @@ PLATFORM_READ_FILE(platform_read_file)
    return result;
 }
 
+extern
+PLATFORM_MAP_FILE(platform_map_file)
+{
+   Platform_File result = {0};
+
+   int file = open(file_name, O_RDONLY);
+   if(file >= 0)
+   {
+      struct stat file_information;
+      if(fstat(file, &file_information) == 0)
+      {
+         size_t size = file_information.st_size;
+         if(size > 0)
+         {
+            void *memory = mmap(0, size, PROT_READ|PROT_WRITE, MAP_PRIVATE, file, 0);
+            if(memory != MAP_FAILED)
+            {
+               result.memory = memory;
+               result.size = size;
+            }
+            else
+            {
+               platform_log_message("[ERROR] (%d) Failed to map file: %s.", errno, file_name);
+            }
+         }
+      }
+      else
+      {
+         platform_log_message("[ERROR] Failed to read file size of file: %s.", file_name);
+      }
+
+      // NOTE(law): The mapping holds its own reference to the file.
+      close(file);
+   }
+   else
+   {
+      platform_log_message("[ERROR] Failed to open file: %s.", file_name);
+   }
+
+   return result;
+}
+
 extern
 PLATFORM_APPEND_FILE(platform_append_file)
 {
@@ -178,32 +404,231 @@ PLATFORM_APPEND_FILE(platform_append_file)
 }
 
 extern
-PLATFORM_GENERATE_RANDOM_BYTES(platform_generate_random_bytes)
+PLATFORM_DELETE_FILE(platform_delete_file)
 {
-   memset(destination, 0, size);
+   bool result = (unlink(file_name) == 0);
+   if(!result)
+   {
+      platform_log_message("[ERROR] (%d) Failed to delete file: \"%s\".", errno, file_name);
+   }
 
-   int file = open("/dev/urandom", O_RDONLY);
-   if(file >= 0)
+   return result;
+}
+
+static Platform_File_Handle linux_global_file_handles[32];
+
+extern
+PLATFORM_OPEN_FILE(platform_open_file)
+{
+   Platform_File_Handle *result = 0;
+
+   int file = open(file_name, O_CREAT|O_RDWR, 0666);
+   if(file != -1)
    {
-      ssize_t bytes_generated = read(file, destination, size);
-      if(bytes_generated < 0)
+      for(unsigned int index = 0; index < ARRAY_LENGTH(linux_global_file_handles); ++index)
       {
-         if(bytes_generated < 0)
+         Platform_File_Handle *handle = linux_global_file_handles + index;
+         if(!handle->in_use && __sync_bool_compare_and_swap(&handle->in_use, 0, 1))
          {
-            platform_log_message("[ERROR] Failed to generate a random number.");
+            result = handle;
+            break;
          }
-         else if(bytes_generated < size)
+      }
+      ASSERT(result);
+
+      result->descriptor = file;
+      result->file_name = file_name;
+   }
+   else
+   {
+      platform_log_message("[ERROR] (%d) Failed to open file: \"%s\".", errno, file_name);
+   }
+
+   return result;
+}
+
+extern
+PLATFORM_CLOSE_FILE(platform_close_file)
+{
+   close(file->descriptor);
+
+   __sync_synchronize();
+   file->in_use = 0;
+}
+
+static void
+linux_sync_directory(char *file_name)
+{
+   // NOTE(law): A rename is only durable once the directory holding the file
+   // has been synced as well.
+
+   char directory_name[256] = ".";
+   char *separator = strrchr(file_name, '/');
+   if(separator && (size_t)(separator - file_name) < sizeof(directory_name))
+   {
+      size_t length = (separator == file_name) ? 1 : (size_t)(separator - file_name);
+      memcpy(directory_name, file_name, length);
+      directory_name[length] = 0;
+   }
+
+   int directory = open(directory_name, O_RDONLY|O_DIRECTORY);
+   if(directory != -1)
+   {
+      fsync(directory);
+      close(directory);
+   }
+   else
+   {
+      platform_log_message("[WARNING] (%d) Failed to open directory: \"%s\".", errno, directory_name);
+   }
+}
+
+extern
+PLATFORM_REPLACE_FILE(platform_replace_file)
+{
+   // NOTE(law): The old descriptor is kept until the rename succeeds, so the
+   // handle is never left without a file.
+
+   bool result = false;
+
+   if(rename(source_file_name, file->file_name) == 0)
+   {
+      linux_sync_directory(file->file_name);
+
+      int replacement = open(file->file_name, O_CREAT|O_RDWR, 0666);
+      if(replacement != -1)
+      {
+         close(file->descriptor);
+         file->descriptor = replacement;
+         result = true;
+      }
+      else
+      {
+         platform_log_message("[ERROR] (%d) Failed to reopen file: \"%s\".", errno, file->file_name);
+      }
+   }
+   else
+   {
+      platform_log_message("[ERROR] (%d) Failed to rename \"%s\" to \"%s\".", errno, source_file_name, file->file_name);
+   }
+
+   return result;
+}
+
+extern
+PLATFORM_WRITE_FILE_HANDLE(platform_write_file_handle)
+{
+   bool result = true;
+
+   unsigned char *bytes = (unsigned char *)memory;
+   while(size > 0)
+   {
+      ssize_t bytes_written = pwrite(file->descriptor, bytes, size, (off_t)offset);
+      if(bytes_written < 0)
+      {
+         if(errno != EINTR)
          {
-            platform_log_message("[WARNING] Only generated %ld of requested %ld bytes.", bytes_generated, size);
+            platform_log_message("[ERROR] (%d) Failed to write file: \"%s\".", errno, file->file_name);
+            result = false;
+            break;
          }
       }
+      else
+      {
+         bytes += bytes_written;
+         offset += bytes_written;
+         size -= bytes_written;
+      }
    }
-   else
+
+   return result;
+}
+
+extern
+PLATFORM_READ_FILE_HANDLE(platform_read_file_handle)
+{
+   size_t result = 0;
+
+   unsigned char *bytes = (unsigned char *)memory;
+   while(result < size)
    {
-      platform_log_message("[ERROR] Failed to open /dev/urandom.");
+      ssize_t bytes_read = pread(file->descriptor, bytes + result, size - result, (off_t)(offset + result));
+      if(bytes_read < 0)
+      {
+         if(errno != EINTR)
+         {
+            platform_log_message("[ERROR] (%d) Failed to read file: \"%s\".", errno, file->file_name);
+            break;
+         }
+      }
+      else if(bytes_read == 0)
+      {
+         break;
+      }
+      else
+      {
+         result += bytes_read;
+      }
+   }
+
+   return result;
+}
+
+extern
+PLATFORM_SYNC_FILE(platform_sync_file)
+{
+   bool result = (fdatasync(file->descriptor) == 0);
+   if(!result)
+   {
+      platform_log_message("[ERROR] (%d) Failed to sync file: \"%s\".", errno, file->file_name);
+   }
+
+   return result;
+}
+
+extern
+PLATFORM_TRUNCATE_FILE(platform_truncate_file)
+{
+   bool result = (ftruncate(file->descriptor, (off_t)size) == 0);
+   if(!result)
+   {
+      platform_log_message("[ERROR] (%d) Failed to truncate file: \"%s\".", errno, file->file_name);
+   }
+
+   return result;
+}
+
+static bool
+platform_read_entropy(void *destination, size_t size)
+{
+   bool result = true;
+
+   unsigned char *bytes = (unsigned char *)destination;
+   while(size > 0)
+   {
+      ssize_t bytes_generated = getrandom(bytes, size, 0);
+      if(bytes_generated < 0)
+      {
+         if(errno != EINTR)
+         {
+            platform_log_message("[ERROR] (%d) Failed to read entropy from getrandom.", errno);
+            result = false;
+            break;
+         }
+      }
+      else
+      {
+         bytes += bytes_generated;
+         size -= bytes_generated;
+      }
    }
+
+   return result;
 }
 
+#include "platform_random.c"
+#include "platform_allocator.c"
+
 static unsigned int linux_global_semaphore_count;
 static Platform_Semaphore linux_global_semaphores[128];
 
@@ -237,6 +662,133 @@ PLATFORM_UNLOCK(platform_unlock)
    }
 }
 
+static void *
+linux_launch_work_thread(void *data)
+{
+   Platform_Work_Queue *queue = (Platform_Work_Queue *)data;
+
+   while(true)
+   {
+      pthread_mutex_lock(&queue->mutex);
+      while(queue->entry_count == 0)
+      {
+         pthread_cond_wait(&queue->entry_added, &queue->mutex);
+      }
+
+      Platform_Work_Entry *entry = queue->entries[queue->read_index];
+      queue->read_index = (queue->read_index + 1) % queue->max_entry_count;
+      queue->entry_count--;
+
+      pthread_cond_signal(&queue->entry_removed);
+      pthread_mutex_unlock(&queue->mutex);
+
+      entry->callback(entry->data);
+
+      pthread_mutex_lock(&queue->mutex);
+      entry->completed = true;
+      pthread_cond_broadcast(&queue->entry_completed);
+      pthread_mutex_unlock(&queue->mutex);
+   }
+
+   return 0;
+}
+
+static unsigned int linux_global_work_queue_count;
+static Platform_Work_Queue linux_global_work_queues[4];
+
+extern
+PLATFORM_INITIALIZE_WORK_QUEUE(platform_initialize_work_queue)
+{
+   ASSERT(linux_global_work_queue_count < ARRAY_LENGTH(linux_global_work_queues));
+   ASSERT(thread_count > 0);
+   ASSERT(max_entry_count > 0);
+
+   Platform_Work_Queue *result = linux_global_work_queues + linux_global_work_queue_count++;
+
+   pthread_mutex_init(&result->mutex, 0);
+   pthread_cond_init(&result->entry_added, 0);
+   pthread_cond_init(&result->entry_removed, 0);
+   pthread_cond_init(&result->entry_completed, 0);
+
+   result->max_entry_count = max_entry_count;
+   result->entry_count = 0;
+   result->read_index = 0;
+   result->entries = platform_allocate(max_entry_count * sizeof(*result->entries));
+   if(!result->entries)
+   {
+      platform_log_message("[ERROR] Failed to allocate work queue entries.");
+      return 0;
+   }
+
+   for(unsigned int index = 0; index < thread_count; ++index)
+   {
+      pthread_t id;
+      if(pthread_create(&id, 0, linux_launch_work_thread, (void *)result) == 0)
+      {
+         pthread_detach(id);
+      }
+      else
+      {
+         platform_log_message("[ERROR] Failed to launch work thread %u.", index);
+      }
+   }
+
+   return result;
+}
+
+extern
+PLATFORM_SUBMIT_WORK(platform_submit_work)
+{
+   entry->completed = false;
+
+   pthread_mutex_lock(&queue->mutex);
+   while(queue->entry_count == queue->max_entry_count)
+   {
+      pthread_cond_wait(&queue->entry_removed, &queue->mutex);
+   }
+
+   unsigned int result = queue->entry_count;
+
+   unsigned int write_index = (queue->read_index + queue->entry_count) % queue->max_entry_count;
+   queue->entries[write_index] = entry;
+   queue->entry_count++;
+
+   pthread_cond_signal(&queue->entry_added);
+   pthread_mutex_unlock(&queue->mutex);
+
+   return result;
+}
+
+extern
+PLATFORM_WAIT_FOR_WORK(platform_wait_for_work)
+{
+   pthread_mutex_lock(&queue->mutex);
+   while(!entry->completed)
+   {
+      pthread_cond_wait(&queue->entry_completed, &queue->mutex);
+   }
+   pthread_mutex_unlock(&queue->mutex);
+}
+
+extern
+PLATFORM_COMPLETE_WORK(platform_complete_work)
+{
+   pthread_mutex_lock(&queue->mutex);
+   entry->completed = true;
+   pthread_cond_broadcast(&queue->entry_completed);
+   pthread_mutex_unlock(&queue->mutex);
+}
+
+extern
+PLATFORM_SLEEP(platform_sleep)
+{
+   struct timespec duration;
+   duration.tv_sec = microseconds / 1000000;
+   duration.tv_nsec = (microseconds % 1000000) * 1000;
+
+   while(nanosleep(&duration, &duration) == -1 && errno == EINTR);
+}
+
 static bool
 linux_accept_request(FCGX_Request *fcgx)
 {
@@ -257,8 +809,9 @@ linux_launch_request_thread(void *data)
 
    platform_log_message("Request thread %d launched.", thread.index);
 
-   size_t arena_size = MEBIBYTES(512);
-   unsigned char *base_address = platform_allocate(arena_size);
+   // NOTE(law): The arena is set up by the first request, and kept across
+   // requests.
+   Memory_Arena arena = {0};
 
    FCGX_Request fcgx;
    FCGX_InitRequest(&fcgx, 0, 0);
@@ -271,30 +824,66 @@ linux_launch_request_thread(void *data)
       platform_request.fcgx = fcgx;
       platform_request.request.thread = thread;
 
-      bsp_process_request(&platform_request.request, base_address, arena_size);
+      bsp_process_request(&platform_request.request, &arena);
 
       FCGX_Finish_r(&fcgx);
+
+      bsp_finish_request(&arena);
    }
 
-   platform_deallocate(base_address);
+   if(arena.base_address)
+   {
+      platform_release_memory(arena.base_address, arena.reserve_size);
+   }
 
    platform_log_message("Request thread %d terminated.", thread.index);
 
    return 0;
 }
 
+static sigset_t linux_global_backup_signals;
+
+static void *
+linux_wait_for_backup_signal(void *data)
+{
+   (void)data;
+
+   while(true)
+   {
+      int signal_number;
+      if(sigwait(&linux_global_backup_signals, &signal_number) == 0)
+      {
+         platform_log_message("Backup requested.");
+         bsp_backup_database();
+      }
+   }
+
+   return 0;
+}
+
 int
 main(int argument_count, char **arguments)
 {
    (void)argument_count;
    (void)arguments;
 
+   // NOTE(law): SIGUSR1 asks for a backup. It's blocked before any thread is
+   // started, so every thread inherits the mask, and the signal is only ever
+   // picked up by the thread waiting on it.
+   sigemptyset(&linux_global_backup_signals);
+   sigaddset(&linux_global_backup_signals, SIGUSR1);
+   pthread_sigmask(SIG_BLOCK, &linux_global_backup_signals, 0);
+
    // NOTE(law): Set the working directory up front to enable consistent access
    // to data assets (html, css, logs, etc.).
    chdir(STRINGIFY(WORKING_DIRECTORY));
 
    bsp_initialize_application();
 
+   pthread_t backup_thread;
+   pthread_create(&backup_thread, 0, linux_wait_for_backup_signal, 0);
+   pthread_detach(backup_thread);
+
    FCGX_Init();
 
    Thread_Context threads[REQUEST_THREAD_COUNT] = {0};
@@ -0,0 +1,178 @@
+/* /////////////////////////////////////////////////////////////////////////// */
+/* (c) copyright 2023 Lawrence D. Kern /////////////////////////////////////// */
+/* /////////////////////////////////////////////////////////////////////////// */
+
+// NOTE(law): A buffered ChaCha20 CSPRNG shared by the platform layers. Each
+// thread keeps its own generator, so random bytes are produced without a
+// syscall or a lock. The OS is only asked for entropy when a thread's generator
+// is first used, and again every PLATFORM_RANDOM_RESEED_INTERVAL bytes.
+//
+// After every refill the first 32 bytes of fresh output replace the key and are
+// wiped ("fast key erasure"), and bytes are wiped from the buffer as they are
+// handed out, so a snapshot of the state can't be used to recover earlier
+// output.
+//
+// The including platform layer supplies platform_read_entropy().
+
+#include <stdlib.h>
+
+#define PLATFORM_RANDOM_BLOCK_COUNT 16
+#define PLATFORM_RANDOM_RESEED_INTERVAL (1024 * 1024)
+#define PLATFORM_RANDOM_SEED_ATTEMPTS 8
+
+typedef struct
+{
+   bool seeded;
+   uint32_t key[8];
+   size_t bytes_until_reseed;
+
+   unsigned int buffer_index;
+   uint8_t buffer[64 * PLATFORM_RANDOM_BLOCK_COUNT];
+} Platform_Random_State;
+
+static PLATFORM_THREAD_LOCAL Platform_Random_State platform_thread_random;
+
+static bool platform_read_entropy(void *destination, size_t size);
+
+#define CHACHA20_ROTATE_LEFT(value, count) (((value) << (count)) | ((value) >> (32 - (count))))
+
+#define CHACHA20_QUARTER_ROUND(a, b, c, d)                               \
+   a += b; d ^= a; d = CHACHA20_ROTATE_LEFT(d, 16);                      \
+   c += d; b ^= c; b = CHACHA20_ROTATE_LEFT(b, 12);                      \
+   a += b; d ^= a; d = CHACHA20_ROTATE_LEFT(d, 8);                       \
+   c += d; b ^= c; b = CHACHA20_ROTATE_LEFT(b, 7);
+
+static void
+platform_chacha20_block(uint8_t *output, uint32_t *input)
+{
+   // NOTE(law): The ChaCha20 block function from RFC 8439. Input is the 16
+   // word state (constants, key, counter, nonce), output is 64 bytes of key
+   // stream.
+
+   uint32_t x[16];
+   for(unsigned int index = 0; index < 16; ++index)
+   {
+      x[index] = input[index];
+   }
+
+   for(unsigned int round = 0; round < 10; ++round)
+   {
+      CHACHA20_QUARTER_ROUND(x[0], x[4], x[ 8], x[12]);
+      CHACHA20_QUARTER_ROUND(x[1], x[5], x[ 9], x[13]);
+      CHACHA20_QUARTER_ROUND(x[2], x[6], x[10], x[14]);
+      CHACHA20_QUARTER_ROUND(x[3], x[7], x[11], x[15]);
+
+      CHACHA20_QUARTER_ROUND(x[0], x[5], x[10], x[15]);
+      CHACHA20_QUARTER_ROUND(x[1], x[6], x[11], x[12]);
+      CHACHA20_QUARTER_ROUND(x[2], x[7], x[ 8], x[13]);
+      CHACHA20_QUARTER_ROUND(x[3], x[4], x[ 9], x[14]);
+   }
+
+   for(unsigned int index = 0; index < 16; ++index)
+   {
+      uint32_t word = x[index] + input[index];
+      output[4*index + 0] = (uint8_t)(word >>  0);
+      output[4*index + 1] = (uint8_t)(word >>  8);
+      output[4*index + 2] = (uint8_t)(word >> 16);
+      output[4*index + 3] = (uint8_t)(word >> 24);
+   }
+}
+
+static void
+platform_refill_random_buffer(Platform_Random_State *random)
+{
+   if(!random->seeded || random->bytes_until_reseed == 0)
+   {
+      // NOTE(law): New entropy is mixed into the existing key rather than
+      // replacing it, so a failed read doesn't leave a reseeded thread worse
+      // off than it was. A thread that has never been seeded has nothing to
+      // fall back on, though: its key is all zeros, and any output would be
+      // predictable. In that case the read is retried, and if the OS still
+      // won't provide entropy the process is aborted rather than handing out
+      // session IDs and salts from a known key.
+      uint32_t entropy[8];
+      bool read = platform_read_entropy(entropy, sizeof(entropy));
+      for(unsigned int attempt = 0; !read && !random->seeded && attempt < PLATFORM_RANDOM_SEED_ATTEMPTS; ++attempt)
+      {
+         platform_sleep(1000);
+         read = platform_read_entropy(entropy, sizeof(entropy));
+      }
+
+      if(read)
+      {
+         for(unsigned int index = 0; index < 8; ++index)
+         {
+            random->key[index] ^= entropy[index];
+         }
+         random->seeded = true;
+      }
+      else if(random->seeded)
+      {
+         platform_log_message("[ERROR] Failed to reseed the random number generator.");
+      }
+      else
+      {
+         platform_log_message("[ERROR] Failed to seed the random number generator. Aborting.");
+         abort();
+      }
+
+      memset(entropy, 0, sizeof(entropy));
+      random->bytes_until_reseed = PLATFORM_RANDOM_RESEED_INTERVAL;
+   }
+
+   uint32_t input[16] =
+   {
+      0x61707865, 0x3320646e, 0x79622d32, 0x6b206574, // "expand 32-byte k"
+      random->key[0], random->key[1], random->key[2], random->key[3],
+      random->key[4], random->key[5], random->key[6], random->key[7],
+      0, 0, 0, 0, // Block counter and nonce.
+   };
+
+   for(unsigned int block = 0; block < PLATFORM_RANDOM_BLOCK_COUNT; ++block)
+   {
+      input[12] = block;
+      platform_chacha20_block(random->buffer + (64 * block), input);
+   }
+
+   for(unsigned int index = 0; index < 8; ++index)
+   {
+      uint8_t *bytes = random->buffer + (4 * index);
+      random->key[index] = ((uint32_t)bytes[0] << 0) | ((uint32_t)bytes[1] << 8) |
+                           ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+   }
+
+   memset(random->buffer, 0, sizeof(random->key));
+   memset(input, 0, sizeof(input));
+   random->buffer_index = sizeof(random->key);
+}
+
+extern
+PLATFORM_GENERATE_RANDOM_BYTES(platform_generate_random_bytes)
+{
+   Platform_Random_State *random = &platform_thread_random;
+
+   uint8_t *bytes = (uint8_t *)destination;
+   while(size > 0)
+   {
+      if(!random->seeded || random->buffer_index == sizeof(random->buffer))
+      {
+         platform_refill_random_buffer(random);
+      }
+
+      size_t count = sizeof(random->buffer) - random->buffer_index;
+      if(count > size)
+      {
+         count = size;
+      }
+
+      uint8_t *source = random->buffer + random->buffer_index;
+      memcpy(bytes, source, count);
+      memset(source, 0, count);
+
+      random->buffer_index += (unsigned int)count;
+      random->bytes_until_reseed -= (count < random->bytes_until_reseed) ? count : random->bytes_until_reseed;
+
+      bytes += count;
+      size -= count;
+   }
+}
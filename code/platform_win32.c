@@ -11,9 +11,29 @@ typedef struct Platform_Semaphore
    HANDLE handle;
 } Platform_Semaphore;
 
+typedef struct Platform_File_Handle
+{
+   volatile LONG in_use;
+   HANDLE handle;
+   char *file_name;
+} Platform_File_Handle;
+
 #include "bsp.h"
 #include "platform.h"
 
+typedef struct Platform_Work_Queue
+{
+   CRITICAL_SECTION lock;
+   CONDITION_VARIABLE entry_added;
+   CONDITION_VARIABLE entry_removed;
+   CONDITION_VARIABLE entry_completed;
+
+   unsigned int max_entry_count;
+   unsigned int entry_count;
+   unsigned int read_index;
+   Platform_Work_Entry **entries;
+} Platform_Work_Queue;
+
 static HANDLE win32_global_request_mutex;
 static HANDLE win32_global_log_mutex;
 
@@ -60,19 +80,106 @@ PLATFORM_LOG_MESSAGE(platform_log_message)
    ReleaseMutex(win32_global_log_mutex);
 }
 
-extern
-PLATFORM_ALLOCATE(platform_allocate)
+static void *
+platform_map_memory(size_t size)
 {
    void *result = VirtualAlloc(0, size, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+   if(!result)
+   {
+      platform_log_message("[ERROR] Failed to allocate virtual memory.");
+   }
+
+   return result;
+}
+
+static void
+platform_unmap_memory(void *memory, size_t size)
+{
+   (void)size;
+   if(!VirtualFree(memory, 0, MEM_RELEASE))
+   {
+      platform_log_message("[ERROR] Failed to free virtual memory.");
+   }
+}
+
+extern
+PLATFORM_RESERVE_MEMORY(platform_reserve_memory)
+{
+   // NOTE(law): Large pages have to be committed in the same call that
+   // reserves them, so a reservation always gets regular pages.
+   (void)flags;
+   *backing = PAGE_BACKING_SMALL;
+
+   void *result = VirtualAlloc(0, size, MEM_RESERVE, PAGE_NOACCESS);
+   if(!result)
+   {
+      platform_log_message("[ERROR] Failed to reserve virtual memory.");
+   }
+
    return result;
 }
 
 extern
-PLATFORM_DEALLOCATE(platform_deallocate)
+PLATFORM_ALLOCATE_PAGES(platform_allocate_pages)
 {
+   // NOTE(law): Large pages require the process to hold SeLockMemoryPrivilege,
+   // and otherwise fail outright.
+
+   void *result = 0;
+   *backing = PAGE_BACKING_SMALL;
+
+   size_t large_page_size = GetLargePageMinimum();
+   if((flags & PLATFORM_MEMORY_HUGE_PAGES) && large_page_size && size >= large_page_size)
+   {
+      size_t large_size = (size + large_page_size - 1) & ~(large_page_size - 1);
+
+      result = VirtualAlloc(0, large_size, MEM_RESERVE|MEM_COMMIT|MEM_LARGE_PAGES, PAGE_READWRITE);
+      if(result)
+      {
+         *backing = PAGE_BACKING_HUGE;
+      }
+   }
+
+   if(!result)
+   {
+      result = VirtualAlloc(0, size, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+      if(!result)
+      {
+         platform_log_message("[ERROR] Failed to allocate virtual memory.");
+      }
+   }
+
+   return result;
+}
+
+extern
+PLATFORM_COMMIT_MEMORY(platform_commit_memory)
+{
+   bool result = (VirtualAlloc(memory, size, MEM_COMMIT, PAGE_READWRITE) != 0);
+   if(!result)
+   {
+      platform_log_message("[ERROR] Failed to commit virtual memory.");
+   }
+
+   return result;
+}
+
+extern
+PLATFORM_DECOMMIT_MEMORY(platform_decommit_memory)
+{
+   if(!VirtualFree(memory, size, MEM_DECOMMIT))
+   {
+      platform_log_message("[ERROR] Failed to decommit virtual memory.");
+   }
+}
+
+extern
+PLATFORM_RELEASE_MEMORY(platform_release_memory)
+{
+   (void)size;
    if(!VirtualFree(memory, 0, MEM_RELEASE))
    {
-      OutputDebugStringA("Failed to free virtual memory.\n");
+      platform_log_message("[ERROR] Failed to release virtual memory.");
    }
 }
 
@@ -81,10 +188,7 @@ PLATFORM_FREE_FILE(platform_free_file)
 {
    if(file->memory)
    {
-      if(!VirtualFree(file->memory, 0, MEM_RELEASE))
-      {
-         platform_log_message("[ERROR] Failed to free virtual memory.");
-      }
+      platform_deallocate(file->memory);
    }
 
    ZeroMemory(file, sizeof(*file));
@@ -138,6 +242,73 @@ PLATFORM_READ_FILE(platform_read_file)
    return result;
 }
 
+extern
+PLATFORM_MAP_FILE(platform_map_file)
+{
+   Platform_File result = {0};
+
+   HANDLE file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, 0,
+                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+   if(file == INVALID_HANDLE_VALUE)
+   {
+      platform_log_message("[ERROR] Failed to open file: %s.", file_name);
+      return result;
+   }
+
+   // NOTE(law): Windows won't rename a file over one that has a view mapped,
+   // which would keep platform_replace_file() from ever swapping in a
+   // compacted table. So rather than mapping the file, it's read into private
+   // pages, which still behave the same way: writes to them never reach the
+   // file, and they last for the life of the process. They just aren't shared
+   // with the page cache.
+
+   LARGE_INTEGER size;
+   if(GetFileSizeEx(file, &size))
+   {
+      if(size.QuadPart > 0)
+      {
+         unsigned char *memory = VirtualAlloc(0, (size_t)size.QuadPart, MEM_RESERVE|MEM_COMMIT, PAGE_READWRITE);
+         if(memory)
+         {
+            size_t offset = 0;
+            while(offset < (size_t)size.QuadPart)
+            {
+               DWORD read_size = (DWORD)MINIMUM((size_t)size.QuadPart - offset, (size_t)GIBIBYTES(1));
+               DWORD bytes_read;
+               if(!ReadFile(file, memory + offset, read_size, &bytes_read, 0) || bytes_read != read_size)
+               {
+                  break;
+               }
+               offset += bytes_read;
+            }
+
+            if(offset == (size_t)size.QuadPart)
+            {
+               result.memory = memory;
+               result.size = (size_t)size.QuadPart;
+            }
+            else
+            {
+               platform_log_message("[ERROR] Failed to read file: %s.", file_name);
+               VirtualFree(memory, 0, MEM_RELEASE);
+            }
+         }
+         else
+         {
+            platform_log_message("[ERROR] Failed to allocate memory for file: %s.", file_name);
+         }
+      }
+   }
+   else
+   {
+      platform_log_message("[ERROR] Failed to read size of file: %s.", file_name);
+   }
+
+   CloseHandle(file);
+
+   return result;
+}
+
 extern
 PLATFORM_APPEND_FILE(platform_append_file)
 {
@@ -167,6 +338,164 @@ PLATFORM_APPEND_FILE(platform_append_file)
    return result;
 }
 
+extern
+PLATFORM_DELETE_FILE(platform_delete_file)
+{
+   bool result = (DeleteFileA(file_name) != 0);
+   if(!result)
+   {
+      platform_log_message("[ERROR] Failed to delete file: \"%s\".", file_name);
+   }
+
+   return result;
+}
+
+static Platform_File_Handle win32_global_file_handles[32];
+
+static HANDLE
+win32_open_file_for_handle(char *file_name)
+{
+   // NOTE(law): Delete sharing lets platform_replace_file() rename over a file
+   // that other handles still have open.
+   HANDLE result = CreateFileA(file_name, GENERIC_READ|GENERIC_WRITE, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
+                               0, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+   return result;
+}
+
+extern
+PLATFORM_OPEN_FILE(platform_open_file)
+{
+   Platform_File_Handle *result = 0;
+
+   HANDLE file = win32_open_file_for_handle(file_name);
+   if(file != INVALID_HANDLE_VALUE)
+   {
+      for(unsigned int index = 0; index < ARRAY_LENGTH(win32_global_file_handles); ++index)
+      {
+         Platform_File_Handle *handle = win32_global_file_handles + index;
+         if(!handle->in_use && InterlockedCompareExchange(&handle->in_use, 1, 0) == 0)
+         {
+            result = handle;
+            break;
+         }
+      }
+      ASSERT(result);
+
+      result->handle = file;
+      result->file_name = file_name;
+   }
+   else
+   {
+      platform_log_message("[ERROR] Failed to open file: \"%s\".", file_name);
+   }
+
+   return result;
+}
+
+extern
+PLATFORM_CLOSE_FILE(platform_close_file)
+{
+   CloseHandle(file->handle);
+   InterlockedExchange(&file->in_use, 0);
+}
+
+extern
+PLATFORM_REPLACE_FILE(platform_replace_file)
+{
+   bool result = false;
+
+   CloseHandle(file->handle);
+   if(MoveFileExA(source_file_name, file->file_name, MOVEFILE_REPLACE_EXISTING|MOVEFILE_WRITE_THROUGH))
+   {
+      result = true;
+   }
+   else
+   {
+      platform_log_message("[ERROR] Failed to rename \"%s\" to \"%s\".", source_file_name, file->file_name);
+   }
+
+   file->handle = win32_open_file_for_handle(file->file_name);
+   if(file->handle == INVALID_HANDLE_VALUE)
+   {
+      platform_log_message("[ERROR] Failed to reopen file: \"%s\".", file->file_name);
+      result = false;
+   }
+
+   return result;
+}
+
+extern
+PLATFORM_WRITE_FILE_HANDLE(platform_write_file_handle)
+{
+   bool result = false;
+
+   OVERLAPPED position = {0};
+   position.Offset = (DWORD)(offset & 0xFFFFFFFF);
+   position.OffsetHigh = (DWORD)((unsigned long long)offset >> 32);
+
+   DWORD bytes_written;
+   BOOL success = WriteFile(file->handle, memory, (DWORD)size, &bytes_written, &position);
+   if(success && bytes_written == size)
+   {
+      result = true;
+   }
+   else
+   {
+      platform_log_message("[ERROR] Failed to write file: \"%s\".", file->file_name);
+   }
+
+   return result;
+}
+
+extern
+PLATFORM_READ_FILE_HANDLE(platform_read_file_handle)
+{
+   size_t result = 0;
+
+   OVERLAPPED position = {0};
+   position.Offset = (DWORD)(offset & 0xFFFFFFFF);
+   position.OffsetHigh = (DWORD)((unsigned long long)offset >> 32);
+
+   DWORD bytes_read;
+   if(ReadFile(file->handle, memory, (DWORD)size, &bytes_read, &position))
+   {
+      result = bytes_read;
+   }
+   else if(GetLastError() != ERROR_HANDLE_EOF)
+   {
+      platform_log_message("[ERROR] Failed to read file: \"%s\".", file->file_name);
+   }
+
+   return result;
+}
+
+extern
+PLATFORM_SYNC_FILE(platform_sync_file)
+{
+   bool result = FlushFileBuffers(file->handle);
+   if(!result)
+   {
+      platform_log_message("[ERROR] Failed to sync file: \"%s\".", file->file_name);
+   }
+
+   return result;
+}
+
+extern
+PLATFORM_TRUNCATE_FILE(platform_truncate_file)
+{
+   LARGE_INTEGER position;
+   position.QuadPart = (LONGLONG)size;
+
+   bool result = SetFilePointerEx(file->handle, position, 0, FILE_BEGIN) && SetEndOfFile(file->handle);
+   if(!result)
+   {
+      platform_log_message("[ERROR] Failed to truncate file: \"%s\".", file->file_name);
+   }
+
+   return result;
+}
+
 static HCRYPTPROV win32_global_cryptography_handle;
 
 static void
@@ -180,18 +509,21 @@ win32_initialize_random_number_generator(void)
    }
 }
 
-extern
-PLATFORM_GENERATE_RANDOM_BYTES(platform_generate_random_bytes)
+static bool
+platform_read_entropy(void *destination, size_t size)
 {
-   SecureZeroMemory(destination, size);
-
-   BOOL succeeded = CryptGenRandom(win32_global_cryptography_handle, (DWORD)size, destination);
-   if(!succeeded)
+   BOOL result = CryptGenRandom(win32_global_cryptography_handle, (DWORD)size, destination);
+   if(!result)
    {
-      platform_log_message("[ERROR] Failed to generate a random number.");
+      platform_log_message("[ERROR] Failed to read entropy from CryptGenRandom.");
    }
+
+   return result;
 }
 
+#include "platform_random.c"
+#include "platform_allocator.c"
+
 static unsigned int win32_global_semaphore_count;
 static Platform_Semaphore win32_global_semaphores[128];
 
@@ -202,7 +534,8 @@ PLATFORM_INITIALIZE_SEMAPHORE(platform_initialize_semaphore)
    struct Platform_Semaphore *result = win32_global_semaphores + win32_global_semaphore_count++;
 
    result->count = 0;
-   result->handle = CreateSemaphoreA(0, 0, REQUEST_THREAD_COUNT, 0);
+   // NOTE(law): The extra count is for the database log thread.
+   result->handle = CreateSemaphoreA(0, 0, REQUEST_THREAD_COUNT + KDF_THREAD_COUNT + DATABASE_THREAD_COUNT + 1, 0);
 
    return result;
 }
@@ -225,6 +558,128 @@ PLATFORM_UNLOCK(platform_unlock)
    }
 }
 
+static DWORD
+win32_launch_work_thread(VOID *data)
+{
+   Platform_Work_Queue *queue = (Platform_Work_Queue *)data;
+
+   while(true)
+   {
+      EnterCriticalSection(&queue->lock);
+      while(queue->entry_count == 0)
+      {
+         SleepConditionVariableCS(&queue->entry_added, &queue->lock, INFINITE);
+      }
+
+      Platform_Work_Entry *entry = queue->entries[queue->read_index];
+      queue->read_index = (queue->read_index + 1) % queue->max_entry_count;
+      queue->entry_count--;
+
+      WakeConditionVariable(&queue->entry_removed);
+      LeaveCriticalSection(&queue->lock);
+
+      entry->callback(entry->data);
+
+      EnterCriticalSection(&queue->lock);
+      entry->completed = true;
+      WakeAllConditionVariable(&queue->entry_completed);
+      LeaveCriticalSection(&queue->lock);
+   }
+}
+
+static unsigned int win32_global_work_queue_count;
+static Platform_Work_Queue win32_global_work_queues[4];
+
+extern
+PLATFORM_INITIALIZE_WORK_QUEUE(platform_initialize_work_queue)
+{
+   ASSERT(win32_global_work_queue_count < ARRAY_LENGTH(win32_global_work_queues));
+   ASSERT(thread_count > 0);
+   ASSERT(max_entry_count > 0);
+
+   Platform_Work_Queue *result = win32_global_work_queues + win32_global_work_queue_count++;
+
+   InitializeCriticalSection(&result->lock);
+   InitializeConditionVariable(&result->entry_added);
+   InitializeConditionVariable(&result->entry_removed);
+   InitializeConditionVariable(&result->entry_completed);
+
+   result->max_entry_count = max_entry_count;
+   result->entry_count = 0;
+   result->read_index = 0;
+   result->entries = platform_allocate(max_entry_count * sizeof(*result->entries));
+   if(!result->entries)
+   {
+      platform_log_message("[ERROR] Failed to allocate work queue entries.");
+      return 0;
+   }
+
+   for(unsigned int index = 0; index < thread_count; ++index)
+   {
+      HANDLE thread_handle = CreateThread(0, 0, win32_launch_work_thread, (void *)result, 0, 0);
+      if(thread_handle)
+      {
+         CloseHandle(thread_handle);
+      }
+      else
+      {
+         platform_log_message("[ERROR] Failed to launch work thread %u.", index);
+      }
+   }
+
+   return result;
+}
+
+extern
+PLATFORM_SUBMIT_WORK(platform_submit_work)
+{
+   entry->completed = false;
+
+   EnterCriticalSection(&queue->lock);
+   while(queue->entry_count == queue->max_entry_count)
+   {
+      SleepConditionVariableCS(&queue->entry_removed, &queue->lock, INFINITE);
+   }
+
+   unsigned int result = queue->entry_count;
+
+   unsigned int write_index = (queue->read_index + queue->entry_count) % queue->max_entry_count;
+   queue->entries[write_index] = entry;
+   queue->entry_count++;
+
+   WakeConditionVariable(&queue->entry_added);
+   LeaveCriticalSection(&queue->lock);
+
+   return result;
+}
+
+extern
+PLATFORM_WAIT_FOR_WORK(platform_wait_for_work)
+{
+   EnterCriticalSection(&queue->lock);
+   while(!entry->completed)
+   {
+      SleepConditionVariableCS(&queue->entry_completed, &queue->lock, INFINITE);
+   }
+   LeaveCriticalSection(&queue->lock);
+}
+
+extern
+PLATFORM_COMPLETE_WORK(platform_complete_work)
+{
+   EnterCriticalSection(&queue->lock);
+   entry->completed = true;
+   WakeAllConditionVariable(&queue->entry_completed);
+   LeaveCriticalSection(&queue->lock);
+}
+
+extern
+PLATFORM_SLEEP(platform_sleep)
+{
+   // NOTE(law): Sleep() only has millisecond granularity, so round up.
+   Sleep((microseconds + 999) / 1000);
+}
+
 static bool
 win32_accept_request(FCGX_Request *fcgx)
 {
@@ -245,8 +700,9 @@ win32_launch_request_thread(VOID *data)
 
    platform_log_message("Request thread %d launched.", thread.index);
 
-   size_t arena_size = MEBIBYTES(512);
-   unsigned char *base_address = platform_allocate(arena_size);
+   // NOTE(law): The arena is set up by the first request, and kept across
+   // requests.
+   Memory_Arena arena = {0};
 
    FCGX_Request fcgx;
    FCGX_InitRequest(&fcgx, win32_global_socket, 0);
@@ -259,16 +715,37 @@ win32_launch_request_thread(VOID *data)
       platform_request.fcgx = fcgx;
       platform_request.request.thread = thread;
 
-      bsp_process_request(&platform_request.request, base_address, arena_size);
+      bsp_process_request(&platform_request.request, &arena);
 
       FCGX_Finish_r(&fcgx);
+
+      bsp_finish_request(&arena);
    }
 
-   platform_deallocate(base_address);
+   if(arena.base_address)
+   {
+      platform_release_memory(arena.base_address, arena.reserve_size);
+   }
 
    return 0;
 }
 
+static BOOL WINAPI
+win32_handle_console_control(DWORD control_type)
+{
+   // NOTE(law): Ctrl+Break asks for a backup. Windows calls the handler on a
+   // thread of its own, so the backup runs right here.
+   BOOL result = FALSE;
+   if(control_type == CTRL_BREAK_EVENT)
+   {
+      platform_log_message("Backup requested.");
+      bsp_backup_database();
+      result = TRUE;
+   }
+
+   return result;
+}
+
 int
 main(int argument_count, char **arguments)
 {
@@ -279,6 +756,8 @@ main(int argument_count, char **arguments)
 
    bsp_initialize_application();
 
+   SetConsoleCtrlHandler(win32_handle_console_control, TRUE);
+
    FCGX_Init();
    win32_global_socket = FCGX_OpenSocket(":" STRINGIFY(APPLICATION_PORT), 1024);
 